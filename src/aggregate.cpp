@@ -0,0 +1,271 @@
+/// @file
+///
+/// @brief Implementation of Aggregate - one-pass summary statistics of results.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "aggregate.h"
+#include "num.h"
+
+// Values buffered (per centroid kept) before merging into a t-digest
+constexpr size_t DIGEST_BUFFER_FACTOR {5};
+
+constexpr double PI {3.14159265358979323846};
+
+void CompensatedSum::add(const double value)
+{
+	double sum = m_sum + value;
+	if (std::fabs(m_sum) >= std::fabs(value))
+	{
+		m_compensation += (m_sum - sum) + value;
+	}
+	else
+	{
+		m_compensation += (value - sum) + m_sum;
+	}
+	m_sum = sum;
+}
+
+void CompensatedSum::merge(const CompensatedSum& other)
+{
+	add(other.m_sum);
+	m_compensation += other.m_compensation;
+}
+
+
+TDigest::TDigest(const double compression)
+	: m_compression(compression)
+	, m_count(0.)
+	, m_min(INFINITY)
+	, m_max(-INFINITY)
+{
+}
+
+double TDigest::scale(const double q) const
+{
+	return (m_compression / (2. * PI)) * std::asin((2. * q) - 1.);
+}
+
+double TDigest::scaleInverse(const double k) const
+{
+	if (k >= (m_compression / 4.))
+		return 1.;
+	return (std::sin(k * (2. * PI) / m_compression) + 1.) / 2.;
+}
+
+void TDigest::add(const double value)
+{
+	m_buffer.push_back(Centroid{value, 1.});
+	m_count += 1.;
+	m_min = std::min(m_min, value);
+	m_max = std::max(m_max, value);
+
+	if (m_buffer.size() >= (DIGEST_BUFFER_FACTOR * static_cast<size_t>(m_compression)))
+	{
+		flush();
+	}
+}
+
+void TDigest::merge(const TDigest& other)
+{
+	m_buffer.insert(m_buffer.end(), other.m_centroids.begin(), other.m_centroids.end());
+	m_buffer.insert(m_buffer.end(), other.m_buffer.begin(), other.m_buffer.end());
+	m_count += other.m_count;
+	m_min = std::min(m_min, other.m_min);
+	m_max = std::max(m_max, other.m_max);
+	flush();
+}
+
+void TDigest::flush()
+{
+	if (m_buffer.empty())
+		return;
+
+	m_buffer.insert(m_buffer.end(), m_centroids.begin(), m_centroids.end());
+	std::sort(m_buffer.begin(), m_buffer.end(),
+		[](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+	m_centroids.clear();
+
+	// Neighbours are merged while the centroid stays within one unit of k
+	double total = 0.;
+	for (const auto& it : m_buffer)
+	{
+		total += it.weight;
+	}
+	double before = 0.;
+	double limit = total * scaleInverse(scale(0.) + 1.);
+	Centroid current = m_buffer.front();
+	for (size_t i = 1; i < m_buffer.size(); i++)
+	{
+		const Centroid& next = m_buffer[i];
+		if ((before + current.weight + next.weight) <= limit)
+		{
+			current.weight += next.weight;
+			current.mean += (next.mean - current.mean) * next.weight / current.weight;
+		}
+		else
+		{
+			before += current.weight;
+			limit = total * scaleInverse(scale(before / total) + 1.);
+			m_centroids.push_back(current);
+			current = next;
+		}
+	}
+	m_centroids.push_back(current);
+	m_buffer.clear();
+}
+
+double TDigest::quantile(const double q)
+{
+	flush();
+	if (m_centroids.empty())
+		return NAN;
+	if (q <= 0.)
+		return m_min;
+	if (q >= 1.)
+		return m_max;
+	if (m_centroids.size() == 1)
+		return m_centroids.front().mean;
+
+	// Weight of each centroid is spread around its mean - interpolate
+	// between neighbouring means (and min/max at the ends)
+	double index = q * m_count;
+	const Centroid& first = m_centroids.front();
+	if (index < (first.weight / 2.))
+		return m_min + ((first.mean - m_min) * index / (first.weight / 2.));
+
+	double before = first.weight / 2.;
+	for (size_t i = 1; i < m_centroids.size(); i++)
+	{
+		const Centroid& left = m_centroids[i - 1];
+		const Centroid& right = m_centroids[i];
+		double gap = (left.weight + right.weight) / 2.;
+		if (index < (before + gap))
+		{
+			return left.mean + ((right.mean - left.mean) * (index - before) / gap);
+		}
+		before += gap;
+	}
+
+	const Centroid& last = m_centroids.back();
+	double rest = m_count - index;
+	return m_max - ((m_max - last.mean) * rest / (last.weight / 2.));
+}
+
+
+Aggregate::Aggregate()
+	: m_count(0)
+	, m_missing(0)
+	, m_mean(0.)
+	, m_m2(0.)
+	, m_min(INFINITY)
+	, m_max(-INFINITY)
+{
+}
+
+void Aggregate::add(const double value)
+{
+	if (std::isnan(value))
+	{
+		m_missing++;
+		return;
+	}
+
+	m_count++;
+	m_sum.add(value);
+
+	double delta = value - m_mean;
+	m_mean += delta / static_cast<double>(m_count);
+	m_m2 += delta * (value - m_mean);
+
+	m_min = std::min(m_min, value);
+	m_max = std::max(m_max, value);
+	m_digest.add(value);
+}
+
+void Aggregate::merge(const Aggregate& other)
+{
+	if (other.m_count > 0)
+	{
+		// Chan et al. - parallel variance
+		double count = static_cast<double>(m_count + other.m_count);
+		double delta = other.m_mean - m_mean;
+		m_mean += delta * static_cast<double>(other.m_count) / count;
+		m_m2 += other.m_m2 + (delta * delta * static_cast<double>(m_count) * static_cast<double>(other.m_count) / count);
+
+		m_count += other.m_count;
+		m_sum.merge(other.m_sum);
+		m_min = std::min(m_min, other.m_min);
+		m_max = std::max(m_max, other.m_max);
+		m_digest.merge(other.m_digest);
+	}
+	m_missing += other.m_missing;
+}
+
+double Aggregate::mean() const
+{
+	return (m_count > 0) ? m_mean : NAN;
+}
+
+double Aggregate::variance() const
+{
+	return (m_count > 1) ? (m_m2 / static_cast<double>(m_count - 1)) : NAN;
+}
+
+double Aggregate::min() const
+{
+	return (m_count > 0) ? m_min : NAN;
+}
+
+double Aggregate::max() const
+{
+	return (m_count > 0) ? m_max : NAN;
+}
+
+/// @brief Same format as other results ("nan" if there is no value)
+static std::string formatValue(const double value)
+{
+	if (std::isnan(value))
+		return "nan";
+	return Num(value, NUM_DOUBLE).asString();
+}
+
+std::string Aggregate::report(const std::vector<double>& quantiles)
+{
+	std::string text;
+	text += "count " + std::to_string(m_count) + "\n";
+	text += "failed " + std::to_string(m_missing) + "\n";
+	text += "sum " + formatValue((m_count > 0) ? sum() : NAN) + "\n";
+	text += "mean " + formatValue(mean()) + "\n";
+	text += "variance " + formatValue(variance()) + "\n";
+	text += "stddev " + formatValue(std::sqrt(variance())) + "\n";
+	text += "min " + formatValue(min()) + "\n";
+	text += "max " + formatValue(max()) + "\n";
+	for (auto it : quantiles)
+	{
+		// "p50", "p99.9", ...
+		char name[32];
+		snprintf(name, sizeof(name), "p%g ", it * 100.);
+		text += name + formatValue(quantile(it)) + "\n";
+	}
+	return text;
+}
@@ -0,0 +1,129 @@
+/// @file
+///
+/// @brief Header file for Aggregate - one-pass summary statistics of results.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// @brief Sum with running compensation (Neumaier) - error does not grow with count
+class CompensatedSum
+{
+public:
+	CompensatedSum() : m_sum(0.), m_compensation(0.) {}
+
+	void add(const double value);
+
+	void merge(const CompensatedSum& other);
+
+	double value() const { return m_sum + m_compensation; }
+
+private:
+	double m_sum;
+	double m_compensation;  // Low-order bits lost by m_sum
+};
+
+/// @brief Mergeable quantile sketch (merging t-digest, Dunning 2019).
+/// Keeps about 'compression' centroids - small near the tails, so extreme
+/// quantiles stay accurate. Memory is bounded whatever the count.
+class TDigest
+{
+public:
+	explicit TDigest(const double compression = 200.);
+
+	void add(const double value);
+
+	void merge(const TDigest& other);
+
+	/// @brief Estimated value at quantile q (0..1) - NaN if empty
+	double quantile(const double q);
+
+	size_t centroids() { flush(); return m_centroids.size(); }
+
+private:
+	typedef struct _centroid
+	{
+		double mean;
+		double weight;
+	} Centroid;
+
+	/// @brief Merges buffered values into centroids
+	void flush();
+
+	/// @brief Scale function k1 and its inverse
+	double scale(const double q) const;
+	double scaleInverse(const double k) const;
+
+	double m_compression;
+	std::vector<Centroid> m_centroids;  // Sorted by mean
+	std::vector<Centroid> m_buffer;     // Not merged yet
+	double m_count;
+	double m_min;
+	double m_max;
+};
+
+/// @brief Summary statistics - all in one pass
+class Aggregate
+{
+public:
+	Aggregate();
+
+	/// @brief Adds a result - NaN (failed row) is only counted
+	void add(const double value);
+
+	/// @brief Adds results of another part (ex. thread) - as if added here
+	void merge(const Aggregate& other);
+
+	uint64_t count() const { return m_count; }
+
+	uint64_t missing() const { return m_missing; }
+
+	double sum() const { return m_sum.value(); }
+
+	double mean() const;
+
+	/// @brief Sample variance (n - 1) - NaN below 2 values
+	double variance() const;
+
+	double min() const;
+
+	double max() const;
+
+	double quantile(const double q) { return m_digest.quantile(q); }
+
+	/// @brief "name value" lines of all statistics
+	std::string report(const std::vector<double>& quantiles);
+
+private:
+	uint64_t m_count;
+	uint64_t m_missing;
+	CompensatedSum m_sum;
+
+	// Welford - running mean and sum of squared differences from it
+	double m_mean;
+	double m_m2;
+
+	double m_min;
+	double m_max;
+
+	TDigest m_digest;
+};
@@ -0,0 +1,133 @@
+/// @file
+///
+/// @brief Implementation of AsyncPool - bounded task queue of worker threads with contexts.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+
+#include "asyncPool.h"
+#include "workPool.h"
+
+AsyncPool::AsyncPool(const size_t threads, const size_t capacity)
+	: m_capacity(std::max(capacity, WorkPool::threadCount(threads)))
+	, m_context(Context::current())
+	, m_blocked(0)
+	, m_stop(false)
+{
+	// Workers never print or ask - results and messages go to the caller
+	FncBudget budget = m_context.budget();
+	budget.interactive = false;
+	m_context.setBudget(budget);
+	m_context.setOutput(FncOutput());
+	m_context.setInput(FncInput());
+
+	size_t count = WorkPool::threadCount(threads);
+	for (size_t i = 0; i < count; i++)
+	{
+		m_workers.emplace_back(&AsyncPool::work, this);
+	}
+}
+
+AsyncPool::~AsyncPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_work.notify_all();
+	for (auto& it : m_workers)
+	{
+		it.join();
+	}
+}
+
+bool AsyncPool::tryPush(std::vector<Task>& tasks)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!room(tasks.size()))
+			return false;
+
+		append(tasks);
+	}
+	return true;
+}
+
+void AsyncPool::push(std::vector<Task>& tasks)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_blocked++;
+		m_room.wait(lock, [this, &tasks] { return room(tasks.size()); });
+		m_blocked--;
+		append(tasks);
+	}
+}
+
+size_t AsyncPool::queued() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_tasks.size();
+}
+
+void AsyncPool::append(std::vector<Task>& tasks)
+{
+	for (auto& it : tasks)
+	{
+		m_tasks.push_back(std::move(it));
+	}
+
+	// Lock is held - a woken worker waits for it, but cannot miss the tasks
+	if (tasks.size() == 1)
+	{
+		m_work.notify_one();
+	}
+	else
+	{
+		m_work.notify_all();
+	}
+	tasks.clear();
+}
+
+void AsyncPool::work()
+{
+	// Contexts are used by one thread at a time - each worker has a copy
+	Context::current() = m_context;
+
+	Task task;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_work.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+		if (m_tasks.empty())
+			break;
+
+		task = std::move(m_tasks.front());
+		m_tasks.pop_front();
+		bool blocked = (m_blocked != 0);
+		lock.unlock();
+		if (blocked)
+		{
+			m_room.notify_all();
+		}
+
+		task();
+		task = nullptr;
+		lock.lock();
+	}
+}
@@ -0,0 +1,92 @@
+/// @file
+///
+/// @brief Header for AsyncPool - bounded task queue of worker threads with contexts.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "context.h"
+
+// How AsyncPool works:
+// Callers from any thread push tasks into one FIFO queue of at most
+// 'capacity' tasks; a fixed set of workers takes them in order. A full queue
+// is the back-pressure signal: tryPush() fails at once, push() waits for
+// room - so callers slow down instead of the queue growing. Tasks of one
+// push() are admitted together or not at all (ex. the chunks of an array).
+// Each worker evaluates on its own copy of the context that created the pool
+// (no console callbacks, input never asked for); a task that needs a clean
+// context (ex. one that may define variables) runs on session() of it.
+// Unlike WorkPool (one producer, per-worker queues for batch chunks), this
+// queue takes many producers and keeps their order.
+
+class AsyncPool
+{
+public:
+	using Task = std::function<void()>;
+
+	/// @param threads - workers (0 uses all cores)
+	/// @param capacity - tasks waiting at most (at least one per worker)
+	AsyncPool(const size_t threads, const size_t capacity);
+
+	/// @brief Runs queued tasks, then stops workers
+	~AsyncPool();
+
+	/// @brief Queues 'tasks' if there is room for all of them - false if not
+	bool tryPush(std::vector<Task>& tasks);
+
+	/// @brief Queues 'tasks' - waits for room
+	void push(std::vector<Task>& tasks);
+
+	/// @brief Tasks waiting (not started)
+	size_t queued() const;
+
+	size_t capacity() const { return m_capacity; }
+
+	size_t threads() const { return m_workers.size(); }
+
+private:
+	AsyncPool(const AsyncPool&) = delete;
+	AsyncPool& operator=(const AsyncPool&) = delete;
+
+	// Room for 'count' tasks (lock held) - a push larger than the queue goes into an empty one
+	bool room(const size_t count) const { return m_tasks.empty() || ((m_tasks.size() + count) <= m_capacity); }
+
+	// Moves 'tasks' into the queue (lock held)
+	void append(std::vector<Task>& tasks);
+
+	void work();
+
+	const size_t m_capacity;
+	Context m_context;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_work;    // Tasks were queued (or stop)
+	std::condition_variable m_room;    // Tasks were taken
+	std::deque<Task> m_tasks;
+	size_t m_blocked;                  // Callers waiting in push()
+	bool m_stop;
+
+	std::vector<std::thread> m_workers;
+};
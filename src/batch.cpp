@@ -0,0 +1,731 @@
+/// @file
+///
+/// @brief Implementation of Batch - expression over many input rows.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <cstdint>
+
+#include "batch.h"
+#include "console.h"
+#include "workPool.h"
+#include "context.h"
+#include "numScan.h"
+
+// Rows per chunk
+constexpr size_t TEXT_CHUNK_ROWS {4096};
+constexpr size_t RAW_CHUNK_ROWS  {16384};
+
+// Chunks in flight (per thread) - bounds memory used by the reorder buffer
+constexpr size_t CHUNKS_PER_THREAD {4};
+
+// Errors shown (in total and per chunk)
+constexpr size_t MAX_ERROR_MESSAGES {10};
+
+Batch::Batch(const BatchOptions& options)
+	: m_options(options)
+	, m_blocks(false)
+	, m_input(&std::cin)
+	, m_textPos(0)
+	, m_textEnd(SIZE_MAX)
+	, m_rawRows(0)
+	, m_nextRow(0)
+	, m_text(&std::cout)
+	, m_rows(0)
+	, m_errors(0)
+	, m_messages(0)
+{
+}
+
+bool Batch::run(std::string& message)
+{
+	Console::Quiet quiet;
+
+	if (!m_program.compile(m_options.expression, message))
+		return false;
+
+	if (m_program.empty())
+	{
+		message = "Expression '" + m_options.expression + "' has no results";
+		return false;
+	}
+
+	if (!m_options.where.empty())
+	{
+		if (!m_where.compile(m_options.where, message))
+			return false;
+		if (m_where.empty())
+		{
+			message = "Filter '" + m_options.where + "' has no results";
+			return false;
+		}
+	}
+
+	std::ofstream textFile;
+	if (m_options.outFormat != RAW_NONE)
+	{
+		if (!m_raw.open(m_options.outputFile, m_options.outFormat, message))
+			return false;
+	}
+	else if (!m_options.outputFile.empty())
+	{
+		textFile.open(m_options.outputFile);
+		if (!textFile)
+		{
+			message = "Cannot write '" + m_options.outputFile + "'";
+			return false;
+		}
+		m_text = &textFile;
+	}
+
+	bool ok = m_options.rawInputs.empty() ? openText(message) : openRaw(message);
+	if (ok && !m_options.where.empty())
+	{
+		// Same input slots as the expression
+		std::vector<std::string> vars;
+		for (size_t i = 0; i < m_program.slots(); i++)
+		{
+			vars.push_back(m_program.slotName(i));
+		}
+		ok = m_where.resolve(vars, message);
+	}
+
+	std::string reason;
+	if (ok && m_options.float32)
+	{
+		if (!m_block.build(m_program, reason))
+		{
+			message = "Expression cannot run in float32 mode - " + reason;
+			ok = false;
+		}
+		else if (!m_options.where.empty() && !m_whereBlock.build(m_where, reason))
+		{
+			message = "Filter cannot run in float32 mode - " + reason;
+			ok = false;
+		}
+		m_blocks = ok;
+	}
+	else if (ok && useBlocks())
+	{
+		// Otherwise rows run one at a time
+		m_blocks = m_block.build(m_program, reason)
+			&& (m_options.where.empty() || m_whereBlock.build(m_where, reason));
+	}
+	if (ok)
+	{
+		size_t threads = WorkPool::threadCount(m_options.threads);
+		ok = (threads > 1) ? runThreaded(threads, message) : runSerial(message);
+	}
+
+	if (ok && m_options.summary)
+	{
+		std::string report = m_summary.report(m_options.quantiles);
+		m_text->write(report.data(), report.size());
+	}
+
+	if (!m_raw.close() && ok)
+	{
+		message = "Error writing results";
+		ok = false;
+	}
+	m_text->flush();
+	m_text = &std::cout;
+
+	if (m_errors > 0)
+	{
+		std::cerr << (shardLabel() + std::to_string(m_errors) + " of " + std::to_string(m_rows) + " rows failed\n") << std::flush;
+	}
+	return ok;
+}
+
+bool Batch::openText(std::string& message)
+{
+	std::vector<std::string> vars = m_options.vars;
+	if (vars.empty())
+	{
+		// Columns are the variables in order of the expression (then the filter)
+		for (size_t i = 0; i < m_program.slots(); i++)
+		{
+			vars.push_back(m_program.slotName(i));
+		}
+		for (size_t i = 0; i < m_where.slots(); i++)
+		{
+			if (m_program.findSlot(m_where.slotName(i)) < 0)
+			{
+				vars.push_back(m_where.slotName(i));
+			}
+		}
+	}
+	if (!m_program.resolve(vars, message))
+		return false;
+
+	if (!m_options.inputFile.empty())
+	{
+		m_file.open(m_options.inputFile);
+		if (!m_file)
+		{
+			message = "Cannot open '" + m_options.inputFile + "'";
+			return false;
+		}
+		m_input = &m_file;
+	}
+
+	if (m_options.shards > 1)
+	{
+		if (m_options.inputFile.empty())
+		{
+			message = "Shards need an input file";
+			return false;
+		}
+
+		m_file.seekg(0, std::ios::end);
+		size_t size = static_cast<size_t>(m_file.tellg());
+		m_textPos = alignToLine((size / m_options.shards) * m_options.shard
+			+ (size % m_options.shards) * m_options.shard / m_options.shards, size);
+		m_textEnd = alignToLine((size / m_options.shards) * (m_options.shard + 1)
+			+ (size % m_options.shards) * (m_options.shard + 1) / m_options.shards, size);
+
+		m_file.clear();
+		m_file.seekg(static_cast<std::streamoff>(m_textPos));
+		if (!m_file)
+		{
+			message = "Cannot read '" + m_options.inputFile + "'";
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t Batch::alignToLine(const size_t offset, const size_t size)
+{
+	if ((offset == 0) || (offset >= size))
+		return std::min(offset, size);
+
+	// Line starts after the last '\n' before offset
+	m_file.clear();
+	m_file.seekg(static_cast<std::streamoff>(offset - 1));
+	size_t pos = offset - 1;
+	char c;
+	while (m_file.get(c))
+	{
+		pos++;
+		if (c == '\n')
+			break;
+	}
+	return pos;
+}
+
+bool Batch::openRaw(std::string& message)
+{
+	std::vector<std::string> vars;
+
+	for (const auto& it : m_options.rawInputs)
+	{
+		m_files.emplace_back(new MappedFile());
+		MappedFile& file = *m_files.back();
+		if (!file.open(it.fileName, message))
+			return false;
+
+		size_t stride = it.vars.size() * rawSize(it.format);
+		if ((stride == 0) || ((file.size() % stride) != 0))
+		{
+			message = "'" + it.fileName + "' size is not a multiple of its record size";
+			return false;
+		}
+
+		size_t count = file.size() / stride;
+		if (m_files.size() == 1)
+		{
+			m_rawRows = count;
+		}
+		else if (count != m_rawRows)
+		{
+			message = "'" + it.fileName + "' does not have the same number of rows as other inputs";
+			return false;
+		}
+
+		for (size_t i = 0; i < it.vars.size(); i++)
+		{
+			vars.push_back(it.vars[i]);
+			m_columns.push_back(RawColumn{file.data() + (i * rawSize(it.format)), stride, it.format});
+		}
+	}
+
+	// Rows of shard - row numbers stay those of the whole input
+	if (m_options.shards > 1)
+	{
+		size_t rows = m_rawRows;
+		m_nextRow = (rows / m_options.shards) * m_options.shard
+			+ (rows % m_options.shards) * m_options.shard / m_options.shards;
+		m_rawRows = (rows / m_options.shards) * (m_options.shard + 1)
+			+ (rows % m_options.shards) * (m_options.shard + 1) / m_options.shards;
+	}
+
+	return m_program.resolve(vars, message);
+}
+
+bool Batch::useBlocks() const
+{
+	// Integer inputs are integer math and text output keeps integer results
+	if (m_columns.empty() || ((m_options.outFormat == RAW_NONE) && !m_options.summary))
+		return false;
+
+	for (const auto& it : m_columns)
+	{
+		if (it.format == RAW_INT64)
+			return false;
+	}
+	return true;
+}
+
+std::string Batch::shardLabel() const
+{
+	if (m_options.shards <= 1)
+		return "! ";
+	return "! Shard " + std::to_string(m_options.shard) + "/" + std::to_string(m_options.shards) + " ";
+}
+
+bool Batch::nextChunk(BatchChunk& chunk)
+{
+	chunk.first = m_nextRow;
+	chunk.rows = 0;
+	chunk.lines.clear();
+	chunk.output.clear();
+	chunk.errors = 0;
+	chunk.messages.clear();
+	chunk.summary = Aggregate();
+
+	if (!m_columns.empty())
+	{
+		chunk.rows = std::min(RAW_CHUNK_ROWS, m_rawRows - m_nextRow);
+	}
+	else if (m_program.slots() == 0)
+	{
+		// A program without inputs is run once (by first shard)
+		chunk.rows = ((m_nextRow == 0) && (m_options.shard == 0)) ? 1 : 0;
+	}
+	else
+	{
+		std::string line;
+		while ((chunk.lines.size() < TEXT_CHUNK_ROWS) && (m_textPos < m_textEnd) && std::getline(*m_input, line))
+		{
+			m_textPos += line.size() + 1;
+
+			// Skip blank lines
+			if (line.find_first_not_of(" \t\r,") != std::string::npos)
+			{
+				chunk.lines.push_back(line);
+			}
+		}
+		chunk.rows = chunk.lines.size();
+	}
+
+	m_nextRow += chunk.rows;
+	return chunk.rows > 0;
+}
+
+/// @brief Filter result keeps row (not 0 and not NaN)
+static inline bool kept(const Num& value)
+{
+	return value.isInteger() ? (value.m_lValue != 0) : ((value.m_dValue != 0.) && !std::isnan(value.m_dValue));
+}
+
+template <typename T>
+static inline bool kept(const T value)
+{
+	return (value != T(0)) && !std::isnan(value);
+}
+
+/// @brief Raw format read in place by blocks of T
+static inline RawFormat blockFormat(float)  { return RAW_FLOAT32; }
+static inline RawFormat blockFormat(double) { return RAW_FLOAT64; }
+
+/// @brief Formats one block result into output
+static void appendBlockResult(std::string& output, const RawFormat format, const float value)
+{
+	if (format != RAW_NONE)
+	{
+		appendRawFloat(output, format, value);
+		return;
+	}
+
+	// Enough digits to read back the same float
+	char text[64];
+	int len = std::isnan(value) ? snprintf(text, sizeof(text), "nan\n")
+		: snprintf(text, sizeof(text), "%.9g\n", value);
+	output.append(text, len);
+}
+
+static void appendBlockResult(std::string& output, const RawFormat format, const double value)
+{
+	if (format != RAW_NONE)
+	{
+		appendRawDouble(output, format, value);
+		return;
+	}
+
+	output += std::isnan(value) ? std::string("nan") : Num(value, NUM_DOUBLE).asString();
+	output += '\n';
+}
+
+void Batch::evaluate(BatchChunk& chunk) const
+{
+	if (m_blocks)
+	{
+		if (m_options.float32)
+		{
+			evaluateBlock<float>(chunk);
+		}
+		else
+		{
+			evaluateBlock<double>(chunk);
+		}
+		return;
+	}
+
+	std::vector<Num> values(m_program.slots());
+	for (size_t i = 0; i < m_columns.size(); i++)
+	{
+		values[i] = (m_columns[i].format == RAW_INT64) ? Num(0., NUM_INTEGER) : Num(0., NUM_DOUBLE);
+	}
+
+	NumStack stack;
+	stack.reserve(std::max(m_program.depth(), m_where.depth()));
+	std::string message;
+
+	for (size_t row = 0; row < chunk.rows; row++)
+	{
+		bool ok = true;
+		if (!chunk.lines.empty())
+		{
+			ok = parseRow(chunk.lines[row], values, message);
+		}
+		else
+		{
+			size_t index = chunk.first + row;
+			for (size_t i = 0; i < m_columns.size(); i++)
+			{
+				const char* ptr = m_columns[i].data + (index * m_columns[i].stride);
+				if (m_columns[i].format == RAW_FLOAT32)
+				{
+					values[i].m_dValue = readRawDouble(ptr, RAW_FLOAT32);
+					continue;
+				}
+				uint64_t raw = readRaw64(ptr);
+				memcpy(&values[i].m_lValue, &raw, sizeof(raw));
+			}
+		}
+
+		if (ok && !m_options.where.empty())
+		{
+			if (!m_where.run(values.data(), stack, message))
+			{
+				message = "Filter: " + message;
+				ok = false;
+			}
+			else if (!kept(stack.back()))
+			{
+				// Dropped - no result
+				continue;
+			}
+		}
+
+		ok = ok && m_program.run(values.data(), stack, message);
+		if (!ok)
+		{
+			// The console is quiet - its last line is the detail of the failure
+			if (!Console::lastLine().empty())
+			{
+				message += " - " + Console::lastLine();
+				Console::clearLastLine();
+			}
+			chunk.errors++;
+			if (chunk.messages.size() < MAX_ERROR_MESSAGES)
+			{
+				chunk.messages.push_back("Row " + std::to_string(chunk.first + row + 1) + ": " + message);
+			}
+		}
+		putResult(chunk, ok ? stack.back() : Num(), ok);
+	}
+}
+
+template <typename T>
+void Batch::evaluateBlock(BatchChunk& chunk) const
+{
+	const size_t slots = m_program.slots();
+	const bool filter = !m_options.where.empty();
+	std::vector<std::vector<T> > columns(slots, std::vector<T>(BLOCK_VALUES));
+	std::vector<const T*> inputs(slots);
+	std::vector<T> results(BLOCK_VALUES);
+	std::vector<T> scratch(m_block.columns() * BLOCK_VALUES);
+	std::vector<T> mask(filter ? BLOCK_VALUES : 0);
+	std::vector<T> maskScratch(m_whereBlock.columns() * BLOCK_VALUES);
+	std::vector<char> failed(BLOCK_VALUES);
+	std::vector<Num> values(slots);
+	std::string message;
+
+	for (size_t done = 0; done < chunk.rows; )
+	{
+		size_t count = std::min(BLOCK_VALUES, chunk.rows - done);
+		for (size_t k = 0; k < slots; k++)
+		{
+			inputs[k] = columns[k].data();
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			failed[i] = 0;
+			if (chunk.lines.empty())
+				continue;
+
+			bool ok = parseRow(chunk.lines[done + i], values, message);
+			for (size_t k = 0; ok && (k < slots); k++)
+			{
+				if (!values[k].m_unit.keyString().empty() || !values[k].m_format.empty())
+				{
+					message = "'" + chunk.lines[done + i] + "' has units or format - not used in float32 mode";
+					ok = false;
+				}
+				columns[k][i] = values[k].isInteger() ? static_cast<T>(values[k].m_lValue)
+					: static_cast<T>(values[k].m_dValue);
+			}
+
+			if (!ok)
+			{
+				failed[i] = 1;
+				chunk.errors++;
+				if (chunk.messages.size() < MAX_ERROR_MESSAGES)
+				{
+					chunk.messages.push_back("Row " + std::to_string(chunk.first + done + i + 1) + ": " + message);
+				}
+			}
+		}
+
+		for (size_t k = 0; chunk.lines.empty() && (k < m_columns.size()); k++)
+		{
+			const RawColumn& col = m_columns[k];
+			const char* data = col.data + ((chunk.first + done) * col.stride);
+#if !defined(__BYTE_ORDER__) || (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+			// Plain array of T - used in place
+			if ((col.format == blockFormat(T())) && (col.stride == sizeof(T)))
+			{
+				inputs[k] = reinterpret_cast<const T*>(data);
+				continue;
+			}
+#endif
+			for (size_t i = 0; i < count; i++)
+			{
+				columns[k][i] = static_cast<T>(readRawDouble(data + (i * col.stride), col.format));
+			}
+		}
+
+		m_block.run(inputs.data(), count, scratch.data(), results.data());
+		if (filter)
+		{
+			m_whereBlock.run(inputs.data(), count, maskScratch.data(), mask.data());
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			// Rows that failed are written (as NaN) - filter did not run on them
+			if (filter && !failed[i] && !kept(mask[i]))
+				continue;
+
+			T result = failed[i] ? T(NAN) : results[i];
+			if (m_options.summary)
+			{
+				chunk.summary.add(result);
+			}
+			else
+			{
+				appendBlockResult(chunk.output, m_options.outFormat, result);
+			}
+		}
+		done += count;
+	}
+}
+
+bool Batch::parseRow(const std::string& line, std::vector<Num>& values, std::string& message) const
+{
+	size_t pos = 0;
+	for (auto& it : values)
+	{
+		pos = line.find_first_not_of(" \t\r,", pos);
+		if (pos == std::string::npos)
+		{
+			message = "Missing values in '" + line + "'";
+			return false;
+		}
+		size_t end = line.find_first_of(" \t\r,", pos);
+		if (end == std::string::npos)
+			end = line.size();
+
+		// Plain numbers (most fields) are read in place
+		ScannedNumber numb;
+		if (scanNumber(line.data() + pos, line.data() + end, SCAN_EXPONENT | SCAN_HEX, numb)
+			&& (numb.length == (end - pos)))
+		{
+			if (!it.m_unit.keyString().empty())
+			{
+				it.m_unit = NumUnit();
+			}
+			if (numb.isInteger)
+			{
+				it.m_type = NUM_INTEGER;
+				it.m_lValue = numb.intValue;
+			}
+			else
+			{
+				it.m_type = NUM_DOUBLE;
+				it.m_dValue = numb.dblValue;
+			}
+			pos = end;
+			continue;
+		}
+
+		// Numbers with units or format
+		CalString field(line.substr(pos, end - pos));
+		if (!field.isNumber())
+		{
+			message = "'" + field + "' is not a number";
+			return false;
+		}
+		it = Num();
+		if (!it.parse(field, message) || !field.empty())
+		{
+			message = "Cannot parse '" + line.substr(pos, end - pos) + "'";
+			return false;
+		}
+		pos = end;
+	}
+	return true;
+}
+
+void Batch::putResult(BatchChunk& chunk, const Num& result, const bool ok) const
+{
+	if (m_options.summary)
+	{
+		chunk.summary.add(!ok ? NAN : (result.isInteger() ? static_cast<double>(result.m_lValue) : result.m_dValue));
+	}
+	else if (m_options.outFormat != RAW_NONE)
+	{
+		if (!ok)
+		{
+			appendRawDouble(chunk.output, m_options.outFormat, NAN);
+		}
+		else if (result.isInteger())
+		{
+			appendRawInt(chunk.output, m_options.outFormat, result.m_lValue);
+		}
+		else
+		{
+			appendRawDouble(chunk.output, m_options.outFormat, result.m_dValue);
+		}
+	}
+	else if (ok)
+	{
+		chunk.output += result.asString();
+		chunk.output += '\n';
+	}
+	else
+	{
+		chunk.output += "nan\n";
+	}
+}
+
+bool Batch::writeChunk(const BatchChunk& chunk)
+{
+	for (const auto& it : chunk.messages)
+	{
+		if (m_messages >= MAX_ERROR_MESSAGES)
+			break;
+		// One write per line - shards share stderr
+		std::cerr << (shardLabel() + it + "\n") << std::flush;
+		m_messages++;
+	}
+	m_errors += chunk.errors;
+	m_rows += chunk.rows;
+
+	if (m_options.summary)
+	{
+		m_summary.merge(chunk.summary);
+		return true;
+	}
+
+	if (m_options.outFormat != RAW_NONE)
+	{
+		return m_raw.write(chunk.output);
+	}
+
+	m_text->write(chunk.output.data(), chunk.output.size());
+	return m_text->good();
+}
+
+bool Batch::runSerial(std::string& message)
+{
+	BatchChunk chunk;
+	while (nextChunk(chunk))
+	{
+		evaluate(chunk);
+		if (!writeChunk(chunk))
+		{
+			message = "Error writing results";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Batch::runThreaded(const size_t threads, std::string& message)
+{
+	// Workers start with the variables and settings of this thread
+	Context state = Context::current();
+	WorkPool pool(threads, [state] { Context::current() = state; });
+
+	ReorderBuffer<BatchChunk> order;
+	BatchChunk chunk;
+	bool ok = true;
+
+	while (ok && nextChunk(chunk))
+	{
+		// Write finished chunks before reading too far ahead
+		BatchChunk done;
+		while (ok && (order.outstanding() >= threads * CHUNKS_PER_THREAD) && order.take(done))
+		{
+			ok = writeChunk(done);
+		}
+
+		size_t sequence = order.reserve();
+		pool.submit([this, &order, sequence, chunk]() mutable {
+			evaluate(chunk);
+			order.put(sequence, std::move(chunk));
+		});
+	}
+
+	BatchChunk done;
+	while (order.take(done))
+	{
+		ok = writeChunk(done) && ok;
+	}
+
+	if (!ok)
+	{
+		message = "Error writing results";
+	}
+	return ok;
+}
@@ -0,0 +1,177 @@
+/// @file
+///
+/// @brief Header file for Batch - runs an expression over many input rows.
+///
+/// Each input row supplies values of the expression's variables. Rows are
+/// either text (one row per line, values separated by spaces or commas) or
+/// raw little-endian float64/int64 arrays (see binaryIO.h).
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <memory>
+
+#include "program.h"
+#include "blockProgram.h"
+#include "aggregate.h"
+#include "binaryIO.h"
+
+/// @brief Raw input file.
+/// One variable per file - or interleaved records when more than one is listed
+typedef struct _batchInput
+{
+	std::vector<std::string> vars;
+	RawFormat   format;
+	std::string fileName;
+} BatchInput;
+
+/// @brief Batch settings (usually from command line)
+typedef struct _batchOptions
+{
+	CalString   expression;
+	CalString   where;                  // Rows kept where this is not 0 (empty - all rows)
+	std::vector<std::string> vars;      // Variables (columns) of text input
+	std::string inputFile;              // Text input - stdin if empty
+	std::vector<BatchInput> rawInputs;  // Raw inputs (replaces text input)
+	RawFormat   outFormat;              // RAW_NONE is text output
+	std::string outputFile;             // stdout if empty
+	size_t      threads;                // Worker threads (0 - all cores)
+	size_t      shard;                  // Part of input run (0 .. shards - 1)
+	size_t      shards;                 // Parts input is split into (1 - all input)
+	bool        float32;                // Evaluate in float32 (see BlockProgram)
+	bool        summary;                // Write summary statistics instead of results
+	std::vector<double> quantiles;      // Quantiles of summary (0..1)
+} BatchOptions;
+
+/// @brief Rows evaluated together (by one thread)
+typedef struct _batchChunk
+{
+	size_t      first;   // Row number of first row
+	size_t      rows;
+	std::vector<std::string> lines;    // Text input rows
+	std::string output;  // Formatted (or raw) results
+	size_t      errors;
+	std::vector<std::string> messages; // First errors of chunk
+	Aggregate   summary;  // Results of chunk (summary mode)
+} BatchChunk;
+
+// How Batch works:
+// Input is split into chunks of rows. With more than one thread, chunks are
+// evaluated by a WorkPool and their output is written in input order
+// (ReorderBuffer). Every worker has its own copy of the context (variables,
+// settings and callbacks - see Context), taken when the batch starts.
+// A shard runs only part of the input: raw inputs are split by rows, text
+// files by bytes - a line belongs to the shard its first byte is in. Shards
+// run in separate processes (see ShardRunner) and share nothing.
+// In float32 mode rows run through a BlockProgram in float32 - inputs, math,
+// angle conversions and results. Values have about 7 significant digits.
+// In summary mode every chunk adds its results to its own Aggregate, merged
+// in input order - same statistics with any number of threads.
+// Raw float inputs with raw (or summary) output run through a BlockProgram in
+// double when the expression can - comparisons and select() do not branch.
+// The "where" filter is a second expression on the same variables: rows where
+// it is 0 (or NaN) are dropped. In blocks it is a mask column.
+
+class Batch
+{
+public:
+	Batch(const BatchOptions& options);
+
+	/// @brief Compiles expression, reads all input and writes results
+	bool run(std::string& message);
+
+	/// @brief Rows evaluated
+	size_t rows() const { return m_rows; }
+
+	/// @brief Rows that failed (written as NaN)
+	size_t errors() const { return m_errors; }
+
+private:
+	bool openText(std::string& message);
+
+	bool openRaw(std::string& message);
+
+	/// @brief Moves offset of text file to start of next line (unless at start of one)
+	size_t alignToLine(const size_t offset, const size_t size);
+
+	/// @brief Rows can run in double blocks (raw float inputs, raw or summary output)
+	bool useBlocks() const;
+
+	/// @brief Start of messages ("! " or "! Shard i/N ")
+	std::string shardLabel() const;
+
+	/// @brief Reads next chunk of input rows
+	/// @return false if there is no more input
+	bool nextChunk(BatchChunk& chunk);
+
+	/// @brief Evaluates rows of chunk (any thread)
+	void evaluate(BatchChunk& chunk) const;
+
+	/// @brief Evaluates rows of chunk in blocks - float32 or double (any thread)
+	template <typename T>
+	void evaluateBlock(BatchChunk& chunk) const;
+
+	/// @brief Splits text row into slot values
+	bool parseRow(const std::string& line, std::vector<Num>& values, std::string& message) const;
+
+	/// @brief Formats one result into chunk output
+	void putResult(BatchChunk& chunk, const Num& result, const bool ok) const;
+
+	/// @brief Writes results of chunk in order
+	bool writeChunk(const BatchChunk& chunk);
+
+	bool runSerial(std::string& message);
+
+	bool runThreaded(const size_t threads, std::string& message);
+
+	BatchOptions m_options;
+
+	Program m_program;
+	Program m_where;
+	BlockProgram m_block;
+	BlockProgram m_whereBlock;
+	bool m_blocks;  // Rows run through m_block (see evaluateBlock())
+
+	// Text input
+	std::ifstream m_file;
+	std::istream* m_input;
+	size_t m_textPos;
+	size_t m_textEnd;   // End of shard (bytes)
+
+	// Raw input
+	std::vector<std::unique_ptr<MappedFile> > m_files;
+	std::vector<RawColumn> m_columns;
+	size_t m_rawRows;
+
+	// Next input row
+	size_t m_nextRow;
+
+	// Output - one of them is used
+	RawWriter m_raw;
+	std::ostream* m_text;
+
+	size_t m_rows;
+	size_t m_errors;
+	size_t m_messages;  // Errors shown
+
+	Aggregate m_summary;
+};
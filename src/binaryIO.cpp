@@ -0,0 +1,285 @@
+/// @file
+///
+/// @brief Implementation of raw (binary) array input and output.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <fstream>
+
+#include <cmath>
+
+#ifdef _MSC_VER
+ #include <io.h>
+ #include <fcntl.h>
+#else
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+#endif
+
+#include "binaryIO.h"
+
+// Size of output buffer
+constexpr size_t RAW_BUFFER_SIZE {1 << 16};
+
+// -2^63 and 2^63 - doubles in [MIN, END) truncate to an int64
+constexpr double INT64_RANGE_MIN {-9223372036854775808.0};
+constexpr double INT64_RANGE_END {9223372036854775808.0};
+
+MappedFile::MappedFile()
+	: m_data(nullptr)
+	, m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& fileName, std::string& message)
+{
+	close();
+
+#ifndef _MSC_VER
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		message = "Cannot open '" + fileName + "'";
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) != 0)
+	{
+		::close(fd);
+		message = "Cannot read size of '" + fileName + "'";
+		return false;
+	}
+
+	m_size = static_cast<size_t>(status.st_size);
+	if (m_size > 0)
+	{
+		void* ptr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED)
+		{
+			// Rows are read in order
+			madvise(ptr, m_size, MADV_SEQUENTIAL);
+			m_data = static_cast<const char*>(ptr);
+		}
+	}
+	::close(fd);
+
+	if ((m_size == 0) || (m_data != nullptr))
+	{
+		return true;
+	}
+	// Could not map (pipe or special file) - read it instead
+#endif
+
+	std::ifstream file(fileName, std::ios::binary);
+	if (!file)
+	{
+		message = "Cannot open '" + fileName + "'";
+		return false;
+	}
+	m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	m_data = m_buffer.data();
+	m_size = m_buffer.size();
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifndef _MSC_VER
+	if ((m_data != nullptr) && m_buffer.empty())
+	{
+		munmap(const_cast<char*>(m_data), m_size);
+	}
+#endif
+	m_buffer.clear();
+	m_data = nullptr;
+	m_size = 0;
+}
+
+
+static void appendRaw(std::string& buffer, uint64_t value)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	value = __builtin_bswap64(value);
+#endif
+	char bytes[sizeof(value)];
+	memcpy(bytes, &value, sizeof(value));
+	buffer.append(bytes, sizeof(value));
+}
+
+static void appendRaw32(std::string& buffer, uint32_t value)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	value = __builtin_bswap32(value);
+#endif
+	char bytes[sizeof(value)];
+	memcpy(bytes, &value, sizeof(value));
+	buffer.append(bytes, sizeof(value));
+}
+
+void appendRawFloat(std::string& buffer, const RawFormat format, const float value)
+{
+	if (format != RAW_FLOAT32)
+	{
+		appendRawDouble(buffer, format, value);
+		return;
+	}
+
+	uint32_t raw;
+	memcpy(&raw, &value, sizeof(raw));
+	appendRaw32(buffer, raw);
+}
+
+void appendRawDouble(std::string& buffer, const RawFormat format, const double value)
+{
+	uint64_t raw;
+	if (format == RAW_FLOAT32)
+	{
+		appendRawFloat(buffer, format, static_cast<float>(value));
+		return;
+	}
+	else if (format == RAW_INT64)
+	{
+		// NaN (failed row), inf and values out of range have no integer - use
+		// the smallest int64 (the comparisons are false for NaN)
+		bool fits = (value >= INT64_RANGE_MIN) && (value < INT64_RANGE_END);
+		int64_t tmp = fits ? static_cast<int64_t>(value) : INT64_MIN;
+		memcpy(&raw, &tmp, sizeof(raw));
+	}
+	else
+	{
+		memcpy(&raw, &value, sizeof(raw));
+	}
+	appendRaw(buffer, raw);
+}
+
+void appendRawInt(std::string& buffer, const RawFormat format, const int64_t value)
+{
+	uint64_t raw;
+	if (format == RAW_FLOAT32)
+	{
+		appendRawFloat(buffer, format, static_cast<float>(value));
+		return;
+	}
+	else if (format == RAW_FLOAT64)
+	{
+		double tmp = static_cast<double>(value);
+		memcpy(&raw, &tmp, sizeof(raw));
+	}
+	else
+	{
+		memcpy(&raw, &value, sizeof(raw));
+	}
+	appendRaw(buffer, raw);
+}
+
+
+RawWriter::RawWriter()
+	: m_file(nullptr)
+	, m_closeFile(false)
+	, m_format(RAW_NONE)
+{
+}
+
+RawWriter::~RawWriter()
+{
+	close();
+}
+
+bool RawWriter::open(const std::string& fileName, const RawFormat format, std::string& message)
+{
+	close();
+
+	m_format = format;
+	if (fileName.empty() || (fileName == "-"))
+	{
+#ifdef _MSC_VER
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		m_file = stdout;
+	}
+	else
+	{
+		m_file = fopen(fileName.c_str(), "wb");
+		if (m_file == nullptr)
+		{
+			message = "Cannot write '" + fileName + "'";
+			return false;
+		}
+		m_closeFile = true;
+	}
+
+	m_buffer.clear();
+	m_buffer.reserve(RAW_BUFFER_SIZE);
+	return true;
+}
+
+bool RawWriter::putDouble(const double value)
+{
+	appendRawDouble(m_buffer, m_format, value);
+	return (m_buffer.size() < RAW_BUFFER_SIZE) || flush();
+}
+
+bool RawWriter::putInt(const int64_t value)
+{
+	appendRawInt(m_buffer, m_format, value);
+	return (m_buffer.size() < RAW_BUFFER_SIZE) || flush();
+}
+
+bool RawWriter::write(const std::string& values)
+{
+	if (!flush() || (m_file == nullptr))
+		return false;
+
+	return fwrite(values.data(), 1, values.size(), m_file) == values.size();
+}
+
+bool RawWriter::flush()
+{
+	if ((m_file == nullptr) || m_buffer.empty())
+		return true;
+
+	bool ok = fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) == m_buffer.size();
+	m_buffer.clear();
+	return ok;
+}
+
+bool RawWriter::close()
+{
+	if (m_file == nullptr)
+		return true;
+
+	bool ok = flush();
+	if (m_closeFile)
+	{
+		ok = (fclose(m_file) == 0) && ok;
+	}
+	else
+	{
+		ok = (fflush(m_file) == 0) && ok;
+	}
+	m_file = nullptr;
+	m_closeFile = false;
+	return ok;
+}
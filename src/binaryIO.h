@@ -0,0 +1,169 @@
+/// @file
+///
+/// @brief Header for raw (binary) array input and output.
+///
+/// Raw arrays are little-endian 64-bit numbers (float64 or int64) without any
+/// header. Input files are memory-mapped and read in place.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/// @brief Raw array formats
+enum RawFormat : uint8_t
+{
+	RAW_NONE = 0,  // Text
+	RAW_FLOAT64,   // Little-endian IEEE-754 binary-64
+	RAW_INT64,     // Little-endian two's complement int64
+	RAW_FLOAT32    // Little-endian IEEE-754 binary-32
+};
+
+/// @brief Bytes of one value
+inline size_t rawSize(const RawFormat format)
+{
+	return (format == RAW_FLOAT32) ? sizeof(float) : sizeof(uint64_t);
+}
+
+/// @brief Reads raw 32-bit value (little-endian) from any alignment
+inline uint32_t readRaw32(const char* ptr)
+{
+	uint32_t value;
+	memcpy(&value, ptr, sizeof(value));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	value = __builtin_bswap32(value);
+#endif
+	return value;
+}
+
+/// @brief Reads raw 64-bit value (little-endian) from any alignment
+inline uint64_t readRaw64(const char* ptr)
+{
+	uint64_t value;
+	memcpy(&value, ptr, sizeof(value));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	value = __builtin_bswap64(value);
+#endif
+	return value;
+}
+
+/// @brief Reads raw value of any format as a double
+inline double readRawDouble(const char* ptr, const RawFormat format)
+{
+	if (format == RAW_FLOAT32)
+	{
+		uint32_t raw = readRaw32(ptr);
+		float value;
+		memcpy(&value, &raw, sizeof(value));
+		return value;
+	}
+
+	uint64_t raw = readRaw64(ptr);
+	if (format == RAW_INT64)
+	{
+		int64_t value;
+		memcpy(&value, &raw, sizeof(value));
+		return static_cast<double>(value);
+	}
+	double value;
+	memcpy(&value, &raw, sizeof(value));
+	return value;
+}
+
+/// @brief Appends value to buffer in raw format (converted as needed) - in
+/// int64 doubles truncate; NaN, inf and values beyond int64 become INT64_MIN
+void appendRawDouble(std::string& buffer, const RawFormat format, const double value);
+void appendRawInt(std::string& buffer, const RawFormat format, const int64_t value);
+void appendRawFloat(std::string& buffer, const RawFormat format, const float value);
+
+/// @brief Read-only memory-mapped file.
+/// NOTE: Falls back to reading the file into memory where mmap() is not available
+class MappedFile
+{
+public:
+	MappedFile();
+
+	~MappedFile();
+
+	/// @brief Maps the file - previous file is closed
+	bool open(const std::string& fileName, std::string& message);
+
+	void close();
+
+	const char* data() const { return m_data; }
+
+	size_t size() const { return m_size; }
+
+private:
+	// Not copyable
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* m_data;
+	size_t m_size;
+
+	// Buffer used when file cannot be mapped
+	std::vector<char> m_buffer;
+};
+
+/// @brief Raw input column - one variable of a (possibly interleaved) raw file
+typedef struct _rawColumn
+{
+	const char* data;   // First value
+	size_t      stride; // Bytes between rows
+	RawFormat   format;
+} RawColumn;
+
+/// @brief Buffered raw output of results
+class RawWriter
+{
+public:
+	RawWriter();
+
+	~RawWriter();
+
+	/// @brief Opens output file - empty file name is stdout
+	bool open(const std::string& fileName, const RawFormat format, std::string& message);
+
+	/// @brief Appends a value (converted to output format) - false if a write failed
+	bool putDouble(const double value);
+	bool putInt(const int64_t value);
+
+	/// @brief Writes values already in raw format (see appendRawDouble())
+	bool write(const std::string& values);
+
+	/// @brief Writes out buffered values
+	bool flush();
+
+	bool close();
+
+	RawFormat format() const { return m_format; }
+
+private:
+	RawWriter(const RawWriter&) = delete;
+	RawWriter& operator=(const RawWriter&) = delete;
+
+	FILE* m_file;
+	bool m_closeFile;
+	RawFormat m_format;
+	std::string m_buffer;
+};
@@ -0,0 +1,506 @@
+/// @file
+///
+/// @brief Implementation of BlockProgram - a Program run over blocks of values.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "blockProgram.h"
+#include "fncKernels.h"
+#include "numUnit.h"
+
+/// @brief Column operations of function types (same math as the Num kernels)
+typedef struct _vecFunction
+{
+	FunctionValue type;
+	VecCode       code;
+} VecFunction;
+
+static const VecFunction s_vecFunctions[] =
+{
+	{F_ADD,   VEC_ADD},
+	{F_SUB,   VEC_SUB},
+	{F_MUL,   VEC_MUL},
+	{F_DIV,   VEC_DIV},
+	{F_POW,   VEC_POW},
+	{F_ROOT,  VEC_ROOT},
+	{F_MOD,   VEC_MOD},
+	{F_MAX,   VEC_MAX},
+	{F_MIN,   VEC_MIN},
+	{F_LT,    VEC_LT},
+	{F_LE,    VEC_LE},
+	{F_EQ,    VEC_EQ},
+	{F_NE,    VEC_NE},
+	{F_GE,    VEC_GE},
+	{F_GT,    VEC_GT},
+	{F_SQRT,  VEC_SQRT},
+	{F_ABS,   VEC_ABS},
+	{F_NEG,   VEC_NEG},
+	{F_INV,   VEC_INV},
+	{F_EXP,   VEC_EXP},
+	{F_E10X,  VEC_EXP10},
+	{F_EXP2,  VEC_EXP2},
+	{F_LN,    VEC_LN},
+	{F_LOG,   VEC_LOG10},
+	{F_LOG2,  VEC_LOG2},
+	{F_SIN,   VEC_SIN},
+	{F_COS,   VEC_COS},
+	{F_TAN,   VEC_TAN},
+	{F_ASIN,  VEC_ASIN},
+	{F_ACOS,  VEC_ACOS},
+	{F_ATAN,  VEC_ATAN},
+	{F_SINH,  VEC_SINH},
+	{F_COSH,  VEC_COSH},
+	{F_TANH,  VEC_TANH},
+	{F_ASINH, VEC_ASINH},
+	{F_ACOSH, VEC_ACOSH},
+	{F_ATANH, VEC_ATANH},
+	{F_CEIL,  VEC_CEIL},
+	{F_FLOOR, VEC_FLOOR},
+	{F_FRAC,  VEC_FRAC},
+	{F_SELECT, VEC_SELECT},
+};
+
+BlockProgram::BlockProgram()
+	: m_columns(0)
+	, m_constantResult(false)
+	, m_result{SRC_CONSTANT, 0, 0.}
+{
+}
+
+// static
+bool BlockProgram::findCode(const FunctionValue type, VecCode& code)
+{
+	for (const auto& it : s_vecFunctions)
+	{
+		if (it.type == type)
+		{
+			code = it.code;
+			return true;
+		}
+	}
+	return false;
+}
+
+// static
+size_t BlockProgram::codeArguments(const VecCode code)
+{
+	if (code == VEC_SELECT)
+		return 3;
+	return (code < VEC_SQRT) ? 2 : 1;
+}
+
+bool BlockProgram::build(const Program& program, std::string& message)
+{
+	m_ops.clear();
+	m_stack.clear();
+	m_columns = 0;
+	m_constantResult = false;
+
+	for (const auto& it : program.steps())
+	{
+		switch (it.type)
+		{
+		case STEP_NUMBER:
+			m_stack.push_back(BuildValue{false, it.value, VecArg{SRC_CONSTANT, 0, 0.}});
+			break;
+
+		case STEP_VARIABLE:
+			// Units or format of a variable would be kept by unary functions
+			if (!it.value.m_unit.keyString().empty() || !it.value.m_format.empty())
+			{
+				message = "Variable '" + program.slotName(it.slot) + "' has units or format";
+				return false;
+			}
+			m_stack.push_back(BuildValue{true, Num(), VecArg{SRC_INPUT, size_t(it.slot), 0.}});
+			break;
+
+		case STEP_FUNCTION:
+			if (!addFunction(it.func, message))
+				return false;
+			break;
+		}
+	}
+
+	if (m_stack.empty())
+	{
+		message = "No results";
+		return false;
+	}
+
+	const BuildValue& top = m_stack.back();
+	m_constantResult = !top.varying;
+	m_constant = top.constant;
+	m_result = top.arg;
+	m_stack.clear();
+	return true;
+}
+
+bool BlockProgram::addFunction(const Functions& fn, std::string& message)
+{
+	// ',' leaves its number as the next argument
+	if (fn.type == F_PUSH)
+		return true;
+
+	size_t args = Program::arguments(fn);
+	size_t pos = m_stack.size() - args;
+
+	// Condition is a constant - only one operand is ever used
+	if ((fn.type == F_SELECT) && !m_stack[pos].varying)
+	{
+		Num cond = m_stack[pos].constant;
+		bool flag = cond.isInteger() ? (cond.m_lValue != 0) : (cond.m_dValue != 0.);
+		BuildValue value = m_stack[flag ? (pos + 1) : (pos + 2)];
+		if (value.varying && (value.arg.source == SRC_COLUMN))
+		{
+			// Scratch column of a value is its stack position - later steps write
+			// to the column it was computed in
+			VecArg none{SRC_CONSTANT, 0, 0.};
+			m_ops.push_back(VecOp{VEC_COPY, pos, value.arg, none, none, 1., 0., nullptr});
+			value.arg = VecArg{SRC_COLUMN, pos, 0.};
+		}
+		m_stack.resize(pos);
+		m_stack.push_back(value);
+		return true;
+	}
+
+	bool varying = false;
+	for (size_t i = pos; i < m_stack.size(); i++)
+	{
+		varying = varying || m_stack[i].varying;
+	}
+
+	if (!varying)
+	{
+		// Constants only - run the function now
+		NumStack params;
+		for (size_t i = pos; i < m_stack.size(); i++)
+		{
+			params.push_back(m_stack[i].constant);
+		}
+		if ((fn.type == F_RESULT) || !(*fn.f)(params) || (params.size() != 1))
+		{
+			message = "Function '" + fn.str + "' cannot run in blocks";
+			return false;
+		}
+		m_stack.resize(pos);
+		m_stack.push_back(BuildValue{false, params.back(), VecArg{SRC_CONSTANT, 0, 0.}});
+		return true;
+	}
+
+	VecCode code = VEC_PLUGIN;
+	const PluginFunction* plugin = Plugins::isPlugin(fn.type) ? &Plugins::function(fn.type) : nullptr;
+	if (!plugin && (!findCode(fn.type, code) || (codeArguments(code) != args)))
+	{
+		message = "Function '" + fn.str + "' cannot run in blocks";
+		return false;
+	}
+
+	// Operands - constants become doubles (one side is a double column)
+	VecArg operands[FNC_PLUGIN_ARGUMENTS] {};
+	for (size_t i = 0; i < args; i++)
+	{
+		BuildValue& value = m_stack[pos + i];
+		if (!value.varying)
+		{
+			Num& no = value.constant;
+			if (!no.isDouble() && !no.isInteger())
+			{
+				message = "Number '" + no.asString() + "' cannot be used in blocks";
+				return false;
+			}
+			no.convertTo(NUM_DOUBLE);
+			value.arg = VecArg{SRC_CONSTANT, 0, no.m_dValue};
+		}
+		operands[i] = value.arg;
+	}
+
+	// Result replaces the first operand on the stack - same scratch column
+	size_t dst = pos;
+	if ((dst + 1) > m_columns)
+	{
+		m_columns = dst + 1;
+	}
+	VecArg result{SRC_COLUMN, dst, 0.};
+	VecArg none{SRC_CONSTANT, 0, 0.};
+
+	// Angles are in the default unit (inputs have no units) - see Num::convertToRads()
+	bool toRads = ((code == VEC_SIN) || (code == VEC_COS) || (code == VEC_TAN)
+		|| (plugin && (plugin->units == FNC_UNITS_ANGLE))) && !FunctionType::isDefaultRad();
+	bool fromRads = ((code == VEC_ASIN) || (code == VEC_ACOS) || (code == VEC_ATAN)) && !FunctionType::isDefaultRad();
+
+	if (toRads)
+	{
+		UnitConversion conv;
+		if (!conv.resolve("deg", "rad", message))
+			return false;
+		m_ops.push_back(VecOp{VEC_AFFINE, dst, operands[0], none, none, conv.scale(), conv.offset(), nullptr});
+		operands[0] = result;
+	}
+
+	m_ops.push_back(VecOp{code, dst, operands[0], (args > 1) ? operands[1] : none, (args > 2) ? operands[2] : none, 1., 0., plugin});
+
+	if (fromRads)
+	{
+		UnitConversion conv;
+		if (!conv.resolve("rad", "deg", message))
+			return false;
+		m_ops.push_back(VecOp{VEC_AFFINE, dst, result, none, none, conv.scale(), conv.offset(), nullptr});
+	}
+
+	m_stack.resize(pos);
+	m_stack.push_back(BuildValue{true, Num(), result});
+	return true;
+}
+
+/// @brief Column of operand - nullptr for constants
+template <typename T>
+static inline const T* column(const VecArg& arg, const T* const* inputs, const T* scratch)
+{
+	switch (arg.source)
+	{
+	case SRC_INPUT:
+		return inputs[arg.index];
+	case SRC_COLUMN:
+		return scratch + (arg.index * BLOCK_VALUES);
+	default:
+		return nullptr;
+	}
+}
+
+/// @brief Runs binary function over a block (one side may be constant)
+template <typename T, typename F>
+static inline void runBinary(F f, const T* a, const T ka, const T* b, const T kb, T* out, const size_t count)
+{
+	if (a == nullptr)
+	{
+		for (size_t i = 0; i < count; i++)
+			out[i] = f(ka, b[i]);
+	}
+	else if (b == nullptr)
+	{
+		for (size_t i = 0; i < count; i++)
+			out[i] = f(a[i], kb);
+	}
+	else
+	{
+		for (size_t i = 0; i < count; i++)
+			out[i] = f(a[i], b[i]);
+	}
+}
+
+/// @brief Picks b or c by condition a (not constant - see addFunction()).
+/// Both sides are read and blended, so the loops vectorize without branches.
+template <typename T>
+static inline void runSelect(const T* a, const T* b, const T kb, const T* c, const T kc, T* out, const size_t count)
+{
+	if ((b != nullptr) && (c != nullptr))
+	{
+		for (size_t i = 0; i < count; i++)
+			out[i] = fnc::kernel::select(a[i], b[i], c[i]);
+	}
+	else if (b != nullptr)
+	{
+		for (size_t i = 0; i < count; i++)
+			out[i] = fnc::kernel::select(a[i], b[i], kc);
+	}
+	else if (c != nullptr)
+	{
+		for (size_t i = 0; i < count; i++)
+			out[i] = fnc::kernel::select(a[i], kb, c[i]);
+	}
+	else
+	{
+		for (size_t i = 0; i < count; i++)
+			out[i] = fnc::kernel::select(a[i], kb, kc);
+	}
+}
+
+/// @brief Runs unary function over a block
+template <typename T, typename F>
+static inline void runUnary(F f, const T* a, T* out, const size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		out[i] = f(a[i]);
+}
+
+/// @brief Argument column of a plugin kernel - copied if it is the result column
+static inline const double* pluginColumn(const double* column, const double* out, double* copy, const size_t count)
+{
+	if (column != out)
+		return column;
+
+	memcpy(copy, column, count * sizeof(double));
+	return copy;
+}
+
+/// @brief Kernels take doubles - float columns are converted
+static inline const double* pluginColumn(const float* column, const float* /* out - never the same column */, double* copy, const size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		copy[i] = column[i];
+	return copy;
+}
+
+/// @brief Where the kernel writes results - double columns directly
+static inline double* pluginResults(double* out, double* /* results */)
+{
+	return out;
+}
+
+static inline double* pluginResults(float* /* out */, double* results)
+{
+	return results;
+}
+
+/// @brief Copies results into float columns - double ones have them already
+static inline void storeResults(const double* /* results */, double* /* out */, const size_t /* count */)
+{
+}
+
+static inline void storeResults(const double* results, float* out, const size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		out[i] = static_cast<float>(results[i]);
+}
+
+/// @brief Runs plugin function over a block - constants become columns
+template <typename T>
+static void runPlugin(const PluginFunction& fn, const T* const* columns, const T* constants, T* out, const size_t count)
+{
+	double copies[FNC_PLUGIN_ARGUMENTS][BLOCK_VALUES];
+	double results[BLOCK_VALUES];
+	const double* args[FNC_PLUGIN_ARGUMENTS];
+	for (size_t j = 0; j < fn.arity; j++)
+	{
+		if (columns[j] == nullptr)
+		{
+			std::fill(copies[j], copies[j] + count, static_cast<double>(constants[j]));
+			args[j] = copies[j];
+		}
+		else
+		{
+			args[j] = pluginColumn(columns[j], out, copies[j], count);
+		}
+	}
+
+	double* result = pluginResults(out, results);
+	Plugins::runArray(fn, args, count, result);
+	storeResults(result, out, count);
+}
+
+void BlockProgram::run(const double* const* inputs, const size_t count, double* scratch, double* results) const
+{
+	runColumns(inputs, count, scratch, results);
+}
+
+void BlockProgram::run(const float* const* inputs, const size_t count, float* scratch, float* results) const
+{
+	runColumns(inputs, count, scratch, results);
+}
+
+template <typename T>
+void BlockProgram::runColumns(const T* const* inputs, const size_t count, T* scratch, T* results) const
+{
+	for (const auto& op : m_ops)
+	{
+		T* out = scratch + (op.dst * BLOCK_VALUES);
+		const T* a = column(op.a, inputs, scratch);
+		const T* b = column(op.b, inputs, scratch);
+		const T ka = static_cast<T>(op.a.value);
+		const T kb = static_cast<T>(op.b.value);
+		const T* c = column(op.c, inputs, scratch);
+		const T kc = static_cast<T>(op.c.value);
+
+		switch (op.code)
+		{
+		case VEC_AFFINE:
+			{
+				const T scale = static_cast<T>(op.scale);
+				const T offset = static_cast<T>(op.offset);
+				runUnary([scale, offset](T x) { return fnc::kernel::affine(x, scale, offset); }, a, out, count);
+			}
+			break;
+		case VEC_ADD:   runBinary([](T x, T y) { return fnc::kernel::add(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_SUB:   runBinary([](T x, T y) { return fnc::kernel::sub(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_MUL:   runBinary([](T x, T y) { return fnc::kernel::mul(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_DIV:   runBinary([](T x, T y) { return fnc::kernel::div(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_POW:   runBinary([](T x, T y) { return fnc::kernel::pow(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_ROOT:  runBinary([](T x, T y) { return fnc::kernel::root(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_MOD:   runBinary([](T x, T y) { return fnc::kernel::mod(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_MAX:   runBinary([](T x, T y) { return fnc::kernel::max(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_MIN:   runBinary([](T x, T y) { return fnc::kernel::min(x, y); }, a, ka, b, kb, out, count); break;
+		// Comparisons give 1 or 0 (see fncKernels.h)
+		case VEC_LT:    runBinary([](T x, T y) { return fnc::kernel::lt(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_LE:    runBinary([](T x, T y) { return fnc::kernel::le(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_EQ:    runBinary([](T x, T y) { return fnc::kernel::eq(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_NE:    runBinary([](T x, T y) { return fnc::kernel::ne(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_GE:    runBinary([](T x, T y) { return fnc::kernel::ge(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_GT:    runBinary([](T x, T y) { return fnc::kernel::gt(x, y); }, a, ka, b, kb, out, count); break;
+		case VEC_SQRT:  runUnary([](T x) { return fnc::kernel::sqrt(x); }, a, out, count); break;
+		case VEC_ABS:   runUnary([](T x) { return fnc::kernel::abs(x); }, a, out, count); break;
+		case VEC_NEG:   runUnary([](T x) { return fnc::kernel::neg(x); }, a, out, count); break;
+		case VEC_INV:   runUnary([](T x) { return fnc::kernel::inv(x); }, a, out, count); break;
+		case VEC_EXP:   runUnary([](T x) { return fnc::kernel::exp(x); }, a, out, count); break;
+		case VEC_EXP10: runUnary([](T x) { return fnc::kernel::exp10(x); }, a, out, count); break;
+		case VEC_EXP2:  runUnary([](T x) { return fnc::kernel::exp2(x); }, a, out, count); break;
+		case VEC_LN:    runUnary([](T x) { return fnc::kernel::ln(x); }, a, out, count); break;
+		case VEC_LOG10: runUnary([](T x) { return fnc::kernel::log10(x); }, a, out, count); break;
+		case VEC_LOG2:  runUnary([](T x) { return fnc::kernel::log2(x); }, a, out, count); break;
+		case VEC_SIN:   runUnary([](T x) { return fnc::kernel::sin(x); }, a, out, count); break;
+		case VEC_COS:   runUnary([](T x) { return fnc::kernel::cos(x); }, a, out, count); break;
+		case VEC_TAN:   runUnary([](T x) { return fnc::kernel::tan(x); }, a, out, count); break;
+		case VEC_ASIN:  runUnary([](T x) { return fnc::kernel::asin(x); }, a, out, count); break;
+		case VEC_ACOS:  runUnary([](T x) { return fnc::kernel::acos(x); }, a, out, count); break;
+		case VEC_ATAN:  runUnary([](T x) { return fnc::kernel::atan(x); }, a, out, count); break;
+		case VEC_SINH:  runUnary([](T x) { return fnc::kernel::sinh(x); }, a, out, count); break;
+		case VEC_COSH:  runUnary([](T x) { return fnc::kernel::cosh(x); }, a, out, count); break;
+		case VEC_TANH:  runUnary([](T x) { return fnc::kernel::tanh(x); }, a, out, count); break;
+		case VEC_ASINH: runUnary([](T x) { return fnc::kernel::asinh(x); }, a, out, count); break;
+		case VEC_ACOSH: runUnary([](T x) { return fnc::kernel::acosh(x); }, a, out, count); break;
+		case VEC_ATANH: runUnary([](T x) { return fnc::kernel::atanh(x); }, a, out, count); break;
+		case VEC_CEIL:  runUnary([](T x) { return fnc::kernel::ceil(x); }, a, out, count); break;
+		case VEC_FLOOR: runUnary([](T x) { return fnc::kernel::floor(x); }, a, out, count); break;
+		case VEC_FRAC:  runUnary([](T x) { return fnc::kernel::frac(x); }, a, out, count); break;
+		case VEC_COPY:  runUnary([](T x) { return x; }, a, out, count); break;
+		case VEC_SELECT: runSelect(a, b, kb, c, kc, out, count); break;
+		case VEC_PLUGIN:
+			{
+				const T* columns[] = {a, b, c};
+				const T constants[] = {ka, kb, kc};
+				runPlugin(*op.plugin, columns, constants, out, count);
+			}
+			break;
+		}
+	}
+
+	if (m_constantResult)
+	{
+		Num no(m_constant);
+		no.convertTo(NUM_DOUBLE);
+		const T value = static_cast<T>(no.m_dValue);
+		for (size_t i = 0; i < count; i++)
+			results[i] = value;
+		return;
+	}
+
+	const T* result = column(m_result, inputs, scratch);
+	memcpy(results, result, count * sizeof(T));
+}
@@ -0,0 +1,181 @@
+/// @file
+///
+/// @brief Header file for BlockProgram - a Program run over blocks of values.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include "program.h"
+#include "plugins.h"
+
+/// @brief Values run through each step at once - columns stay in L1 cache
+constexpr size_t BLOCK_VALUES {1024};
+
+/// @brief Column operations
+enum VecCode : uint8_t
+{
+	VEC_AFFINE = 0,  // a * scale + offset (unit conversion)
+	VEC_ADD,
+	VEC_SUB,
+	VEC_MUL,
+	VEC_DIV,
+	VEC_POW,
+	VEC_ROOT,
+	VEC_MOD,
+	VEC_MAX,
+	VEC_MIN,
+	VEC_LT,     // Comparisons - 1 or 0
+	VEC_LE,
+	VEC_EQ,
+	VEC_NE,
+	VEC_GE,
+	VEC_GT,
+	VEC_SQRT,
+	VEC_ABS,
+	VEC_NEG,
+	VEC_INV,
+	VEC_EXP,
+	VEC_EXP10,
+	VEC_EXP2,
+	VEC_LN,
+	VEC_LOG10,
+	VEC_LOG2,
+	VEC_SIN,
+	VEC_COS,
+	VEC_TAN,
+	VEC_ASIN,
+	VEC_ACOS,
+	VEC_ATAN,
+	VEC_SINH,
+	VEC_COSH,
+	VEC_TANH,
+	VEC_ASINH,
+	VEC_ACOSH,
+	VEC_ATANH,
+	VEC_CEIL,
+	VEC_FLOOR,
+	VEC_FRAC,
+	VEC_COPY,   // a unchanged (select with a constant condition)
+	VEC_SELECT, // a != 0 ? b : c - blended, not branched
+	VEC_PLUGIN  // Array kernel of a plugin function (a, b, c as it takes them)
+};
+
+/// @brief Where an operand comes from
+enum VecSource : uint8_t
+{
+	SRC_CONSTANT = 0,  // Same value for every row
+	SRC_INPUT,         // Input column (slot)
+	SRC_COLUMN         // Scratch column (result of an earlier step)
+};
+
+/// @brief Operand of a column operation
+typedef struct _vecArg
+{
+	VecSource source;
+	size_t    index;   // Slot or scratch column
+	double    value;   // SRC_CONSTANT
+} VecArg;
+
+/// @brief Single column operation - result goes to scratch column 'dst'
+typedef struct _vecOp
+{
+	VecCode code;
+	size_t  dst;
+	VecArg  a;
+	VecArg  b;       // Binary operations
+	VecArg  c;       // VEC_SELECT (a != 0 ? b : c)
+	double  scale;   // VEC_AFFINE
+	double  offset;
+	const PluginFunction* plugin;  // VEC_PLUGIN
+} VecOp;
+
+// How BlockProgram works:
+// Program runs one row at a time on a stack of Num. When every value that
+// depends on an input is a plain double (no units, no format), the same steps
+// can run column by column instead: each step is one tight loop over a block
+// of rows, which the compiler vectorizes. Steps on constants only are run
+// once when building (with the usual functions), so integer math and units of
+// constants behave as they do in Program. Anything else (unit conversions of
+// inputs, ';', ...) is not built - callers fall back to Program::run().
+// Inputs are always doubles - an integer input is not integer math here.
+// Comparisons give 1 or 0 in every row and select() picks from both of its
+// columns with the condition as a mask, so rows never branch.
+// Functions of plugins run their array kernel on the block (see plugins.h).
+
+class BlockProgram
+{
+public:
+	BlockProgram();
+
+	/// @brief Builds column operations from a resolved program
+	/// @return false if program cannot run in blocks (message says why)
+	bool build(const Program& program, std::string& message);
+
+	/// @brief Result does not depend on inputs
+	bool constantResult() const { return m_constantResult; }
+
+	/// @brief Result when constantResult()
+	const Num& constant() const { return m_constant; }
+
+	/// @brief Scratch doubles needed per row (see run())
+	size_t columns() const { return m_columns; }
+
+	/// @brief Runs 'count' rows (up to BLOCK_VALUES).
+	/// 'inputs' has one column per slot, 'scratch' holds columns() * BLOCK_VALUES.
+	/// Safe to call from many threads (each with its own scratch).
+	void run(const double* const* inputs, const size_t count, double* scratch, double* results) const;
+
+	/// @brief Same in float32 - constants, conversions and math are float32
+	void run(const float* const* inputs, const size_t count, float* scratch, float* results) const;
+
+	/// @brief Number of column operations
+	size_t ops() const { return m_ops.size(); }
+
+private:
+	/// @brief Adds operation on top of build stack (constants are run now)
+	bool addFunction(const Functions& fn, std::string& message);
+
+	template <typename T>
+	void runColumns(const T* const* inputs, const size_t count, T* scratch, T* results) const;
+
+	/// @brief Operation for function type - false if there is none
+	static bool findCode(const FunctionValue type, VecCode& code);
+
+	/// @brief Operands of operation
+	static size_t codeArguments(const VecCode code);
+
+	std::vector<VecOp> m_ops;
+
+	// Build stack - constants or varying (column) values
+	typedef struct _buildValue
+	{
+		bool   varying;
+		Num    constant;
+		VecArg arg;
+	} BuildValue;
+	std::vector<BuildValue> m_stack;
+
+	size_t m_columns;
+
+	bool m_constantResult;
+	Num m_constant;
+	VecArg m_result;
+};
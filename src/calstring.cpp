@@ -127,13 +127,8 @@ bool CalString::isVariable() const
 // Shifts itself left, discarding the contents
 CalString& CalString::left(const int shift)
 {
-	CalString tmp = *this;
-	int end = size();
-	for(int i = 0, j = shift; j < end; i++, j++)
-	{
-		at(i) = tmp.at(j);
-	}
-	resize(end-shift);
+	// Moves the rest in place - no copy of the whole string
+	erase(0, shift);
 	return *this;
 }
 
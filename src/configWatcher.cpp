@@ -0,0 +1,221 @@
+/// @file
+///
+/// @brief Implementation of ConfigWatcher - reloads INI and units files when they change.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+ #include <poll.h>
+ #include <unistd.h>
+ #include <sys/inotify.h>
+#endif
+
+#include "configWatcher.h"
+#include "settings.h"
+
+/// @brief Quiet time after a change before the files are read (ms)
+constexpr int RELOAD_SETTLE_MS {100};
+
+/// @brief Bytes of inotify events read at once
+constexpr size_t WATCH_BUFFER_SIZE {4096};
+
+/// @brief Directory part of 'path' with its '/' ("" - current directory)
+static std::string directoryOf(const std::string& path)
+{
+	size_t slash = path.find_last_of('/');
+	return (slash == std::string::npos) ? std::string() : path.substr(0, slash + 1);
+}
+
+ConfigWatcher::ConfigWatcher(const std::string& iniPath, FncOutput report)
+	: m_iniPath(iniPath)
+	, m_report(report)
+	, m_reloads{0}
+	, m_inotify(-1)
+	, m_wake{-1, -1}
+{
+}
+
+ConfigWatcher::~ConfigWatcher()
+{
+	stop();
+}
+
+bool ConfigWatcher::reload(std::string& message)
+{
+	// Built and checked before anyone sees it
+	std::shared_ptr<Settings> settings = std::make_shared<Settings>();
+	if (!settings->load(m_iniPath, message))
+		return false;
+
+	Settings::publish(settings);
+	m_reloads++;
+
+	// Units file may have been renamed
+	return (m_inotify < 0) || watch(settings->unitsPath(), message);
+}
+
+#ifndef __linux__
+
+bool ConfigWatcher::start(std::string& message)
+{
+	message = "Watching settings is not available on this platform";
+	return false;
+}
+
+void ConfigWatcher::stop()
+{
+}
+
+bool ConfigWatcher::watch(const std::string& unitsPath, std::string& message)
+{
+	message = "Watching settings is not available on this platform";
+	return false;
+}
+
+void ConfigWatcher::work()
+{
+}
+
+#else
+
+bool ConfigWatcher::start(std::string& message)
+{
+	if (m_thread.joinable())
+		return true;
+
+	m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if ((m_inotify < 0) || (pipe(m_wake) != 0))
+	{
+		message = std::string("Cannot watch settings - ") + strerror(errno);
+		stop();
+		return false;
+	}
+
+	if (!watch(Settings::current()->unitsPath(), message))
+	{
+		stop();
+		return false;
+	}
+
+	m_thread = std::thread(&ConfigWatcher::work, this);
+	return true;
+}
+
+void ConfigWatcher::stop()
+{
+	if (m_thread.joinable())
+	{
+		char wake = 0;
+		if (write(m_wake[1], &wake, 1) < 0)
+		{
+			// Pipe is ours - cannot be full
+		}
+		m_thread.join();
+	}
+
+	for (int fd : {m_inotify, m_wake[0], m_wake[1]})
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+	}
+	m_inotify = -1;
+	m_wake[0] = -1;
+	m_wake[1] = -1;
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_directories.clear();
+	m_files.clear();
+}
+
+bool ConfigWatcher::watch(const std::string& unitsPath, std::string& message)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	for (const std::string& path : {m_iniPath, unitsPath})
+	{
+		if (path.empty() || (std::find(m_files.begin(), m_files.end(), path) != m_files.end()))
+			continue;
+
+		// Files written in place and files moved over the old ones
+		std::string directory = directoryOf(path);
+		int wd = inotify_add_watch(m_inotify, directory.empty() ? "." : directory.c_str(),
+			IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (wd < 0)
+		{
+			message = "Cannot watch '" + directory + "' - " + strerror(errno);
+			return false;
+		}
+		m_directories[wd] = directory;
+		m_files.push_back(path);
+	}
+	return true;
+}
+
+void ConfigWatcher::work()
+{
+	alignas(struct inotify_event) char buffer[WATCH_BUFFER_SIZE];
+	bool changed = false;
+	while (true)
+	{
+		// After a change, wait until the files are quiet
+		struct pollfd fds[2] = {{m_inotify, POLLIN, 0}, {m_wake[0], POLLIN, 0}};
+		int ready = poll(fds, 2, changed ? RELOAD_SETTLE_MS : -1);
+		if ((ready < 0) && (errno != EINTR))
+			break;
+
+		if (fds[1].revents != 0)
+			break;
+
+		if (ready == 0)
+		{
+			changed = false;
+			std::string message;
+			bool ok = reload(message);
+			if (m_report)
+			{
+				m_report(ok ? "Settings reloaded from '" + m_iniPath + "'"
+					: "! " + message + " - settings kept");
+			}
+			continue;
+		}
+
+		ssize_t size;
+		while ((size = read(m_inotify, buffer, sizeof(buffer))) > 0)
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			for (char* at = buffer; at < buffer + size; )
+			{
+				const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(at);
+				at += sizeof(struct inotify_event) + event->len;
+
+				auto directory = m_directories.find(event->wd);
+				if ((event->len == 0) || (directory == m_directories.end()))
+					continue;
+
+				std::string path = directory->second + event->name;
+				changed = changed || (std::find(m_files.begin(), m_files.end(), path) != m_files.end());
+			}
+		}
+	}
+}
+
+#endif
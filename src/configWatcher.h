@@ -0,0 +1,87 @@
+/// @file
+///
+/// @brief Header for ConfigWatcher - reloads INI and units files when they change.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fncLib.h"
+
+// How ConfigWatcher works:
+// A thread waits (inotify) for the INI file and the units file it names to be
+// written or replaced, reads both with Settings::load() and publishes them -
+// all on the watcher thread, so evaluations never parse or build tables; they
+// take the new Settings when they start next (see settings.h). If a file does
+// not parse, the published settings stay and the message goes to 'report'.
+// Directories are watched, not files: editors often save by writing another
+// file and renaming it, which drops a watch on the file. Saves come in bursts
+// (several writes, a rename), so a reload waits until the files are quiet.
+// inotify is Linux only - elsewhere start() fails and reload() still works.
+
+class ConfigWatcher
+{
+public:
+	/// @param report - gets "settings reloaded" and error messages (from the
+	/// watcher thread); nullptr drops them
+	ConfigWatcher(const std::string& iniPath, FncOutput report);
+
+	/// @brief Stops watching
+	~ConfigWatcher();
+
+	/// @brief Starts watcher thread
+	bool start(std::string& message);
+
+	/// @brief Stops watcher thread (nothing if not started)
+	void stop();
+
+	/// @brief Reads and publishes the files now, on the calling thread
+	bool reload(std::string& message);
+
+	/// @brief Settings published by reload()
+	uint64_t reloads() const { return m_reloads.load(); }
+
+private:
+	ConfigWatcher(const ConfigWatcher&) = delete;
+	ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+	// Watches directories of the INI file and of 'unitsPath'
+	bool watch(const std::string& unitsPath, std::string& message);
+
+	// Watcher thread
+	void work();
+
+	std::string m_iniPath;
+	FncOutput m_report;
+	std::atomic<uint64_t> m_reloads;
+
+	std::mutex m_lock;                          // Watches (reload() may run on any thread)
+	std::map<int, std::string> m_directories;   // Watch descriptor -> directory ("" - current)
+	std::vector<std::string> m_files;           // Files that reload
+
+	int m_inotify;
+	int m_wake[2];                              // Pipe - stop() wakes the thread
+	std::thread m_thread;
+};
@@ -0,0 +1,72 @@
+/// @file
+///
+/// @brief Implementation of Console - diagnostics and user input through callbacks.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <iostream>
+
+#include "console.h"
+#include "context.h"
+
+// static
+void Console::print(const std::string& line)
+{
+	Context::current().print(line);
+}
+
+// static
+bool Console::input(const std::string& prompt, std::string& line)
+{
+	return Context::current().input(prompt, line);
+}
+
+// static
+void Console::useStandardIo()
+{
+	Context& context = Context::current();
+	context.setOutput([](const std::string& line) {
+		std::cout << line << std::endl;
+	});
+	context.setInput([](const std::string& prompt, std::string& line) {
+		std::cout << prompt << std::flush;
+		return static_cast<bool>(std::getline(std::cin, line));
+	});
+}
+
+// static
+const std::string& Console::lastLine()
+{
+	return Context::current().lastLine();
+}
+
+// static
+void Console::clearLastLine()
+{
+	Context::current().clearLastLine();
+}
+
+Console::Quiet::Quiet()
+	: m_output(Context::current().output())
+{
+	Context::current().setOutput(nullptr);
+}
+
+Console::Quiet::~Quiet()
+{
+	Context::current().setOutput(m_output);
+}
@@ -0,0 +1,67 @@
+/// @file
+///
+/// @brief Header for Console - diagnostics and user input through callbacks.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+// How Console works:
+// The library never touches std::cout or std::cin. Messages of functions,
+// parser and interactive results are passed to the output callback, values
+// of unset variables are asked from the input callback. Callbacks belong to
+// the context of the thread (see Context) - Console only forwards to it. The
+// fnc command installs callbacks on the standard streams (useStandardIo());
+// a library user installs its own or none. The last line printed is kept,
+// so a failed evaluation can return it as its message. Bulk modes (batch,
+// stream, table, convert) run under a Console::Quiet - their stdout carries
+// only results and each failed row reports its own message.
+
+class Console
+{
+public:
+	/// @brief Writes one line (no newline)
+	static void print(const std::string& line);
+
+	/// @brief Asks for a line - false if there is no input
+	static bool input(const std::string& prompt, std::string& line);
+
+	/// @brief Callbacks on std::cout and std::cin (fnc command)
+	static void useStandardIo();
+
+	/// @brief Last line printed by this thread (empty if none since clearLastLine())
+	static const std::string& lastLine();
+
+	static void clearLastLine();
+
+	/// @brief Drops the output of the context of this thread while it lives
+	/// (worker threads copy the context, so they are quiet too)
+	class Quiet
+	{
+	public:
+		Quiet();
+		~Quiet();
+		Quiet(const Quiet&) = delete;
+		Quiet& operator=(const Quiet&) = delete;
+
+	private:
+		std::function<void(const std::string& line)> m_output;  // FncOutput
+	};
+};
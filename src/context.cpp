@@ -0,0 +1,212 @@
+/// @file
+///
+/// @brief Implementation of Context - variables, settings and console of an evaluation.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "context.h"
+
+/// @brief Operations between looks at the clock (see Context::spend())
+constexpr uint64_t BUDGET_CLOCK_OPERATIONS {64};
+
+thread_local Context Context::s_own;
+thread_local Context* Context::s_current {nullptr};
+
+Context::Context()
+	: Context(Settings::current())
+{
+}
+
+Context::Context(const std::shared_ptr<const Settings>& settings)
+	: m_showUndefinedVarMsg{true}
+	, m_quitMsgFirstTime{true}
+	, m_forceUseIni{true}
+	, m_base{VariableLayer::constants()}
+	, m_variablesVersion{0}
+	, m_frozenVersion{0}
+	, m_shared{nullptr}
+	, m_defaultAngle{"deg"}
+	, m_settings{settings}
+	, m_followIni{false}
+	, m_budget{0, FNC_DEFAULT_DEPTH, 0, true}
+	, m_limited{true}
+	, m_exceeded{FNC_LIMIT_NONE}
+	, m_operations{0}
+{
+}
+
+Context Context::session() const
+{
+	Context session(m_settings);
+	session.m_showUndefinedVarMsg = m_showUndefinedVarMsg;
+	session.m_quitMsgFirstTime = m_quitMsgFirstTime;
+	session.m_forceUseIni = m_forceUseIni;
+	session.m_base = freeze();
+	session.m_shared = m_shared;
+	session.m_defaultAngle = m_defaultAngle;
+	session.m_followIni = m_followIni;
+	session.setBudget(m_budget);
+	session.m_output = m_output;
+	session.m_input = m_input;
+	return session;
+}
+
+const ConstantVars* Context::findVariable(const std::string& name) const
+{
+	const ConstantVars* var = m_variables.find(name);
+	return var ? var : m_base->find(name);
+}
+
+void Context::setVariable(const ConstantVars& var)
+{
+	m_variables.set(var);
+	m_variablesVersion++;
+}
+
+std::vector<ConstantVars> Context::variables() const
+{
+	std::vector<ConstantVars> variables;
+	variables.reserve(m_base->variables().size() + m_variables.variables().size());
+	for (auto& it : m_base->variables())
+	{
+		if (!m_variables.find(it.varName))
+		{
+			variables.push_back(it);
+		}
+	}
+	variables.insert(variables.end(), m_variables.variables().begin(), m_variables.variables().end());
+	return variables;
+}
+
+std::shared_ptr<const VariableLayer> Context::freeze() const
+{
+	if (m_variables.empty())
+		return m_base;
+
+	if (!m_frozen || (m_frozenVersion != m_variablesVersion))
+	{
+		m_frozen = std::make_shared<const VariableLayer>(variables());
+		m_frozenVersion = m_variablesVersion;
+	}
+	return m_frozen;
+}
+
+void Context::followIni()
+{
+	m_followIni = true;
+	useSettings(Settings::current());
+	if (m_settings->fromIni())
+	{
+		m_quitMsgFirstTime = m_settings->ini().quitMsgFirstTime;
+	}
+}
+
+void Context::useSettings(const std::shared_ptr<const Settings>& settings)
+{
+	m_settings = settings;
+	if (m_followIni && settings->fromIni())
+	{
+		m_defaultAngle = settings->ini().defaultAngle;
+		m_showUndefinedVarMsg = settings->ini().showUndefinedVarMsg;
+	}
+}
+
+void Context::setBudget(const FncBudget& budget)
+{
+	m_budget = budget;
+	m_limited = (budget.maxOperations != 0) || (budget.maxDepth != 0) || (budget.maxTimeUs != 0);
+}
+
+void Context::startBudget()
+{
+	m_exceeded = FNC_LIMIT_NONE;
+	m_operations = 0;
+	if (m_budget.maxTimeUs != 0)
+	{
+		m_deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(m_budget.maxTimeUs);
+	}
+}
+
+bool Context::spendLimited(const size_t depth)
+{
+	if (m_exceeded != FNC_LIMIT_NONE)
+		return false;
+
+	m_operations++;
+	if ((m_budget.maxOperations != 0) && (m_operations > m_budget.maxOperations))
+		return exceed(FNC_LIMIT_OPERATIONS);
+
+	if ((m_budget.maxDepth != 0) && (depth > m_budget.maxDepth))
+		return exceed(FNC_LIMIT_DEPTH);
+
+	// Reading the clock costs more than a function - look every few
+	if ((m_budget.maxTimeUs != 0) && ((m_operations % BUDGET_CLOCK_OPERATIONS) == 1)
+		&& (std::chrono::steady_clock::now() > m_deadline))
+	{
+		return exceed(FNC_LIMIT_TIME);
+	}
+	return true;
+}
+
+bool Context::exceed(const FncLimit limit)
+{
+	if (m_exceeded == FNC_LIMIT_NONE)
+	{
+		m_exceeded = limit;
+	}
+	return false;
+}
+
+std::string Context::exceededMessage() const
+{
+	switch (m_exceeded)
+	{
+	case FNC_LIMIT_OPERATIONS:
+		return "Budget exceeded - more than " + std::to_string(m_budget.maxOperations) + " operations";
+	case FNC_LIMIT_DEPTH:
+		return "Budget exceeded - deeper than " + std::to_string(m_budget.maxDepth);
+	case FNC_LIMIT_TIME:
+		return "Budget exceeded - longer than " + std::to_string(m_budget.maxTimeUs) + " us";
+	case FNC_LIMIT_INPUT:
+		return "Budget exceeded - a variable needs a value and input is not allowed";
+	default:
+		return std::string();
+	}
+}
+
+void Context::print(const std::string& line)
+{
+	m_lastLine = line;
+	if (m_output)
+	{
+		m_output(line);
+	}
+}
+
+bool Context::input(const std::string& prompt, std::string& line)
+{
+	line.clear();
+	return m_input && m_input(prompt, line);
+}
+
+// static
+Context* Context::bind(Context* context)
+{
+	Context* previous = s_current;
+	s_current = context;
+	return previous;
+}
@@ -0,0 +1,205 @@
+/// @file
+///
+/// @brief Header for Context - variables, settings and console of an evaluation.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fncLib.h"
+#include "num.h"
+#include "numUnit.h"
+#include "settings.h"
+#include "variableLayer.h"
+#include "variableStore.h"
+
+// How Context works:
+// Everything an evaluation changes or depends on - variables, angle unit,
+// message settings and the console callbacks - belongs to a Context. Parser,
+// numbers and function kernels use the context of their thread (current()),
+// so the kernel signature stays the same. A thread starts with its own
+// context (constants only, no callbacks); bind() switches the thread to
+// another one, ex. one context per library user. Contexts share nothing but
+// the (read-only) unit list and a lock-free VariableStore, so threads on
+// different contexts need no locks.
+// A context must be used by one thread at a time - worker threads get a copy
+// (see WorkPool users). Variables shared by many contexts live in a
+// VariableStore: they are looked up after the context's own variables, so
+// an assignment shadows a shared value instead of changing it.
+// Every evaluation (Exec::execute(), Program::run()) starts the budget of its
+// context; functions spend() from it. Without limits spend() is one test.
+// Over budget, the limit is kept and every later spend() fails, so an
+// evaluation stops at the next function whichever way it unwinds.
+// Own variables are a VariableLayer on top of an immutable base layer shared
+// with other contexts (constants by default). session() starts a context on
+// a frozen copy of this one's variables: it keeps a pointer to the base and
+// writes only what it assigns, so dropping it frees just that. The first
+// session() after a variable is set copies own and base variables into a new
+// base - O(n) once - and later ones reuse it in O(1), so sessions are O(1)
+// amortized over a context that is seldom written.
+// Units and (if followIni() was set) INI settings come from the Settings
+// snapshot the context took when its evaluation started - a compile or an
+// Exec::execute() takes a newer one if it was published, a program run
+// keeps what the context has. A reload never changes them mid-evaluation.
+
+class Context
+{
+public:
+	Context();
+
+	/// @brief Context on 'settings' instead of the published ones
+	explicit Context(const std::shared_ptr<const Settings>& settings);
+
+	/// @brief New context on the variables of this one (frozen - later changes
+	/// are not seen) with the same settings and callbacks. O(1) unless a
+	/// variable was set since the last one - then O(n) to freeze them.
+	Context session() const;
+
+	/// @brief Constant or variable named 'name' - nullptr if none (shared
+	/// variables are not included)
+	const ConstantVars* findVariable(const std::string& name) const;
+
+	/// @brief Adds variable or replaces the one of the same name
+	void setVariable(const ConstantVars& var);
+
+	/// @brief Constants and variables - base layer first
+	std::vector<ConstantVars> variables() const;
+
+	/// @brief Constants and variables as one immutable layer
+	std::shared_ptr<const VariableLayer> freeze() const;
+
+	/// @brief Counts changes of variables (ex. to know cached programs are stale)
+	uint64_t variablesVersion() const { return m_variablesVersion; }
+
+	/// @brief Variables shared with other contexts (nullptr if none - not owned)
+	const VariableStore* shared() const { return m_shared; }
+
+	void setShared(const VariableStore* shared) { m_shared = shared; }
+
+	/// @brief Unit of angles without units - "deg" or "rad"
+	const std::string& defaultAngle() const { return m_defaultAngle; }
+
+	void setDefaultAngle(const std::string& unit) { m_defaultAngle = unit; }
+
+	/// @brief Settings, units and conversions of the running evaluation
+	const Settings& settings() const { return *m_settings; }
+
+	/// @brief Units known to the parser
+	const std::vector<UnitDefs>& units() const { return m_settings->units(); }
+
+	/// @brief Takes angle unit and messages of the INI file from the published
+	/// settings, now and whenever newer ones are taken
+	void followIni();
+
+	/// @brief Starts an evaluation - takes newer settings if published, starts budget
+	void startEvaluation()
+	{
+		if (m_settings->version() != Settings::currentVersion())
+		{
+			useSettings(Settings::current());
+		}
+		startBudget();
+	}
+
+	/// @brief Limits of each evaluation
+	const FncBudget& budget() const { return m_budget; }
+
+	void setBudget(const FncBudget& budget);
+
+	/// @brief Starts an evaluation - operations and clock of the budget start again
+	void startBudget();
+
+	/// @brief Counts a function run at stack depth 'depth' - false if over budget
+	bool spend(const size_t depth) { return !m_limited || spendLimited(depth); }
+
+	/// @brief Stops evaluation for 'limit' (the first one is kept) - returns false
+	bool exceed(const FncLimit limit);
+
+	/// @brief Limit the evaluation ran into - FNC_LIMIT_NONE if none
+	FncLimit exceeded() const { return m_exceeded; }
+
+	/// @brief Message for exceeded() ("Budget exceeded - ...")
+	std::string exceededMessage() const;
+
+	/// @brief Explains the prompt the first time a variable is asked for
+	bool m_showUndefinedVarMsg;
+
+	/// @brief Explains how to quit the first time an empty line is entered
+	bool m_quitMsgFirstTime;
+
+	/// @brief Writes default INI file if none is found
+	bool m_forceUseIni;
+
+	/// @brief Writes one line (no newline) to the output callback
+	void print(const std::string& line);
+
+	/// @brief Asks input callback for a line - false if there is no input
+	bool input(const std::string& prompt, std::string& line);
+
+	void setOutput(FncOutput output) { m_output = output; }
+
+	const FncOutput& output() const { return m_output; }
+
+	void setInput(FncInput input) { m_input = input; }
+
+	/// @brief Last line printed (empty if none since clearLastLine())
+	const std::string& lastLine() const { return m_lastLine; }
+
+	void clearLastLine() { m_lastLine.clear(); }
+
+	/// @brief Context of this thread
+	static Context& current() { return s_current ? *s_current : s_own; }
+
+	/// @brief Uses 'context' on this thread (nullptr - own context of the thread)
+	/// @return context used before
+	static Context* bind(Context* context);
+
+private:
+	/// @brief spend() with limits set
+	bool spendLimited(const size_t depth);
+
+	/// @brief Switches to 'settings' (INI settings too, if followed)
+	void useSettings(const std::shared_ptr<const Settings>& settings);
+
+	std::shared_ptr<const VariableLayer> m_base;
+	VariableLayer m_variables;
+	uint64_t m_variablesVersion;
+	mutable std::shared_ptr<const VariableLayer> m_frozen;
+	mutable uint64_t m_frozenVersion;
+	const VariableStore* m_shared;
+	std::string m_defaultAngle;
+	std::shared_ptr<const Settings> m_settings;
+	bool m_followIni;
+
+	FncBudget m_budget;
+	bool m_limited;  // Budget has a limit on operations, depth or time
+	FncLimit m_exceeded;
+	uint64_t m_operations;
+	std::chrono::steady_clock::time_point m_deadline;
+
+	FncOutput m_output;
+	FncInput m_input;
+	std::string m_lastLine;
+
+	static thread_local Context s_own;
+	static thread_local Context* s_current;
+};
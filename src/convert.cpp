@@ -0,0 +1,262 @@
+/// @file
+///
+/// @brief Implementation of Convert - unit conversion of many values.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <cstdio>
+
+#include "convert.h"
+#include "console.h"
+#include "numScan.h"
+
+// Values converted at once
+constexpr size_t CONVERT_BLOCK {4096};
+
+// Errors shown on stderr
+constexpr size_t MAX_CONVERT_MESSAGES {10};
+
+Convert::Convert(const ConvertOptions& options)
+	: m_options(options)
+	, m_text(&std::cout)
+	, m_values(0)
+	, m_errors(0)
+{
+	m_block.reserve(CONVERT_BLOCK);
+}
+
+bool Convert::run(std::string& message)
+{
+	Console::Quiet quiet;
+
+	// Unknown units fail before anything is read
+	if (!m_conversion.resolve(m_options.from, m_options.to, message))
+		return false;
+
+	std::ofstream textFile;
+	if (m_options.outFormat != RAW_NONE)
+	{
+		if (!m_raw.open(m_options.outputFile, m_options.outFormat, message))
+			return false;
+	}
+	else if (!m_options.outputFile.empty())
+	{
+		textFile.open(m_options.outputFile);
+		if (!textFile)
+		{
+			message = "Cannot write '" + m_options.outputFile + "'";
+			return false;
+		}
+		m_text = &textFile;
+	}
+
+	bool ok;
+	if (m_options.inFormat != RAW_NONE)
+	{
+		MappedFile file;
+		if (!file.open(m_options.inputFile, message))
+			return false;
+		size_t size = rawSize(m_options.inFormat);
+		if ((file.size() % size) != 0)
+		{
+			message = "'" + m_options.inputFile + "' size is not a multiple of " + std::to_string(size) + " bytes";
+			return false;
+		}
+		ok = (m_options.inFormat == RAW_FLOAT32) ? runRawFloat(file.data(), file.size() / size)
+			: runRaw(file.data(), file.size() / size);
+	}
+	else if (!m_options.inputFile.empty())
+	{
+		std::ifstream file(m_options.inputFile);
+		if (!file)
+		{
+			message = "Cannot open '" + m_options.inputFile + "'";
+			return false;
+		}
+		ok = runText(file);
+	}
+	else
+	{
+		ok = runText(std::cin);
+	}
+
+	if (!m_raw.close())
+	{
+		ok = false;
+	}
+	m_text->flush();
+	ok = ok && m_text->good();
+	m_text = &std::cout;
+
+	if (!ok)
+	{
+		message = "Error writing results";
+	}
+	if (m_errors > 0)
+	{
+		std::cerr << "! " << m_errors << " of " << m_values << " values failed" << std::endl;
+	}
+	return ok;
+}
+
+bool Convert::runText(std::istream& input)
+{
+	std::string line;
+	size_t lineNo = 0;
+	while (std::getline(input, line))
+	{
+		lineNo++;
+		size_t pos = 0;
+		while ((pos = line.find_first_not_of(" \t\r,", pos)) != std::string::npos)
+		{
+			size_t end = line.find_first_of(" \t\r,", pos);
+			if (end == std::string::npos)
+				end = line.size();
+
+			ScannedNumber numb;
+			if (scanNumber(line.data() + pos, line.data() + end, SCAN_EXPONENT | SCAN_HEX, numb)
+				&& (numb.length == (end - pos)))
+			{
+				m_block.push_back(numb.dblValue);
+			}
+			else
+			{
+				if (m_errors < MAX_CONVERT_MESSAGES)
+				{
+					std::cerr << "! Line " << lineNo << ": '" << line.substr(pos, end - pos)
+						<< "' is not a number" << std::endl;
+				}
+				m_errors++;
+				m_block.push_back(NAN);
+			}
+
+			if ((m_block.size() >= CONVERT_BLOCK) && !flushBlock())
+				return false;
+			pos = end;
+		}
+	}
+	return flushBlock();
+}
+
+bool Convert::runRaw(const char* data, const size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t raw = readRaw64(data + (i * sizeof(uint64_t)));
+		if (m_options.inFormat == RAW_INT64)
+		{
+			int64_t value;
+			memcpy(&value, &raw, sizeof(value));
+			m_block.push_back(static_cast<double>(value));
+		}
+		else
+		{
+			double value;
+			memcpy(&value, &raw, sizeof(value));
+			m_block.push_back(value);
+		}
+
+		if ((m_block.size() >= CONVERT_BLOCK) && !flushBlock())
+			return false;
+	}
+	return flushBlock();
+}
+
+bool Convert::runRawFloat(const char* data, const size_t count)
+{
+	m_floatBlock.reserve(CONVERT_BLOCK);
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t raw = readRaw32(data + (i * sizeof(float)));
+		float value;
+		memcpy(&value, &raw, sizeof(value));
+		m_floatBlock.push_back(value);
+
+		if ((m_floatBlock.size() >= CONVERT_BLOCK) && !flushFloatBlock())
+			return false;
+	}
+	return flushFloatBlock();
+}
+
+bool Convert::flushBlock()
+{
+	m_conversion.apply(m_block.data(), m_block.data(), m_block.size());
+	m_values += m_block.size();
+
+	bool ok = true;
+	if (m_options.outFormat != RAW_NONE)
+	{
+		for (size_t i = 0; ok && (i < m_block.size()); i++)
+		{
+			ok = m_raw.putDouble(m_block[i]);
+		}
+	}
+	else
+	{
+		// Same default format as Num::asString() - fits the largest double
+		char text[400];
+		m_buffer.clear();
+		for (auto it : m_block)
+		{
+			if (std::isnan(it))
+			{
+				m_buffer += "nan\n";
+				continue;
+			}
+			int len = snprintf(text, sizeof(text), "%.9f\n", it);
+			m_buffer.append(text, len);
+		}
+		m_text->write(m_buffer.data(), m_buffer.size());
+		ok = m_text->good();
+	}
+
+	m_block.clear();
+	return ok;
+}
+
+bool Convert::flushFloatBlock()
+{
+	m_conversion.apply(m_floatBlock.data(), m_floatBlock.data(), m_floatBlock.size());
+	m_values += m_floatBlock.size();
+
+	bool ok = true;
+	m_buffer.clear();
+	if (m_options.outFormat != RAW_NONE)
+	{
+		for (auto it : m_floatBlock)
+		{
+			appendRawFloat(m_buffer, m_options.outFormat, it);
+		}
+		ok = m_raw.write(m_buffer);
+	}
+	else
+	{
+		// Enough digits to read back the same float
+		char text[64];
+		for (auto it : m_floatBlock)
+		{
+			int len = snprintf(text, sizeof(text), "%.9g\n", it);
+			m_buffer.append(text, len);
+		}
+		m_text->write(m_buffer.data(), m_buffer.size());
+		ok = m_text->good();
+	}
+
+	m_floatBlock.clear();
+	return ok;
+}
@@ -0,0 +1,91 @@
+/// @file
+///
+/// @brief Header file for Convert - unit conversion of many values.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+
+#include "numUnit.h"
+#include "binaryIO.h"
+
+/// @brief Convert settings (usually from command line)
+typedef struct _convertOptions
+{
+	std::string from;        // Unit of input values
+	std::string to;          // Unit of results
+	std::string inputFile;   // stdin if empty (text)
+	RawFormat   inFormat;    // RAW_NONE is text input (RAW_FLOAT32 converts in float32)
+	RawFormat   outFormat;   // RAW_NONE is text output
+	std::string outputFile;  // stdout if empty
+} ConvertOptions;
+
+// How Convert works:
+// The conversion is resolved once (UnitConversion) before any input is read,
+// so an unknown pair of units fails up front. Values are then read in blocks,
+// converted with one multiply-add per value and written out. Text input may
+// have any number of values per line (spaces or commas) - results are one per
+// line, "nan" for values that are not numbers. Float32 input is converted in
+// float32 (twice the values per instruction).
+
+class Convert
+{
+public:
+	Convert(const ConvertOptions& options);
+
+	/// @brief Resolves conversion, reads all input and writes results
+	bool run(std::string& message);
+
+	/// @brief Values converted
+	size_t values() const { return m_values; }
+
+	/// @brief Values that were not numbers (written as NaN)
+	size_t errors() const { return m_errors; }
+
+private:
+	bool runText(std::istream& input);
+
+	bool runRaw(const char* data, const size_t count);
+
+	/// @brief Float32 input - converted in float32
+	bool runRawFloat(const char* data, const size_t count);
+
+	/// @brief Converts and writes out the block
+	bool flushBlock();
+	bool flushFloatBlock();
+
+	ConvertOptions m_options;
+
+	UnitConversion m_conversion;
+
+	// Values of current block (converted in place)
+	std::vector<double> m_block;
+	std::vector<float> m_floatBlock;
+
+	// Output - one of them is used
+	RawWriter m_raw;
+	std::ostream* m_text;
+	std::string m_buffer;
+
+	size_t m_values;
+	size_t m_errors;
+};
@@ -0,0 +1,119 @@
+/// @file
+///
+/// @brief Implementation of epoch-based reclamation - frees shared objects once no reader can see them.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <atomic>
+#include <limits>
+
+#include "epoch.h"
+
+/// @brief Epoch announced by a reading thread
+typedef struct _readerSlot
+{
+	std::atomic<uint64_t> epoch;  // 0 - not reading
+	std::atomic<bool> used;       // Owned by a thread
+	struct _readerSlot* next;
+} ReaderSlot;
+
+/// @brief Epoch of all readers - starts at 1 (0 means "not reading")
+static std::atomic<uint64_t> s_epoch {1};
+
+/// @brief Slots of all threads that ever read (never freed - reused)
+static std::atomic<ReaderSlot*> s_slots {nullptr};
+
+/// @brief Takes a free slot or adds a new one
+static ReaderSlot* acquireSlot()
+{
+	for (ReaderSlot* slot = s_slots.load(std::memory_order_acquire); slot; slot = slot->next)
+	{
+		bool expected = false;
+		if (!slot->used.load(std::memory_order_relaxed)
+			&& slot->used.compare_exchange_strong(expected, true, std::memory_order_acquire))
+		{
+			return slot;
+		}
+	}
+
+	ReaderSlot* slot = new ReaderSlot;
+	slot->epoch.store(0, std::memory_order_relaxed);
+	slot->used.store(true, std::memory_order_relaxed);
+	slot->next = s_slots.load(std::memory_order_relaxed);
+	while (!s_slots.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+	return slot;
+}
+
+/// @brief Slot of a thread - given back when the thread ends
+class ThreadSlot
+{
+public:
+	ThreadSlot() : m_slot(acquireSlot()) {}
+
+	~ThreadSlot()
+	{
+		m_slot->epoch.store(0, std::memory_order_release);
+		m_slot->used.store(false, std::memory_order_release);
+	}
+
+	ReaderSlot* slot() const { return m_slot; }
+
+private:
+	ReaderSlot* m_slot;
+};
+
+static thread_local ThreadSlot s_threadSlot;
+
+EpochGuard::EpochGuard()
+	: m_slot(s_threadSlot.slot())
+	, m_outer(m_slot->epoch.load(std::memory_order_relaxed) == 0)
+{
+	if (m_outer)
+	{
+		// Announce epoch before loading shared pointers - a writer that misses it exchanged first
+		m_slot->epoch.store(s_epoch.load());
+	}
+}
+
+EpochGuard::~EpochGuard()
+{
+	if (m_outer)
+	{
+		m_slot->epoch.store(0, std::memory_order_release);
+	}
+}
+
+uint64_t epochAdvance()
+{
+	return s_epoch.fetch_add(1) + 1;
+}
+
+uint64_t epochOldest()
+{
+	uint64_t oldest = std::numeric_limits<uint64_t>::max();
+	for (ReaderSlot* slot = s_slots.load(std::memory_order_acquire); slot; slot = slot->next)
+	{
+		uint64_t epoch = slot->epoch.load();
+		if ((epoch != 0) && (epoch < oldest))
+		{
+			oldest = epoch;
+		}
+	}
+	return oldest;
+}
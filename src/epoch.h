@@ -0,0 +1,116 @@
+/// @file
+///
+/// @brief Header for epoch-based reclamation - frees shared objects once no reader can see them.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// How epochs work:
+// Lock-free readers (VariableStore, ExpressionCache) hold an EpochGuard while
+// they use shared objects: it announces the global epoch in the thread's slot
+// and clears it when done. A writer that unlinks an object retires it with
+// the epoch that follows (epochAdvance()); it is freed once no slot holds an
+// older epoch (epochOldest()) - no reader can still see it. Every thread gets
+// one slot (reused after the thread ends), so reading costs the same for any
+// number of threads; writers scan all slots. Guards may nest - the outer
+// one's epoch is kept.
+
+/// @brief Reader slot of a thread (see epoch.cpp)
+struct _readerSlot;
+
+class EpochGuard
+{
+public:
+	EpochGuard();
+
+	~EpochGuard();
+
+private:
+	EpochGuard(const EpochGuard&) = delete;
+	EpochGuard& operator=(const EpochGuard&) = delete;
+
+	_readerSlot* m_slot;
+	bool m_outer;
+};
+
+/// @brief Starts next epoch - returns it. Objects unlinked before the call
+/// are safe to free when epochOldest() is not older.
+uint64_t epochAdvance();
+
+/// @brief Oldest epoch announced by a reader (UINT64_MAX if none is reading)
+uint64_t epochOldest();
+
+/// @brief Unlinked objects waiting for their readers - used by one writer at a time
+template<typename T>
+class EpochRetired
+{
+public:
+	EpochRetired() {}
+
+	/// @brief Frees all - no reader may be left
+	~EpochRetired()
+	{
+		for (auto& it : m_retired)
+		{
+			delete it.second;
+		}
+	}
+
+	/// @brief Retires object unlinked by the caller, then frees what no reader can see
+	void retire(const T* object)
+	{
+		m_retired.emplace_back(epochAdvance(), object);
+		reclaim();
+	}
+
+	/// @brief Same for many objects (one epoch)
+	void retire(const std::vector<const T*>& objects)
+	{
+		uint64_t epoch = epochAdvance();
+		for (auto it : objects)
+		{
+			m_retired.emplace_back(epoch, it);
+		}
+		reclaim();
+	}
+
+	/// @brief Frees objects no reader can see
+	void reclaim()
+	{
+		uint64_t oldest = epochOldest();
+		auto end = std::remove_if(m_retired.begin(), m_retired.end(),
+			[oldest](const std::pair<uint64_t, const T*>& it) {
+				if (it.first > oldest)
+					return false;
+				delete it.second;
+				return true;
+			});
+		m_retired.erase(end, m_retired.end());
+	}
+
+private:
+	EpochRetired(const EpochRetired&) = delete;
+	EpochRetired& operator=(const EpochRetired&) = delete;
+
+	std::vector<std::pair<uint64_t, const T*> > m_retired;
+};
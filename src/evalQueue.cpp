@@ -0,0 +1,232 @@
+/// @file
+///
+/// @brief Implementation of EvalQueue - single evaluations of many threads run in batches.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "evalQueue.h"
+#include "console.h"
+
+/// @brief Block programs kept by the worker - forgotten all at once when full
+constexpr size_t QUEUE_BLOCK_PROGRAMS {1024};
+
+EvalQueue::EvalQueue(const std::chrono::microseconds maxWait, const size_t maxBatch)
+	: m_context(Context::current())
+	, m_maxWait(maxWait)
+	, m_maxBatch(std::max<size_t>(maxBatch, 1))
+	, m_maxPending(m_maxBatch * QUEUE_PENDING_BATCHES)
+	, m_stop(false)
+{
+	m_context.setOutput(FncOutput());
+	m_context.setInput(FncInput());
+	m_thread = std::thread(&EvalQueue::work, this);
+}
+
+EvalQueue::~EvalQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_one();
+	m_thread.join();
+}
+
+std::future<double> EvalQueue::submit(const Program& program, const uint64_t serial, const double* values)
+{
+	std::promise<double> promise;
+	std::future<double> result = promise.get_future();
+	auto now = std::chrono::steady_clock::now();
+
+	size_t waiting;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_room.wait(lock, [this] { return m_pending.size() < m_maxPending; });
+		m_pending.push_back(EvalRequest{&program, serial, m_values.size(), std::move(promise), now});
+		m_values.insert(m_values.end(), values, values + program.slots());
+		waiting = m_pending.size();
+	}
+
+	// Worker waits for the first request, then for a full batch
+	if ((waiting == 1) || (waiting == m_maxBatch))
+	{
+		m_wake.notify_one();
+	}
+	return result;
+}
+
+void EvalQueue::work()
+{
+	Context::current() = m_context;
+
+	std::vector<EvalRequest> batch;
+	std::vector<double> values;
+	std::vector<EvalRequest*> order;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_wake.wait(lock, [this] { return m_stop || !m_pending.empty(); });
+		if (m_pending.empty())
+			break;
+
+		if (batch.size() > 1)
+		{
+			// Let others join the batch - the oldest waits no longer than m_maxWait
+			auto deadline = m_pending.front().queued + m_maxWait;
+			m_wake.wait_until(lock, deadline, [this] { return m_stop || (m_pending.size() >= m_maxBatch); });
+		}
+
+		batch.clear();
+		batch.swap(m_pending);
+		values.clear();
+		values.swap(m_values);
+		lock.unlock();
+		m_room.notify_all();
+
+		order.clear();
+		for (auto& it : batch)
+		{
+			order.push_back(&it);
+		}
+		std::stable_sort(order.begin(), order.end(), [](const EvalRequest* a, const EvalRequest* b) {
+			return (a->program != b->program) ? (a->program < b->program) : (a->serial < b->serial);
+		});
+
+		for (size_t first = 0; first < order.size(); )
+		{
+			size_t last = first + 1;
+			while ((last < order.size()) && (order[last]->program == order[first]->program)
+				&& (order[last]->serial == order[first]->serial))
+			{
+				last++;
+			}
+			runGroup(&order[first], last - first, values.data());
+			first = last;
+		}
+
+		lock.lock();
+	}
+}
+
+void EvalQueue::runGroup(EvalRequest** requests, const size_t count, const double* values)
+{
+	const Program& program = *requests[0]->program;
+	const BlockProgram* block = blockFor(program, requests[0]->serial);
+	if (!block)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			runRow(*requests[i], values);
+		}
+		return;
+	}
+
+	if (block->constantResult())
+	{
+		double value = block->constant().asDouble();
+		for (size_t i = 0; i < count; i++)
+		{
+			requests[i]->result.set_value(value);
+		}
+		return;
+	}
+
+	const size_t slots = program.slots();
+	m_columns.resize(slots * BLOCK_VALUES);
+	m_scratch.resize(block->columns() * BLOCK_VALUES);
+	m_results.resize(BLOCK_VALUES);
+	std::vector<const double*> inputs(slots);
+	for (size_t k = 0; k < slots; k++)
+	{
+		inputs[k] = &m_columns[k * BLOCK_VALUES];
+	}
+
+	for (size_t first = 0; first < count; first += BLOCK_VALUES)
+	{
+		size_t rows = std::min(BLOCK_VALUES, count - first);
+		for (size_t row = 0; row < rows; row++)
+		{
+			const double* rowValues = values + requests[first + row]->values;
+			for (size_t k = 0; k < slots; k++)
+			{
+				m_columns[k * BLOCK_VALUES + row] = rowValues[k];
+			}
+		}
+
+		block->run(inputs.data(), rows, m_scratch.data(), m_results.data());
+
+		for (size_t row = 0; row < rows; row++)
+		{
+			if (std::isfinite(m_results[row]))
+			{
+				requests[first + row]->result.set_value(m_results[row]);
+			}
+			else
+			{
+				// Errors (and their messages) come from Program
+				runRow(*requests[first + row], values);
+			}
+		}
+	}
+}
+
+// static
+void EvalQueue::runRow(EvalRequest& request, const double* values)
+{
+	std::vector<Num> inputs(request.program->slots(), Num(0., NUM_DOUBLE));
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		inputs[i].m_dValue = values[request.values + i];
+	}
+
+	Num result;
+	std::string message;
+	Console::clearLastLine();
+	if (!request.program->run(inputs.data(), result, message))
+	{
+		if (!Console::lastLine().empty())
+		{
+			message += " - " + Console::lastLine();
+		}
+		request.result.set_exception(std::make_exception_ptr(std::runtime_error(message)));
+		return;
+	}
+	request.result.set_value(result.asDouble());
+}
+
+const BlockProgram* EvalQueue::blockFor(const Program& program, const uint64_t serial)
+{
+	auto found = m_blocks.find(&program);
+	if ((found == m_blocks.end()) || (found->second.serial != serial))
+	{
+		if (m_blocks.size() >= QUEUE_BLOCK_PROGRAMS)
+		{
+			m_blocks.clear();
+		}
+		BlockEntry& entry = m_blocks[&program];
+		std::string message;
+		entry.serial = serial;
+		entry.block = BlockProgram();
+		entry.built = entry.block.build(program, message);
+		return entry.built ? &entry.block : nullptr;
+	}
+	return found->second.built ? &found->second.block : nullptr;
+}
@@ -0,0 +1,120 @@
+/// @file
+///
+/// @brief Header for EvalQueue - single evaluations of many threads run in batches.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "blockProgram.h"
+#include "context.h"
+#include "program.h"
+
+/// @brief Requests waiting at most, in batches of 'maxBatch' (see submit())
+constexpr size_t QUEUE_PENDING_BATCHES {4};
+
+/// @brief Queued evaluation
+typedef struct _evalRequest
+{
+	const Program* program;
+	uint64_t serial;             // Compile of the program (addresses are reused)
+	size_t values;               // First of its values (one per slot) in the batch
+	std::promise<double> result;
+	std::chrono::steady_clock::time_point queued;
+} EvalRequest;
+
+// How EvalQueue works:
+// Producers submit one row at a time; a worker thread takes everything that
+// is waiting, groups it by program and runs each group as columns through a
+// BlockProgram (one tight loop per step over up to BLOCK_VALUES rows) instead
+// of one Program::run() per row. A batch starts once its oldest request has
+// waited 'maxWait' or 'maxBatch' requests are waiting; while a batch runs,
+// the next one fills, so batches grow with the load and latency stays near
+// maxWait plus one batch. A request that comes alone (the batch before it
+// had one request too) runs at once - waiting only pays when others come.
+// At most QUEUE_PENDING_BATCHES * maxBatch requests wait: submit() then
+// waits for room (as AsyncPool::push() does), so producers faster than the
+// worker are slowed down instead of growing the queue without bound.
+// Rows a BlockProgram cannot give exactly (programs it cannot build, results
+// that are not finite - ex. errors) run through Program::run(), so results
+// and messages are the same as evaluating alone. The worker uses a copy of
+// the context that created the queue (no console).
+
+class EvalQueue
+{
+public:
+	EvalQueue(const std::chrono::microseconds maxWait, const size_t maxBatch);
+
+	/// @brief Runs what is queued, then stops
+	~EvalQueue();
+
+	/// @brief Queues a row (waits while the queue is full) - 'program' must live
+	/// until the result is set. A failed evaluation sets std::runtime_error
+	/// (message) as the result.
+	std::future<double> submit(const Program& program, const uint64_t serial, const double* values);
+
+private:
+	EvalQueue(const EvalQueue&) = delete;
+	EvalQueue& operator=(const EvalQueue&) = delete;
+
+	/// @brief Worker thread - takes and runs batches until stopped
+	void work();
+
+	/// @brief Runs requests of one program ('values' of the batch)
+	void runGroup(EvalRequest** requests, const size_t count, const double* values);
+
+	/// @brief Runs request through Program::run()
+	static void runRow(EvalRequest& request, const double* values);
+
+	/// @brief Block program for program - nullptr if it cannot be built
+	const BlockProgram* blockFor(const Program& program, const uint64_t serial);
+
+	Context m_context;
+	std::chrono::microseconds m_maxWait;
+	size_t m_maxBatch;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_room;  // Producers waiting for room in m_pending
+	size_t m_maxPending;
+	std::vector<EvalRequest> m_pending;
+	std::vector<double> m_values;  // Values of m_pending
+	bool m_stop;
+
+	// Worker only
+	typedef struct _blockEntry
+	{
+		uint64_t serial;
+		bool built;
+		BlockProgram block;
+	} BlockEntry;
+	std::unordered_map<const Program*, BlockEntry> m_blocks;
+	std::vector<double> m_columns;
+	std::vector<double> m_scratch;
+	std::vector<double> m_results;
+
+	std::thread m_thread;
+};
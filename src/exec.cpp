@@ -18,7 +18,6 @@
 ///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 
-#include <iostream>
 
 #include <sys/stat.h>  // Used to check if file exists
 #include <exception>
@@ -30,10 +29,11 @@
 #include "num.h"
 
 #include "iniParser.h"
+#include "console.h"
+#include "context.h"
+#include "plugins.h"
 
 // static
-bool Exec::s_showUndefinedVarMsg = true;
-bool Exec::s_quitMsgFirstTime = true;
 
 Exec::Exec()
 {
@@ -42,16 +42,25 @@ Exec::Exec()
 
 bool Exec::execute(const CalString& equ)
 {
+	Context& context = Context::current();
+	context.startEvaluation();
+
 	CalString tmp = equ;
 	bool ok = parse(tmp, m_message);
 
 	if (!ok)
 	{
-		std::cout << "! Parsing errored: " << m_message << std::endl;
+		Console::print(std::string("! Parsing errored: ") + m_message);
 	}
 
 	run();
 
+	if (context.exceeded() != FNC_LIMIT_NONE)
+	{
+		Console::print("! " + context.exceededMessage());
+		ok = false;
+	}
+
 	return ok;
 }
 
@@ -72,7 +81,7 @@ bool Exec::parse(CalString& equ, std::string& message)
 		else
 		{
 			// Function errored
-			std::cout << "Function parsing failed: >>" << equ.c_str() << std::endl;
+			Console::print(std::string("Function parsing failed: >>") + equ.c_str());
 			return false;
 		}
 	}
@@ -87,7 +96,7 @@ Num Exec::run()
 
 	if (!ok)
 	{
-		std::cout << "!!! Exec::run() - ran with errors!" << std::endl;
+		Console::print("!!! Exec::run() - ran with errors!");
 	}
 
     Num::showVariables();
@@ -99,14 +108,14 @@ Num Exec::run()
 	}
 	else if (m_stack.size() == 1)
 	{
-		std::cout << m_stack.back().asString() << std::endl;
+		Console::print(m_stack.back().asString());
 	}
 	else
 	{
 		int i = 1;
 		for(auto it: m_stack)
 		{
-			std::cout << "[" << i << "] " << it.asString() << std::endl;
+			Console::print("[" + std::to_string(i) + "] " + it.asString());
 			i++;
 		}
 	}
@@ -159,7 +168,7 @@ bool Exec::inputParseAndRun(Num& inp, CalString& eq, NumStack& stack)
 
 	if (stack.empty())
 	{
-		std::cout << "!!Exec::inputParseAndRun() - did not produce any results!" << std::endl;
+		Console::print("!!Exec::inputParseAndRun() - did not produce any results!");
 		return false;
 	}
 
@@ -169,14 +178,9 @@ bool Exec::inputParseAndRun(Num& inp, CalString& eq, NumStack& stack)
 int Exec::runInteractive()
 {
 	CalString eq;
-	int i = -1;
-	int c;
 	bool done = false;
 	while (!done)
 	{
-		// Capture buffered line
-		bool parsed = false;
-
 		if (!eq.empty())
 		{
 			// TODO: Need to save equations and variables list before clearing expressions
@@ -184,27 +188,18 @@ int Exec::runInteractive()
 			m_functions.clear();
 		}
 
-		std::cout << ">";
-		do {
-			// NOTE: each character is buffered until \n (is now like getchar())
-			// TODO: Use getch() (using conio.h) to check for escape keys
-			c = getchar();
-			if (c == '\n')
-			{
-				parsed = true;
-			}
-			else
-			{
-				eq += c;
-			}
-		} while (!parsed);
-
-		if (eq.empty())
+		// TODO: Use getch() (using conio.h) to check for escape keys
+		if (!Console::input(">", eq))
+		{
+			// End of input
+			done = true;
+		}
+		else if (eq.empty())
 		{
-			if (s_quitMsgFirstTime)
+			if (Context::current().m_quitMsgFirstTime)
 			{
-				std::cout << "Did you want to quit? - type 'q<CR>' to quit." << std::endl;
-				s_quitMsgFirstTime = false;
+				Console::print("Did you want to quit? - type 'q<CR>' to quit.");
+				Context::current().m_quitMsgFirstTime = false;
 			}
 			Num::showVariables();
 		}
@@ -231,20 +226,39 @@ int Exec::runInteractive()
 
 void Exec::getSettings(std::string& iniPath)
 {
-	// By initializing ini file, INI file will be created
-	IniParser ini(iniPath);
-	if (ini.exists())
+	Context& context = Context::current();
+	if (IniParser::exists(iniPath))
 	{
-		FunctionType::s_defaultAngle = ini.getString("Number.Angle", "deg");
-		Exec::s_showUndefinedVarMsg = 0 != ini.getBool("Exec.UndefinedMsg", 1);
-		Exec::s_quitMsgFirstTime = 0 != ini.getBool("Exec.quitMsg", 1);
+		// Units file errors keep built-in units - the rest of the INI is used
+		std::string message;
+		std::shared_ptr<Settings> settings = std::make_shared<Settings>();
+		if (!settings->load(iniPath, message))
+		{
+			Console::print("! " + message);
+		}
+		if (settings->fromIni())
+		{
+			Settings::publish(settings);
+		}
+
+		// Plugins are loaded once - reloads of the INI file do not change them
+		for (const auto& it : settings->pluginPaths())
+		{
+			if (!Plugins::load(it, message))
+			{
+				Console::print("! " + message);
+			}
+		}
 	}
-	else if (IniParser::s_forceUseIni)
+	else if (context.m_forceUseIni)
 	{
-		ini.putString("Number.Angle", FunctionType::s_defaultAngle);
-		ini.putBool("Exec.UndefinedMsg", Exec::s_showUndefinedVarMsg);
-		ini.putBool("Exec.quitMsg", Exec::s_quitMsgFirstTime);
+		// By initializing ini file, INI file will be created
+		IniParser ini(iniPath);
+		ini.putString("Number.Angle", context.defaultAngle());
+		ini.putBool("Exec.UndefinedMsg", context.m_showUndefinedVarMsg);
+		ini.putBool("Exec.quitMsg", context.m_quitMsgFirstTime);
 	}
+	context.followIni();
 }
 
 
@@ -254,9 +268,9 @@ void Exec::printHelp(const CalString& args)
 	if (args.empty())
 	{
 		// Lists help topics
-		std::cout << "Help: Type expression as in command argument." << std::endl;
-		std::cout << "- to exit, type 'q' and [Enter]." << std::endl;
-		std::cout << "Other help topics not implemented, yet" << std::endl;
+		Console::print("Help: Type expression as in command argument.");
+		Console::print("- to exit, type 'q' and [Enter].");
+		Console::print("Other help topics not implemented, yet");
 	}
 }
 
@@ -55,13 +55,15 @@ public:
 
 	const std::string& errMessage() const { return m_message; }
 
+	/// @brief Parsed functions (see Program::compile())
+	const std::vector<Func>& functions() const { return m_functions; }
+
+	/// @brief Reads INI file (and the units file it names) for all contexts -
+	/// the context of this thread follows its settings (see ConfigWatcher)
 	void getSettings(std::string& iniPath);
 
 	static void printHelp(const CalString& args);
 
-	static bool s_showUndefinedVarMsg;
-	static bool s_quitMsgFirstTime;
-
 private:
 
 	std::string m_message;
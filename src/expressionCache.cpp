@@ -0,0 +1,263 @@
+/// @file
+///
+/// @brief Implementation of ExpressionCache - compiled expressions shared by all threads, lock-free to read.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+#include "expressionCache.h"
+#include "context.h"
+
+/// @brief Entries of the shared cache
+constexpr size_t EXPRESSION_CACHE_ENTRIES {4096};
+
+/// @brief Part of the entries evicted at once when the cache is full (1/n)
+constexpr size_t EXPRESSION_CACHE_EVICT {8};
+
+ExpressionCache::ExpressionCache(const size_t capacity)
+	: m_capacity(std::max<size_t>(capacity, 1))
+	, m_mask(1)
+	, m_size{0}
+	, m_misses{0}
+	, m_tick{0}
+	, m_generation{0}
+{
+	// Twice as many chains as entries (power of 2) - chains stay short
+	while (m_mask < 2 * m_capacity)
+	{
+		m_mask <<= 1;
+	}
+	m_buckets.reset(new std::atomic<const CacheEntry*>[m_mask]);
+	for (size_t i = 0; i < m_mask; i++)
+	{
+		m_buckets[i].store(nullptr, std::memory_order_relaxed);
+	}
+	m_mask--;
+}
+
+ExpressionCache::~ExpressionCache()
+{
+	for (size_t i = 0; i <= m_mask; i++)
+	{
+		const CacheEntry* entry = m_buckets[i].load();
+		while (entry)
+		{
+			const CacheEntry* next = entry->next.load();
+			delete entry;
+			entry = next;
+		}
+	}
+}
+
+// static
+ExpressionCache& ExpressionCache::shared()
+{
+	static ExpressionCache s_shared(EXPRESSION_CACHE_ENTRIES);
+	return s_shared;
+}
+
+bool ExpressionCache::compile(const std::string& expression, Program& program, std::string& message)
+{
+	size_t hash = std::hash<std::string>()(expression);
+	// Programs are bound to the units of the settings they compile with
+	Context& context = Context::current();
+	context.startEvaluation();
+	uint64_t settings = context.settings().version();
+
+	std::vector<SlotSignature> slots;
+	if (find(expression, hash, settings, program, slots))
+	{
+		std::vector<SlotSignature> current = signatures(program);
+		bool same = (current.size() == slots.size());
+		for (size_t i = 0; same && (i < slots.size()); i++)
+		{
+			same = (current[i].found == slots[i].found) && (current[i].num_type == slots[i].num_type)
+				&& (current[i].unit_type == slots[i].unit_type) && (current[i].units == slots[i].units);
+		}
+		if (same)
+			return true;
+	}
+
+	m_misses.fetch_add(1, std::memory_order_relaxed);
+	uint64_t generation = m_generation.load();
+	uint64_t version = context.variablesVersion();
+
+	auto start = std::chrono::steady_clock::now();
+	if (!program.compile(expression, message))
+		return false;
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	// Definitions and messages must happen every time
+	if (program.empty() || (context.variablesVersion() != version) || !context.lastLine().empty())
+		return true;
+
+	CacheEntry* entry = new CacheEntry{expression, hash, settings, program, signatures(program),
+		static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+		{0}, {0}, {nullptr}};
+
+	std::lock_guard<std::mutex> lock(m_writer);
+	insert(entry, generation);
+	return true;
+}
+
+bool ExpressionCache::find(const std::string& expression, const size_t hash, const uint64_t settings,
+	Program& program, std::vector<SlotSignature>& slots) const
+{
+	EpochGuard guard;
+	for (const CacheEntry* entry = bucket(hash).load(std::memory_order_acquire); entry;
+		entry = entry->next.load(std::memory_order_acquire))
+	{
+		if ((entry->hash != hash) || (entry->expression != expression))
+			continue;
+
+		if (entry->settings != settings)
+			return false;
+
+		entry->hits.fetch_add(1, std::memory_order_relaxed);
+		uint64_t tick = m_tick.load(std::memory_order_relaxed);
+		if (entry->lastUsed.load(std::memory_order_relaxed) != tick)
+		{
+			entry->lastUsed.store(tick, std::memory_order_relaxed);
+		}
+		program = entry->program;
+		slots = entry->slots;
+		return true;
+	}
+	return false;
+}
+
+void ExpressionCache::insert(CacheEntry* entry, const uint64_t generation)
+{
+	if (m_generation.load() != generation)
+	{
+		// Compiled with tables that changed since
+		delete entry;
+		return;
+	}
+
+	for (const CacheEntry* it = bucket(entry->hash).load(); it; it = it->next.load())
+	{
+		if ((it->hash == entry->hash) && (it->expression == entry->expression))
+		{
+			// Compiled for other variables (or by another thread at the same time)
+			unlink(it);
+			m_retired.retire(it);
+			break;
+		}
+	}
+
+	if (m_size.load() >= m_capacity)
+	{
+		evict();
+	}
+
+	entry->lastUsed.store(m_tick.fetch_add(1) + 1);
+	std::atomic<const CacheEntry*>& head = bucket(entry->hash);
+	entry->next.store(head.load());
+	head.store(entry, std::memory_order_release);
+	m_size.fetch_add(1);
+}
+
+void ExpressionCache::evict()
+{
+	std::vector<const CacheEntry*> entries;
+	entries.reserve(m_size.load());
+	for (size_t i = 0; i <= m_mask; i++)
+	{
+		for (const CacheEntry* it = m_buckets[i].load(); it; it = it->next.load())
+		{
+			entries.push_back(it);
+		}
+	}
+
+	size_t count = std::max<size_t>(entries.size() / EXPRESSION_CACHE_EVICT, 1);
+	count = std::min(count, entries.size());
+	std::nth_element(entries.begin(), entries.begin() + (count - 1), entries.end(),
+		[](const CacheEntry* a, const CacheEntry* b) { return a->lastUsed.load() < b->lastUsed.load(); });
+	entries.resize(count);
+
+	for (auto it : entries)
+	{
+		unlink(it);
+	}
+	m_retired.retire(entries);
+}
+
+void ExpressionCache::unlink(const CacheEntry* entry)
+{
+	std::atomic<const CacheEntry*>* link = &bucket(entry->hash);
+	while (link->load() != entry)
+	{
+		link = &link->load()->next;
+	}
+	// Readers on the entry still see the rest of the chain
+	link->store(entry->next.load(), std::memory_order_release);
+	m_size.fetch_sub(1);
+}
+
+void ExpressionCache::invalidate()
+{
+	std::lock_guard<std::mutex> lock(m_writer);
+	m_generation.fetch_add(1);
+
+	std::vector<const CacheEntry*> entries;
+	for (size_t i = 0; i <= m_mask; i++)
+	{
+		for (const CacheEntry* it = m_buckets[i].exchange(nullptr); it; it = it->next.load())
+		{
+			entries.push_back(it);
+		}
+	}
+	m_size.store(0);
+	m_retired.retire(entries);
+}
+
+std::vector<ExpressionStats> ExpressionCache::statistics() const
+{
+	std::vector<ExpressionStats> stats;
+	EpochGuard guard;
+	for (size_t i = 0; i <= m_mask; i++)
+	{
+		for (const CacheEntry* it = m_buckets[i].load(std::memory_order_acquire); it;
+			it = it->next.load(std::memory_order_acquire))
+		{
+			stats.push_back(ExpressionStats{it->expression, it->hits.load(std::memory_order_relaxed),
+				it->compileNs, it->lastUsed.load(std::memory_order_relaxed)});
+		}
+	}
+	return stats;
+}
+
+// static
+std::vector<SlotSignature> ExpressionCache::signatures(const Program& program)
+{
+	std::vector<SlotSignature> slots;
+	slots.reserve(program.slots());
+	for (size_t i = 0; i < program.slots(); i++)
+	{
+		const std::string& name = program.slotName(i);
+		ConstantVars var{"", 0., NUM_DEFAULT, UNIT_NUMBER, ""};
+		int len = -1;
+		bool found = Num::isVariable(name, len, var) && (len == static_cast<int>(name.size()));
+		slots.push_back(found ? SlotSignature{name, true, var.num_type, var.unit_type, var.units}
+			: SlotSignature{name, false, NUM_DEFAULT, UNIT_NUMBER, ""});
+	}
+	return slots;
+}
@@ -0,0 +1,143 @@
+/// @file
+///
+/// @brief Header for ExpressionCache - compiled expressions shared by all threads, lock-free to read.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "epoch.h"
+#include "program.h"
+
+/// @brief Variable of a slot as it was when the expression was compiled
+typedef struct _slotSignature
+{
+	std::string name;
+	bool        found;      // Had a value (units and format come from it)
+	NumberType  num_type;
+	UnitType    unit_type;
+	std::string units;
+} SlotSignature;
+
+/// @brief Statistics of a cached expression
+typedef struct _expressionStats
+{
+	std::string expression;
+	uint64_t    hits;       // Compiles answered by the entry
+	uint64_t    compileNs;  // Time it took to compile (once)
+	uint64_t    lastUsed;   // Insert count when last used (larger is newer)
+} ExpressionStats;
+
+// How ExpressionCache works:
+// Compiling an expression (Exec::parse, Func::compile) costs far more than
+// running it. The cache keeps compiled programs (not resolved) by expression
+// text in a fixed hash table of lock-free chains, shared by all threads: a
+// lookup holds an EpochGuard, hashes once, walks one chain and copies the
+// program - no locks, no writes but the entry's counters. Writers (misses,
+// eviction, invalidate()) are serialized by a mutex and retire what they
+// unlink (see epoch.h).
+// A compiled program depends on the variables of its context only through
+// its slots (units and format of a variable with a value), so an entry keeps
+// a SlotSignature per slot and a hit is used only if they match the calling
+// context. Expressions that define variables or print while compiling are
+// not cached. When full, the least recently used eighth is evicted.
+// invalidate() drops everything - call it when functions change (publishing
+// new units does, see Settings).
+
+class ExpressionCache
+{
+public:
+	explicit ExpressionCache(const size_t capacity);
+
+	/// @brief Frees entries - no reader may be left
+	~ExpressionCache();
+
+	/// @brief Cache used by the library, C interface and server
+	static ExpressionCache& shared();
+
+	/// @brief Program::compile() through the cache. Clear the console's last
+	/// line before - an expression that prints while compiling is not cached.
+	bool compile(const std::string& expression, Program& program, std::string& message);
+
+	/// @brief Drops all entries (units or functions changed)
+	void invalidate();
+
+	/// @brief Statistics of all entries (order is not defined)
+	std::vector<ExpressionStats> statistics() const;
+
+	/// @brief Compiles not answered by the cache
+	uint64_t misses() const { return m_misses.load(std::memory_order_relaxed); }
+
+	size_t size() const { return m_size.load(std::memory_order_relaxed); }
+
+	size_t capacity() const { return m_capacity; }
+
+private:
+	ExpressionCache(const ExpressionCache&) = delete;
+	ExpressionCache& operator=(const ExpressionCache&) = delete;
+
+	typedef struct _cacheEntry
+	{
+		std::string expression;
+		size_t hash;
+		uint64_t settings;  // Version of the units it was compiled with
+		Program program;
+		std::vector<SlotSignature> slots;
+		uint64_t compileNs;
+		mutable std::atomic<uint64_t> hits;
+		mutable std::atomic<uint64_t> lastUsed;
+		mutable std::atomic<const struct _cacheEntry*> next;
+	} CacheEntry;
+
+	/// @brief Copies cached program and its slots - false if not cached
+	bool find(const std::string& expression, const size_t hash, const uint64_t settings,
+		Program& program, std::vector<SlotSignature>& slots) const;
+
+	/// @brief Adds entry (replaces one of the same expression) unless tables
+	/// changed since 'generation' (m_writer held)
+	void insert(CacheEntry* entry, const uint64_t generation);
+
+	/// @brief Unlinks least recently used entries (m_writer held)
+	void evict();
+
+	/// @brief Unlinks entry from its chain (m_writer held)
+	void unlink(const CacheEntry* entry);
+
+	/// @brief Signature of the slots of program in the current context
+	static std::vector<SlotSignature> signatures(const Program& program);
+
+	std::atomic<const CacheEntry*>& bucket(const size_t hash) const { return m_buckets[hash & m_mask]; }
+
+	size_t m_capacity;
+	size_t m_mask;
+	std::unique_ptr<std::atomic<const CacheEntry*>[]> m_buckets;
+	std::atomic<size_t> m_size;
+	std::atomic<uint64_t> m_misses;
+	std::atomic<uint64_t> m_tick;        // Inserts - "time" of lastUsed
+	std::atomic<uint64_t> m_generation;  // invalidate() calls
+
+	// Writers only
+	std::mutex m_writer;
+	EpochRetired<CacheEntry> m_retired;
+};
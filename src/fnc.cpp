@@ -27,6 +27,15 @@
 #include "fncConfig.h"
 
 #include "iniParser.h"
+#include "console.h"
+
+#include "batch.h"
+#include "shardRunner.h"
+#include "stream.h"
+#include "convert.h"
+#include "table.h"
+#include "server.h"
+#include "fncLib.h"
 
 static std::string s_iniPath = FNC_INI_LOCATION;
 static std::string s_iniFileName = FNC_INI_FILENAME; // "fnc.ini";
@@ -46,6 +55,112 @@ void print_version(const char* arg)
 	std::cout << "Copyright (c) 2019-2021 - mmashimo" << std::endl << std::endl;
 }
 
+/// @brief Batch mode help
+void print_help_batch()
+{
+	std::cout << "Batch mode: fnc --batch [options] \"<expression>\"" << std::endl;
+	std::cout << "Runs the expression once per input row. Text rows hold values of the variables" << std::endl;
+	std::cout << "(separated by spaces or commas) - one result is written per row." << std::endl;
+	std::cout << "  --vars x,y          variables of text columns (default: as found in expression)" << std::endl;
+	std::cout << "  --where \"<expr>\"    drop rows where expr is 0 (ex. \"x > 0\") - no output for them" << std::endl;
+	std::cout << "  --input <file>      text input (default: stdin)" << std::endl;
+	std::cout << "  --output <file>     output file (default: stdout)" << std::endl;
+	std::cout << "  --in-f64 x=<file>   raw little-endian float64 values of 'x'" << std::endl;
+	std::cout << "  --in-i64 x=<file>   raw little-endian int64 values of 'x'" << std::endl;
+	std::cout << "                      'x,y=<file>' reads interleaved records (x0 y0 x1 y1 ...)" << std::endl;
+	std::cout << "  --in-f32 x=<file>   raw little-endian float32 values of 'x'" << std::endl;
+	std::cout << "  --out-f64 [<file>]  write raw float64 results" << std::endl;
+	std::cout << "  --out-i64 [<file>]  write raw int64 results" << std::endl;
+	std::cout << "  --out-f32 [<file>]  write raw float32 results" << std::endl;
+	std::cout << "  --f32               evaluate in float32 (about 7 digits, plain numbers only)" << std::endl;
+	std::cout << "  --summary           write count, sum, mean, variance, min, max and quantiles instead of results" << std::endl;
+	std::cout << "  --quantiles <list>  quantiles of summary (default: 0.5,0.9,0.99) - approximate (t-digest)" << std::endl;
+	std::cout << "  -j <N>              evaluate with N threads (0: all cores) - output stays in input order" << std::endl;
+	std::cout << "  --shard <i>/<N>     run only part i (0 .. N-1) of the input file (text: whole lines)" << std::endl;
+	std::cout << "  --processes <N>     run N worker processes, one shard each - output stays in input order" << std::endl;
+	std::cout << "Comparisons <, <=, ==, !=, >=, > give 1 or 0. select(cond, a, b) is a if cond is not 0, otherwise b." << std::endl;
+	std::cout << std::endl;
+}
+
+/// @brief Stream mode help
+void print_help_stream()
+{
+	std::cout << "Stream mode: fnc --stream [options]" << std::endl;
+	std::cout << "Each input line is an expression - one result line is written per expression." << std::endl;
+	std::cout << "Reading, parsing, evaluating and formatting run as a pipeline of threads." << std::endl;
+	std::cout << "  --input <file>      input (default: stdin)" << std::endl;
+	std::cout << "  --output <file>     output (default: stdout)" << std::endl;
+	std::cout << "  --batch-size <N>    lines passed between stages at once (default: 256)" << std::endl;
+	std::cout << "  --queue <N>         batches held between stages (default: 16)" << std::endl;
+	std::cout << "  --stats             show queue occupancy of each stage (stderr)" << std::endl;
+	std::cout << "  --summary           write summary statistics of results instead (see batch mode)" << std::endl;
+	std::cout << "  --quantiles <list>  quantiles of summary (default: 0.5,0.9,0.99)" << std::endl;
+	std::cout << "Rolling functions keep state from line to line: 'x sma N' (moving average), 'x ema a'," << std::endl;
+	std::cout << "'x rmin N', 'x rmax N' (rolling min/max) and 'x delta' (change from previous value)." << std::endl;
+	std::cout << std::endl;
+}
+
+/// @brief Convert mode help
+void print_help_convert()
+{
+	std::cout << "Convert mode: fnc --convert <from> <to> [options]" << std::endl;
+	std::cout << "Converts every input value between units (ex. 'fnc --convert in mm'). Text input" << std::endl;
+	std::cout << "may have several values per line - one result is written per line." << std::endl;
+	std::cout << "  --input <file>      text input (default: stdin)" << std::endl;
+	std::cout << "  --output <file>     output file (default: stdout)" << std::endl;
+	std::cout << "  --in-f64 <file>     raw little-endian float64 input" << std::endl;
+	std::cout << "  --in-i64 <file>     raw little-endian int64 input" << std::endl;
+	std::cout << "  --in-f32 <file>     raw little-endian float32 input (converted in float32)" << std::endl;
+	std::cout << "  --out-f64 [<file>]  write raw float64 results" << std::endl;
+	std::cout << "  --out-i64 [<file>]  write raw int64 results" << std::endl;
+	std::cout << "  --out-f32 [<file>]  write raw float32 results" << std::endl;
+	std::cout << std::endl;
+}
+
+/// @brief Table mode help
+void print_help_table()
+{
+	std::cout << "Table mode: fnc --table <var>=<start>:<stop>[:<step>] [options] \"<expression>\"" << std::endl;
+	std::cout << "Runs the expression for each value of the range (stop included, step default 1)" << std::endl;
+	std::cout << "and writes \"<value> <result>\" rows. Values are always doubles." << std::endl;
+	std::cout << "  --output <file>     output file (default: stdout)" << std::endl;
+	std::cout << "  --out-f64 [<file>]  write raw float64 results (no values)" << std::endl;
+	std::cout << "  --out-i64 [<file>]  write raw int64 results (no values)" << std::endl;
+	std::cout << "  -j <N>              evaluate with N threads (0: all cores) - output stays in order" << std::endl;
+	std::cout << "More ranges (x=0:1:0.5 y=0:2) run every combination: \"<x> <y> <result>\" rows." << std::endl;
+	std::cout << std::endl;
+}
+
+/// @brief Grid mode help
+void print_help_grid()
+{
+	std::cout << "Grid mode: fnc --grid <var>=<start>:<stop>[:<step>] ... [options] \"<expression>\"" << std::endl;
+	std::cout << "Runs the expression over every combination of the ranges (last one changes fastest)" << std::endl;
+	std::cout << "and writes a dense raw array: header \"FNCGRID1\", dims, format, then per axis" << std::endl;
+	std::cout << "name[16], start, stop, step, count - then the results (all 8 bytes, little-endian)." << std::endl;
+	std::cout << "  --output <file>     output file (default: stdout)" << std::endl;
+	std::cout << "  --out-i64 [<file>]  write int64 results (default: float64)" << std::endl;
+	std::cout << "  --text              write \"<x> <y> ... <result>\" rows instead" << std::endl;
+	std::cout << "  -j <N>              evaluate with N threads (0: all cores)" << std::endl;
+	std::cout << std::endl;
+}
+
+/// @brief Server and client mode help
+void print_help_server()
+{
+	std::cout << "Server mode: fnc --serve <socket> [--max-ops <n>] [--max-depth <n>] [--max-time <ms>]" << std::endl;
+	std::cout << "Serves evaluations on a local (Unix) socket until stopped (Ctrl-C or SIGTERM)." << std::endl;
+	std::cout << "Settings are read once; every connection has its own variables and keeps its" << std::endl;
+	std::cout << "expressions compiled. Frames are a 32-bit little-endian length and the bytes:" << std::endl;
+	std::cout << "a request is an expression, a reply a status byte (0: result, 1: message) and text." << std::endl;
+	std::cout << "A request over a limit (functions run, stack depth, milliseconds) fails with" << std::endl;
+	std::cout << "\"Budget exceeded\"; requests never ask for values of unset variables." << std::endl;
+	std::cout << "Depth is limited to " << FNC_DEFAULT_DEPTH << " unless given (0: no limit)." << std::endl;
+	std::cout << "Client mode: fnc --client <socket> [\"<expression>\"]" << std::endl;
+	std::cout << "Writes the result of the expression - or of every line of stdin (as 'fnc --stream')." << std::endl;
+	std::cout << std::endl;
+}
+
 /// @brief Command line help
 void print_help()
 {
@@ -60,6 +175,551 @@ void print_help()
 	std::cout << "- Detailed list of functions, constants, and unit-conversions can be listed." << std::endl;
 
 	std::cout << std::endl;
+	print_help_batch();
+	print_help_stream();
+	print_help_convert();
+	print_help_table();
+	print_help_grid();
+	print_help_server();
+}
+
+/// @brief Default quantiles of summaries
+static const std::vector<double> s_defaultQuantiles {0.5, 0.9, 0.99};
+
+/// @brief Splits comma-separated list of quantiles (0..1)
+static bool parse_quantiles(const char* arg, std::vector<double>& quantiles)
+{
+	quantiles.clear();
+	const char* pos = arg;
+	while (*pos != 0)
+	{
+		char* end = nullptr;
+		double q = strtod(pos, &end);
+		if ((end == pos) || !(q >= 0.) || !(q <= 1.) || ((*end != ',') && (*end != 0)))
+			return false;
+		quantiles.push_back(q);
+		pos = (*end == ',') ? end + 1 : end;
+	}
+	return !quantiles.empty();
+}
+
+/// @brief Raw format of option ("--in-f64", "--out-f32", ...)
+static RawFormat raw_format(const std::string& option)
+{
+	std::string type = option.substr(option.size() - 3);
+	if (type == "i64")
+		return RAW_INT64;
+	return (type == "f32") ? RAW_FLOAT32 : RAW_FLOAT64;
+}
+
+/// @brief Splits comma-separated list of names
+static std::vector<std::string> split_names(const std::string& names)
+{
+	std::vector<std::string> list;
+	size_t pos = 0;
+	while (pos <= names.size())
+	{
+		size_t end = names.find(',', pos);
+		if (end == std::string::npos)
+			end = names.size();
+		if (end > pos)
+			list.push_back(names.substr(pos, end - pos));
+		pos = end + 1;
+	}
+	return list;
+}
+
+/// @brief Parses raw input argument: "x=<file>" or "x,y=<file>"
+static bool parse_raw_input(const char* arg, const RawFormat format, BatchOptions& options)
+{
+	std::string tmp(arg);
+	size_t pos = tmp.find('=');
+	if ((pos == std::string::npos) || (pos == 0) || (pos + 1 == tmp.size()))
+		return false;
+
+	BatchInput input{split_names(tmp.substr(0, pos)), format, tmp.substr(pos + 1)};
+	options.rawInputs.push_back(input);
+	return !input.vars.empty();
+}
+
+/// @brief Runs stream mode - arguments after "--stream"
+int run_stream(int argc, char** argv, int ar)
+{
+	StreamOptions options{"", "", 256, 16, false, false, s_defaultQuantiles};
+
+	while (ar < argc)
+	{
+		std::string arg(argv[ar]);
+		bool hasValue = (ar + 1) < argc;
+
+		if ((arg == "--input") && hasValue)
+		{
+			options.inputFile = argv[++ar];
+		}
+		else if ((arg == "--output") && hasValue)
+		{
+			options.outputFile = argv[++ar];
+		}
+		else if ((arg == "--batch-size") && hasValue)
+		{
+			options.batchSize = strtoul(argv[++ar], nullptr, 10);
+		}
+		else if ((arg == "--queue") && hasValue)
+		{
+			options.queueSize = strtoul(argv[++ar], nullptr, 10);
+		}
+		else if (arg == "--stats")
+		{
+			options.stats = true;
+		}
+		else if (arg == "--summary")
+		{
+			options.summary = true;
+		}
+		else if ((arg == "--quantiles") && hasValue)
+		{
+			if (!parse_quantiles(argv[++ar], options.quantiles))
+			{
+				std::cerr << "Quantiles '" << argv[ar] << "' are not a list of 0..1 - try 'fnc --help'" << std::endl;
+				return 1;
+			}
+			options.summary = true;
+		}
+		else
+		{
+			std::cerr << "Don't know stream option '" << arg << "' - try 'fnc --help'" << std::endl;
+			return 1;
+		}
+		ar++;
+	}
+
+	Stream stream(options);
+	std::string message;
+	if (!stream.run(message))
+	{
+		std::cerr << "! Stream: " << message << std::endl;
+		return 1;
+	}
+	return stream.errors() == 0 ? 0 : 2;
+}
+
+/// @brief Runs convert mode - arguments after "--convert"
+int run_convert(int argc, char** argv, int ar)
+{
+	if ((ar + 2) > argc)
+	{
+		std::cerr << "Convert mode needs units to convert from and to - try 'fnc --help'" << std::endl;
+		return 1;
+	}
+	ConvertOptions options{argv[ar], argv[ar + 1], "", RAW_NONE, RAW_NONE, ""};
+	ar += 2;
+
+	while (ar < argc)
+	{
+		std::string arg(argv[ar]);
+		bool hasValue = (ar + 1) < argc;
+
+		if ((arg == "--input") && hasValue)
+		{
+			options.inputFile = argv[++ar];
+		}
+		else if ((arg == "--output") && hasValue)
+		{
+			options.outputFile = argv[++ar];
+		}
+		else if (((arg == "--in-f64") || (arg == "--in-i64") || (arg == "--in-f32")) && hasValue)
+		{
+			options.inFormat = raw_format(arg);
+			options.inputFile = argv[++ar];
+		}
+		else if ((arg == "--out-f64") || (arg == "--out-i64") || (arg == "--out-f32"))
+		{
+			options.outFormat = raw_format(arg);
+			// File name is optional (stdout)
+			if (hasValue && ((argv[ar + 1][0] != '-') || (strcmp(argv[ar + 1], "-") == 0)))
+			{
+				options.outputFile = argv[++ar];
+			}
+		}
+		else
+		{
+			std::cerr << "Don't know convert option '" << arg << "' - try 'fnc --help'" << std::endl;
+			return 1;
+		}
+		ar++;
+	}
+
+	Convert convert(options);
+	std::string message;
+	if (!convert.run(message))
+	{
+		std::cerr << "! Convert: " << message << std::endl;
+		return 1;
+	}
+	return convert.errors() == 0 ? 0 : 2;
+}
+
+/// @brief Argument looks like a range "x=..." (not an expression like "x==2")
+static bool is_range(const char* arg)
+{
+	if (!isalpha(arg[0]))
+		return false;
+	const char* pos = arg;
+	while (isalnum(*pos) || (*pos == '_'))
+	{
+		pos++;
+	}
+	return (pos[0] == '=') && (pos[1] != '=');
+}
+
+/// @brief Runs table (or grid) mode - arguments after "--table" or "--grid"
+int run_table(int argc, char** argv, int ar, const bool grid)
+{
+	TableOptions options{"", {}, grid ? RAW_FLOAT64 : RAW_NONE, "", 1, grid};
+	const char* mode = grid ? "Grid" : "Table";
+	std::string message;
+
+	// Ranges come first - one per variable
+	while ((ar < argc) && is_range(argv[ar]))
+	{
+		SweepRange range;
+		if (!Table::parseRange(argv[ar], range, message))
+		{
+			std::cerr << "! " << mode << ": " << message << " - try 'fnc --help'" << std::endl;
+			return 1;
+		}
+		options.ranges.push_back(range);
+		ar++;
+	}
+	if (options.ranges.empty())
+	{
+		std::cerr << "! " << mode << ": needs a range - try 'fnc --help'" << std::endl;
+		return 1;
+	}
+
+	while (ar < argc)
+	{
+		std::string arg(argv[ar]);
+		bool hasValue = (ar + 1) < argc;
+		bool ok = true;
+
+		if (((arg == "-j") || (arg == "--threads")) && hasValue)
+		{
+			char* end = nullptr;
+			options.threads = strtoul(argv[++ar], &end, 10);
+			ok = (end != nullptr) && (*end == 0);
+		}
+		else if ((arg == "--output") && hasValue)
+		{
+			options.outputFile = argv[++ar];
+		}
+		else if ((arg == "--out-f64") || (arg == "--out-i64"))
+		{
+			options.outFormat = (arg == "--out-f64") ? RAW_FLOAT64 : RAW_INT64;
+			// File name is optional (stdout), but it cannot be the expression
+			if (hasValue && (!options.expression.empty() || ((ar + 2) < argc))
+				&& ((argv[ar + 1][0] != '-') || (strcmp(argv[ar + 1], "-") == 0)))
+			{
+				options.outputFile = argv[++ar];
+			}
+		}
+		else if (grid && (arg == "--text"))
+		{
+			options.outFormat = RAW_NONE;
+		}
+		else if ((arg.size() > 2) && (arg[0] == '-') && (arg[1] == '-'))
+		{
+			ok = false;
+		}
+		else if (options.expression.empty())
+		{
+			options.expression = arg;
+		}
+		else
+		{
+			// Rest of the expression
+			options.expression += " ";
+			options.expression += arg;
+		}
+
+		if (!ok)
+		{
+			std::cerr << "Don't know " << (grid ? "grid" : "table") << " option '" << arg << "' - try 'fnc --help'" << std::endl;
+			return 1;
+		}
+		ar++;
+	}
+
+	if (options.expression.empty())
+	{
+		std::cerr << mode << " mode needs an expression - try 'fnc --help'" << std::endl;
+		return 1;
+	}
+
+	Table table(options);
+	if (!table.run(message))
+	{
+		std::cerr << "! " << mode << ": " << message << std::endl;
+		return 1;
+	}
+	return table.errors() == 0 ? 0 : 2;
+}
+
+/// @brief Runs batch mode - arguments after "--batch"
+int run_batch(int argc, char** argv, int ar)
+{
+	BatchOptions options{"", "", {}, "", {}, RAW_NONE, "", 1, 0, 1, false, false, s_defaultQuantiles};
+	size_t processes = 1;
+
+	while (ar < argc)
+	{
+		std::string arg(argv[ar]);
+		bool hasValue = (ar + 1) < argc;
+		bool ok = true;
+
+		if (((arg == "-j") || (arg == "--threads")) && hasValue)
+		{
+			char* end = nullptr;
+			options.threads = strtoul(argv[++ar], &end, 10);
+			ok = (end != nullptr) && (*end == 0);
+		}
+		else if ((arg == "--vars") && hasValue)
+		{
+			options.vars = split_names(argv[++ar]);
+		}
+		else if ((arg == "--where") && hasValue)
+		{
+			options.where = argv[++ar];
+		}
+		else if ((arg == "--shard") && hasValue)
+		{
+			char* end = nullptr;
+			options.shard = strtoul(argv[++ar], &end, 10);
+			ok = (end != nullptr) && (*end == '/');
+			if (ok)
+			{
+				options.shards = strtoul(end + 1, &end, 10);
+				ok = (*end == 0) && (options.shard < options.shards);
+			}
+		}
+		else if (arg == "--f32")
+		{
+			options.float32 = true;
+		}
+		else if (arg == "--summary")
+		{
+			options.summary = true;
+		}
+		else if ((arg == "--quantiles") && hasValue)
+		{
+			options.summary = true;
+			ok = parse_quantiles(argv[++ar], options.quantiles);
+		}
+		else if ((arg == "--processes") && hasValue)
+		{
+			char* end = nullptr;
+			processes = strtoul(argv[++ar], &end, 10);
+			ok = (end != nullptr) && (*end == 0) && (processes > 0);
+		}
+		else if ((arg == "--input") && hasValue)
+		{
+			options.inputFile = argv[++ar];
+		}
+		else if ((arg == "--output") && hasValue)
+		{
+			options.outputFile = argv[++ar];
+		}
+		else if (((arg == "--in-f64") || (arg == "--in-i64") || (arg == "--in-f32")) && hasValue)
+		{
+			ok = parse_raw_input(argv[++ar], raw_format(arg), options);
+		}
+		else if ((arg == "--out-f64") || (arg == "--out-i64") || (arg == "--out-f32"))
+		{
+			options.outFormat = raw_format(arg);
+			// File name is optional (stdout), but it cannot be the expression
+			if (hasValue && (!options.expression.empty() || ((ar + 2) < argc))
+				&& ((argv[ar + 1][0] != '-') || (strcmp(argv[ar + 1], "-") == 0)))
+			{
+				options.outputFile = argv[++ar];
+			}
+		}
+		else if ((arg.size() > 2) && (arg[0] == '-') && (arg[1] == '-'))
+		{
+			ok = false;
+		}
+		else if (options.expression.empty())
+		{
+			options.expression = arg;
+		}
+		else
+		{
+			// Rest of the expression
+			options.expression += " ";
+			options.expression += arg;
+		}
+
+		if (!ok)
+		{
+			std::cerr << "Don't know batch option '" << arg << "' - try 'fnc --help'" << std::endl;
+			return 1;
+		}
+		ar++;
+	}
+
+	if (options.expression.empty())
+	{
+		std::cerr << "Batch mode needs an expression - try 'fnc --help'" << std::endl;
+		return 1;
+	}
+
+	if (options.summary && (options.outFormat != RAW_NONE))
+	{
+		std::cerr << "Summary is text - it cannot be written with --out-f64/--out-i64/--out-f32" << std::endl;
+		return 1;
+	}
+
+	std::string message;
+	if (processes > 1)
+	{
+		if (options.shards > 1)
+		{
+			std::cerr << "Batch mode takes either --shard or --processes - try 'fnc --help'" << std::endl;
+			return 1;
+		}
+		if (options.summary)
+		{
+			std::cerr << "Summary needs all results in one process - use -j instead of --processes" << std::endl;
+			return 1;
+		}
+
+		ShardRunner runner(options, processes);
+		if (!runner.run(message))
+		{
+			std::cerr << "! Batch: " << message << std::endl;
+			return 1;
+		}
+		return runner.exitCode();
+	}
+
+	Batch batch(options);
+	if (!batch.run(message))
+	{
+		std::cerr << "! Batch: " << message << std::endl;
+		return 1;
+	}
+	return batch.errors() == 0 ? 0 : 2;
+}
+
+/// @brief Runs server mode - arguments after "--serve"
+int run_serve(int argc, char** argv, int ar)
+{
+	if (ar >= argc)
+	{
+		std::cerr << "Server mode needs a socket path - try 'fnc --help'" << std::endl;
+		return 1;
+	}
+	std::string path = argv[ar++];
+
+	// Requests never ask for input - one bad request must not hold its connection
+	// (or take the server down with a deep nesting)
+	FncBudget budget {0, FNC_DEFAULT_DEPTH, 0, false};
+	for (; ar < argc; ar++)
+	{
+		std::string arg = argv[ar];
+		bool hasValue = (ar + 1) < argc;
+		if ((arg == "--max-ops") && hasValue)
+		{
+			budget.maxOperations = strtoull(argv[++ar], nullptr, 10);
+		}
+		else if ((arg == "--max-depth") && hasValue)
+		{
+			budget.maxDepth = strtoul(argv[++ar], nullptr, 10);
+		}
+		else if ((arg == "--max-time") && hasValue)
+		{
+			budget.maxTimeUs = strtoull(argv[++ar], nullptr, 10) * 1000;
+		}
+		else
+		{
+			std::cerr << "Don't know server option '" << arg << "' - try 'fnc --help'" << std::endl;
+			return 1;
+		}
+	}
+	Context::current().setBudget(budget);
+
+	// Requests that start after an edit of the INI or units file use it
+	std::string message;
+	FncWatcher watcher(s_iniFile, [](const std::string& line) { std::cerr << line << std::endl; });
+	if (!watcher.start(message))
+	{
+		std::cerr << "! " << message << std::endl;
+	}
+
+	Server server(path);
+	if (!server.run(message))
+	{
+		std::cerr << "! Server: " << message << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+/// @brief Runs client mode - arguments after "--client"
+int run_client(int argc, char** argv, int ar)
+{
+	if (ar >= argc)
+	{
+		std::cerr << "Client mode needs a socket path - try 'fnc --help'" << std::endl;
+		return 1;
+	}
+
+	std::string message;
+	Client client(argv[ar++]);
+	if (!client.open(message))
+	{
+		std::cerr << "! Client: " << message << std::endl;
+		return 1;
+	}
+
+	// Expression of the arguments - or each line of stdin
+	std::string expression;
+	for (; ar < argc; ar++)
+	{
+		if (!expression.empty())
+		{
+			expression += " ";
+		}
+		expression += argv[ar];
+	}
+	bool fromInput = expression.empty();
+
+	size_t errors = 0;
+	size_t lineNo = 0;
+	while (!fromInput || std::getline(std::cin, expression))
+	{
+		lineNo++;
+		bool ok = false;
+		std::string result;
+		if (!client.request(expression, ok, result, message))
+		{
+			std::cerr << "! Client: " << message << std::endl;
+			return 1;
+		}
+		if (ok)
+		{
+			std::cout << result << '\n';
+		}
+		else
+		{
+			errors++;
+			std::cout << "nan" << '\n';
+			std::cerr << "! Line " << lineNo << ": " << result << std::endl;
+		}
+		if (!fromInput)
+			break;
+	}
+	std::cout.flush();
+	return errors == 0 ? 0 : 2;
 }
 
 /// @brief Some command line help details (uses Exec::printHelp, also).
@@ -71,6 +731,15 @@ void print_help_detail(const std::string& help)
 /// @brief Simple test for 'fnc' (Exec) - libraries
 int main(int argc, char** argv)
 {
+	// Messages of the evaluator (and values of unset variables) use the console
+	Console::useStandardIo();
+
+	// Client does not evaluate - it starts without reading settings
+	if ((argc > 1) && (strcmp(argv[1], "--client") == 0))
+	{
+		return run_client(argc, argv, 2);
+	}
+
 	// Setting INI file, if will reload later
 	std::string iniFile;
 
@@ -94,6 +763,14 @@ int main(int argc, char** argv)
 		print_version(argv[0]);
 		std::cout << "Entering interactive mode. '?' for help; 'q<Enter>' to quit" << std::endl;
 
+		// Edits of the INI or units file apply from the next expression on
+		std::string message;
+		FncWatcher watcher(iniFile, [](const std::string& line) { std::cout << line << std::endl; });
+		if (!watcher.start(message))
+		{
+			std::cout << "! " << message << std::endl;
+		}
+
 		// Do Interactive mode
 		return cmd.runInteractive();
 	}
@@ -127,6 +804,30 @@ int main(int argc, char** argv)
 			}
 			return 0;
 		}
+		else if (strcmp(option, "batch") == 0)
+		{
+			return run_batch(argc, argv, 2);
+		}
+		else if (strcmp(option, "stream") == 0)
+		{
+			return run_stream(argc, argv, 2);
+		}
+		else if (strcmp(option, "convert") == 0)
+		{
+			return run_convert(argc, argv, 2);
+		}
+		else if (strcmp(option, "table") == 0)
+		{
+			return run_table(argc, argv, 2, false);
+		}
+		else if (strcmp(option, "grid") == 0)
+		{
+			return run_table(argc, argv, 2, true);
+		}
+		else if (strcmp(option, "serve") == 0)
+		{
+			return run_serve(argc, argv, 2);
+		}
 		else if (strncmp(option, "vers", 4) == 0)
 		{
 			print_version(argv[0]);
@@ -0,0 +1,301 @@
+/// @file
+///
+/// @brief Implementation of the C interface of libfnc.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <memory>
+#include <new>
+
+#include "fncApi.h"
+#include "fncLib.h"
+#include "console.h"
+#include "program.h"
+#include "blockProgram.h"
+#include "expressionCache.h"
+#include "context.h"
+
+/// @brief Compiled expression behind the handle
+struct fnc_program
+{
+	Program program;
+	std::vector<Num> inputs;  // One per slot - units given by fnc_bind()
+	BlockProgram block;
+	bool blocks;              // Arrays run through 'block'
+};
+
+/// @brief Message of the last failed call (see fnc_last_message())
+static thread_local std::string s_message;
+
+/// @brief Saves message (with the last diagnostic of a function) and returns status
+static fnc_status failed(const fnc_status status, const std::string& message)
+{
+	s_message = message;
+	if (!Console::lastLine().empty())
+	{
+		s_message += " - " + Console::lastLine();
+	}
+	return status;
+}
+
+/// @brief Runs one row through the program
+static fnc_status runRow(const fnc_program* program, std::vector<Num>& inputs, double& result)
+{
+	// Stack is kept by each thread - no allocations once it has grown
+	static thread_local NumStack s_stack;
+	std::string message;
+
+	Console::clearLastLine();
+	if (!program->program.run(inputs.data(), s_stack, message))
+	{
+		result = NAN;
+		return failed((Context::current().exceeded() != FNC_LIMIT_NONE) ? FNC_ERROR_BUDGET : FNC_ERROR_EVALUATE, message);
+	}
+
+	result = s_stack.back().asDouble();
+	return FNC_OK;
+}
+
+extern "C" {
+
+fnc_program* fnc_compile(const char* expression, fnc_status* status)
+{
+	fnc_status dummy = FNC_OK;
+	fnc_status& result = status ? *status : dummy;
+	if (!expression)
+	{
+		result = failed(FNC_ERROR_ARGUMENT, "No expression");
+		return nullptr;
+	}
+
+	try
+	{
+		std::unique_ptr<fnc_program> program(new fnc_program());
+		std::string message;
+		Console::clearLastLine();
+		if (!ExpressionCache::shared().compile(expression, program->program, message))
+		{
+			result = failed((Context::current().exceeded() != FNC_LIMIT_NONE) ? FNC_ERROR_BUDGET : FNC_ERROR_PARSE, message);
+			return nullptr;
+		}
+		if (program->program.empty())
+		{
+			result = failed(FNC_ERROR_PARSE, std::string("Expression '") + expression + "' has no results");
+			return nullptr;
+		}
+		if (!program->program.resolve(program->program.unsetVariables(), message))
+		{
+			result = failed(FNC_ERROR_PARSE, message);
+			return nullptr;
+		}
+
+		program->inputs.assign(program->program.slots(), Num(0., NUM_DOUBLE));
+		program->blocks = program->block.build(program->program, message);
+		result = FNC_OK;
+		return program.release();
+	}
+	catch (const std::bad_alloc&)
+	{
+		result = failed(FNC_ERROR_MEMORY, "Out of memory");
+	}
+	catch (const std::exception& e)
+	{
+		result = failed(FNC_ERROR_PARSE, e.what());
+	}
+	return nullptr;
+}
+
+void fnc_free(fnc_program* program)
+{
+	delete program;
+}
+
+size_t fnc_slots(const fnc_program* program)
+{
+	return program ? program->inputs.size() : 0;
+}
+
+const char* fnc_slot_name(const fnc_program* program, size_t slot)
+{
+	if (!program || (slot >= program->inputs.size()))
+		return nullptr;
+	return program->program.slotName(slot).c_str();
+}
+
+fnc_status fnc_bind(fnc_program* program, size_t slot, const char* unit)
+{
+	if (!program || (slot >= program->inputs.size()))
+		return failed(FNC_ERROR_ARGUMENT, "No such slot");
+
+	try
+	{
+		Num& input = program->inputs[slot];
+		if (!unit || !*unit)
+		{
+			input.m_unit = NumUnit();
+		}
+		else
+		{
+			UnitDefs def;
+			if (NumUnit::findUnits(unit, def) < 0)
+				return failed(FNC_ERROR_UNIT, std::string("Unknown unit '") + unit + "'");
+			input.m_unit = NumUnit(def);
+		}
+
+		// Columns are plain doubles - inputs with units run row by row
+		bool plain = true;
+		for (const auto& it : program->inputs)
+		{
+			plain = plain && it.m_unit.keyString().empty();
+		}
+		std::string message;
+		program->blocks = plain && program->block.build(program->program, message);
+		return FNC_OK;
+	}
+	catch (const std::bad_alloc&)
+	{
+		return failed(FNC_ERROR_MEMORY, "Out of memory");
+	}
+	catch (const std::exception& e)
+	{
+		return failed(FNC_ERROR_ARGUMENT, e.what());
+	}
+}
+
+fnc_status fnc_eval(const fnc_program* program, const double* values, double* result)
+{
+	if (!program || !result || (!values && !program->inputs.empty()))
+		return failed(FNC_ERROR_ARGUMENT, "No program, values or result");
+
+	try
+	{
+		static thread_local std::vector<Num> s_inputs;
+		s_inputs = program->inputs;
+		for (size_t i = 0; i < s_inputs.size(); i++)
+		{
+			s_inputs[i].m_dValue = values[i];
+		}
+		return runRow(program, s_inputs, *result);
+	}
+	catch (const std::bad_alloc&)
+	{
+		*result = NAN;
+		return failed(FNC_ERROR_MEMORY, "Out of memory");
+	}
+	catch (const std::exception& e)
+	{
+		*result = NAN;
+		return failed(FNC_ERROR_EVALUATE, e.what());
+	}
+}
+
+fnc_status fnc_eval_array(const fnc_program* program, const double* const* columns,
+	size_t rows, double* results)
+{
+	if (!program || (rows && !results) || (!columns && !program->inputs.empty()))
+		return failed(FNC_ERROR_ARGUMENT, "No program, columns or results");
+
+	try
+	{
+		const size_t slots = program->inputs.size();
+		if (program->blocks && program->block.constantResult())
+		{
+			double value = program->block.constant().asDouble();
+			for (size_t i = 0; i < rows; i++)
+			{
+				results[i] = value;
+			}
+			return FNC_OK;
+		}
+
+		if (program->blocks)
+		{
+			std::vector<double> scratch(program->block.columns() * BLOCK_VALUES);
+			std::vector<const double*> inputs(slots);
+			for (size_t row = 0; row < rows; row += BLOCK_VALUES)
+			{
+				size_t count = std::min(BLOCK_VALUES, rows - row);
+				for (size_t k = 0; k < slots; k++)
+				{
+					inputs[k] = columns[k] + row;
+				}
+				program->block.run(inputs.data(), count, scratch.data(), results + row);
+			}
+			return FNC_OK;
+		}
+
+		fnc_status status = FNC_OK;
+		std::vector<Num> inputs = program->inputs;
+		for (size_t row = 0; row < rows; row++)
+		{
+			for (size_t k = 0; k < slots; k++)
+			{
+				inputs[k].m_dValue = columns[k][row];
+			}
+			fnc_status rowStatus = runRow(program, inputs, results[row]);
+			if (status == FNC_OK)
+			{
+				status = rowStatus;
+			}
+		}
+		return status;
+	}
+	catch (const std::bad_alloc&)
+	{
+		return failed(FNC_ERROR_MEMORY, "Out of memory");
+	}
+	catch (const std::exception& e)
+	{
+		return failed(FNC_ERROR_EVALUATE, e.what());
+	}
+}
+
+const char* fnc_status_text(fnc_status status)
+{
+	switch (status)
+	{
+	case FNC_OK:             return "OK";
+	case FNC_ERROR_ARGUMENT: return "Invalid argument";
+	case FNC_ERROR_PARSE:    return "Expression cannot be compiled";
+	case FNC_ERROR_UNIT:     return "Unknown unit";
+	case FNC_ERROR_EVALUATE: return "Evaluation failed";
+	case FNC_ERROR_MEMORY:   return "Out of memory";
+	case FNC_ERROR_BUDGET:   return "Budget exceeded";
+	}
+	return "Unknown status";
+}
+
+void fnc_set_budget(unsigned long long max_operations, size_t max_depth,
+	unsigned long long max_time_us, int interactive)
+{
+	Context::current().setBudget(FncBudget{max_operations, max_depth, max_time_us, interactive != 0});
+}
+
+const char* fnc_last_message(void)
+{
+	return s_message.c_str();
+}
+
+const char* fnc_version(void)
+{
+	return FncLib::version();
+}
+
+} // extern "C"
@@ -0,0 +1,99 @@
+/// @file
+///
+/// @brief C interface of libfnc - compiled expressions behind opaque handles.
+///
+/// For callers that cannot use C++ (other languages, plugins loaded with dlopen).
+/// Nothing is written to the console: every call returns a status code and
+/// fnc_last_message() tells what went wrong.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Result of every call - values are part of the ABI and never change
+typedef enum fnc_status
+{
+	FNC_OK = 0,
+	FNC_ERROR_ARGUMENT = 1,  // NULL handle or pointer, slot out of range
+	FNC_ERROR_PARSE = 2,     // Expression cannot be parsed or has no result
+	FNC_ERROR_UNIT = 3,      // Unknown unit
+	FNC_ERROR_EVALUATE = 4,  // A function failed (result is NaN)
+	FNC_ERROR_MEMORY = 5,    // Out of memory
+	FNC_ERROR_BUDGET = 6     // Over a limit of fnc_set_budget() (result is NaN)
+} fnc_status;
+
+/// @brief Compiled expression
+typedef struct fnc_program fnc_program;
+
+// How the C interface works:
+// fnc_compile() parses an expression once. Variables that have no value
+// become input slots, numbered in the order they appear; values of other
+// variables are taken when compiling. fnc_bind() gives a slot its unit
+// (ex. "km") - call it before the program is shared. After that a program is
+// read-only: any number of threads may evaluate it at once. Plain (unitless)
+// programs evaluate arrays column by column (vectorized).
+// Calls use the variables and settings of the calling thread (see FncContext).
+
+/// @brief Compiles expression - NULL on failure ('status' says why, may be NULL)
+fnc_program* fnc_compile(const char* expression, fnc_status* status);
+
+/// @brief Frees program (NULL is ignored)
+void fnc_free(fnc_program* program);
+
+/// @brief Number of input slots (values per row)
+size_t fnc_slots(const fnc_program* program);
+
+/// @brief Variable name of slot - NULL if out of range
+const char* fnc_slot_name(const fnc_program* program, size_t slot);
+
+/// @brief Slot values are in 'unit' (NULL or "" - plain numbers)
+fnc_status fnc_bind(fnc_program* program, size_t slot, const char* unit);
+
+/// @brief Evaluates one row - 'values' has fnc_slots() values (may be NULL if none).
+/// The result is a plain number in the unit of the expression.
+fnc_status fnc_eval(const fnc_program* program, const double* values, double* result);
+
+/// @brief Evaluates 'rows' rows - 'columns' has one array of 'rows' values per slot.
+/// Failed rows are NaN and the call returns FNC_ERROR_EVALUATE (message of the last one).
+fnc_status fnc_eval_array(const fnc_program* program, const double* const* columns,
+	size_t rows, double* results);
+
+/// @brief Limits of each compile and evaluation of the calling thread (0 - no limit):
+/// functions run, stack depth (and nesting), wall time in microseconds. Without
+/// 'interactive', unset variables never ask the input callback. Until called,
+/// only the depth is limited (to FNC_DEFAULT_DEPTH of fncLib.h - 256).
+void fnc_set_budget(unsigned long long max_operations, size_t max_depth,
+	unsigned long long max_time_us, int interactive);
+
+/// @brief Text of status
+const char* fnc_status_text(fnc_status status);
+
+/// @brief Message of the last failed call of this thread ("" if none)
+const char* fnc_last_message(void);
+
+/// @brief Version of the library ("major.minor")
+const char* fnc_version(void);
+
+#ifdef __cplusplus
+}
+#endif
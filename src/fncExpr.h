@@ -0,0 +1,378 @@
+/// @file
+///
+/// @brief fnc formulas written in C++ - header only, compiled with the code that uses them.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "fncKernels.h"
+#include "fncLib.h"
+
+// How expressions work:
+// fnc::x, fnc::y and fnc::z (fnc::arg<N>() for more) stand for the values an
+// expression is called with. Operators and functions on them build a tree of
+// types - nothing is parsed or interpreted: calling it runs code the compiler
+// inlines, using the kernels of fncKernels.h like the fnc engine does.
+//
+//   auto toF = fnc::x * 9 / 5 + 32;
+//   double f = toF(25.);                                  // 77
+//   auto rise = fnc::y * fnc::tan(fnc::x);                // angle x in degrees
+//   auto miles = fnc::convert(fnc::x, "km", "mi");        // units of fnc
+//
+// - Values are doubles, as in batch mode (BlockProgram) - no integer math.
+// - C++ parses the expression: operators have C++ precedence, not the
+//   left-to-right order of fnc ("2 + x * 3" multiplies first; write it with
+//   parentheses as you would in fnc). Integer constants are C++ integers
+//   until they meet an expression ("x * (9 / 5)" is x * 1; "x * 9 / 5" is fine).
+// - sin(), cos(), tan() take and asin(), acos(), atan() give angles in the
+//   default angle unit of the thread building the expression ("deg" unless
+//   set - see FncLib::setDefaultAngle()). convert() takes the conversion of
+//   the units fnc has (units file included) when it is built. Both are looked
+//   up once; unknown units throw std::invalid_argument.
+// - Comparisons give 1 or 0 and select(cond, a, b) picks a if cond is not 0,
+//   as in fnc. ^ is not power (its C++ precedence is too low) - use pow().
+// - Results are those of fnc on the same values, bit for bit - except where
+//   the compiler sees more than fnc can: pow(x, 2) becomes x * x, which may
+//   differ from the engine's pow() in the last bit.
+// - Expressions are values: copy them, keep them, call them from any thread.
+// Conversions and default angle come from libfnc (link it); the rest of an
+// expression does not call the library.
+
+namespace fnc
+{
+
+/// @brief Conversion resolved by fnc - value * scale + offset
+typedef struct _affine
+{
+	double scale;
+	double offset;
+} Affine;
+
+/// @brief Expression - 'node' is the tree (see the node types below)
+template <typename Node>
+struct Expr
+{
+	Node node;
+
+	/// @brief Values of the expression for arg<0>, arg<1>, ...
+	static constexpr size_t ARGS = Node::ARGS;
+
+	/// @brief Runs expression on values (as many as it uses at least)
+	template <typename... Values>
+	double operator()(const Values... values) const
+	{
+		static_assert(sizeof...(Values) >= ARGS, "fnc: expression takes more values");
+		const double row[sizeof...(Values) + 1] = {static_cast<double>(values)..., 0.};
+		return node.eval(row);
+	}
+
+	/// @brief Runs expression on 'count' rows - 'columns' has one column per value
+	void run(const double* const* columns, const size_t count, double* results) const
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			results[i] = node.eval(Row{columns, i});
+		}
+	}
+
+	/// @brief Values of one row of columns
+	typedef struct _row
+	{
+		const double* const* columns;
+		size_t index;
+		double operator[](const size_t n) const { return columns[n][index]; }
+	} Row;
+};
+
+// Nodes - each one has ARGS (values it reads) and eval(values)
+
+/// @brief Value 'N' of the call
+template <size_t N>
+struct Arg
+{
+	static constexpr size_t ARGS = N + 1;
+
+	template <typename Values>
+	double eval(const Values& values) const { return values[N]; }
+};
+
+/// @brief Constant
+struct Const
+{
+	static constexpr size_t ARGS = 0;
+
+	double value;
+
+	template <typename Values>
+	double eval(const Values&) const { return value; }
+};
+
+template <typename Op, typename A>
+struct Unary
+{
+	static constexpr size_t ARGS = A::ARGS;
+
+	A a;
+
+	template <typename Values>
+	double eval(const Values& values) const { return Op::apply(a.eval(values)); }
+};
+
+template <typename Op, typename A, typename B>
+struct Binary
+{
+	static constexpr size_t ARGS = std::max(A::ARGS, B::ARGS);
+
+	A a;
+	B b;
+
+	template <typename Values>
+	double eval(const Values& values) const { return Op::apply(a.eval(values), b.eval(values)); }
+};
+
+/// @brief a if cond is not 0, otherwise b - both are run (no branch)
+template <typename C, typename A, typename B>
+struct Select
+{
+	static constexpr size_t ARGS = std::max(C::ARGS, std::max(A::ARGS, B::ARGS));
+
+	C cond;
+	A a;
+	B b;
+
+	template <typename Values>
+	double eval(const Values& values) const
+	{
+		return kernel::select(cond.eval(values), a.eval(values), b.eval(values));
+	}
+};
+
+/// @brief Unit conversion (angles of trig functions too)
+template <typename A>
+struct Convert
+{
+	static constexpr size_t ARGS = A::ARGS;
+
+	A a;
+	Affine conversion;
+
+	template <typename Values>
+	double eval(const Values& values) const
+	{
+		return kernel::affine(a.eval(values), conversion.scale, conversion.offset);
+	}
+};
+
+namespace detail
+{
+
+template <typename T>
+struct IsExpr : std::false_type {};
+
+template <typename Node>
+struct IsExpr<Expr<Node>> : std::true_type {};
+
+/// @brief Operands of operators - an expression and an expression or a number
+template <typename L, typename R>
+using EnableOperands = typename std::enable_if<
+	(IsExpr<L>::value && (IsExpr<R>::value || std::is_arithmetic<R>::value))
+	|| (std::is_arithmetic<L>::value && IsExpr<R>::value)>::type;
+
+/// @brief Node of an operand - numbers become constants
+template <typename Node>
+inline Node node(const Expr<Node>& e) { return e.node; }
+
+template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+inline Const node(const T value) { return Const{static_cast<double>(value)}; }
+
+template <typename T>
+using NodeOf = decltype(node(std::declval<T>()));
+
+template <typename Op, typename L, typename R>
+inline Expr<Binary<Op, NodeOf<L>, NodeOf<R>>> binary(const L& l, const R& r)
+{
+	return {{node(l), node(r)}};
+}
+
+/// @brief Conversion between units - throws std::invalid_argument if fnc has none
+inline Affine resolve(const std::string& from, const std::string& to)
+{
+	Affine conversion{1., 0.};
+	std::string message;
+	if (!FncLib::conversion(from, to, conversion.scale, conversion.offset, message))
+		throw std::invalid_argument(message);
+	return conversion;
+}
+
+/// @brief Conversion of angles - none if the default unit is radians
+inline Affine angle(const std::string& from, const std::string& to)
+{
+	// fnc does not convert then - x + -0. is x, signed zeros included
+	return (from == to) ? Affine{1., -0.} : resolve(from, to);
+}
+
+} // namespace detail
+
+/// @brief Value 'N' of the call
+template <size_t N>
+constexpr Expr<Arg<N>> arg() { return {}; }
+
+constexpr Expr<Arg<0>> x {};
+constexpr Expr<Arg<1>> y {};
+constexpr Expr<Arg<2>> z {};
+
+/// @brief Number as an expression (ex. to start one with a constant)
+inline Expr<Const> value(const double number) { return {{number}}; }
+
+// Operations - each runs the kernel of the fnc function of the same name
+#define FNC_EXPR_BINARY(name, kernelName) \
+	struct name##Op { static double apply(const double a, const double b) { return kernel::kernelName(a, b); } }; \
+	template <typename L, typename R, typename = detail::EnableOperands<L, R>> \
+	inline auto name(const L& l, const R& r) { return detail::binary<name##Op>(l, r); }
+
+#define FNC_EXPR_OPERATOR(symbol, name) \
+	template <typename L, typename R, typename = detail::EnableOperands<L, R>> \
+	inline auto operator symbol(const L& l, const R& r) { return detail::binary<name##Op>(l, r); }
+
+#define FNC_EXPR_UNARY(name, kernelName) \
+	struct name##Op { static double apply(const double a) { return kernel::kernelName(a); } }; \
+	template <typename Node> \
+	inline Expr<Unary<name##Op, Node>> name(const Expr<Node>& e) { return {{e.node}}; }
+
+FNC_EXPR_BINARY(add, add)
+FNC_EXPR_BINARY(sub, sub)
+FNC_EXPR_BINARY(mul, mul)
+FNC_EXPR_BINARY(div, div)
+FNC_EXPR_BINARY(pow, pow)
+FNC_EXPR_BINARY(root, root)
+FNC_EXPR_BINARY(mod, mod)
+FNC_EXPR_BINARY(max, max)
+FNC_EXPR_BINARY(min, min)
+FNC_EXPR_BINARY(lt, lt)
+FNC_EXPR_BINARY(le, le)
+FNC_EXPR_BINARY(eq, eq)
+FNC_EXPR_BINARY(ne, ne)
+FNC_EXPR_BINARY(ge, ge)
+FNC_EXPR_BINARY(gt, gt)
+
+FNC_EXPR_OPERATOR(+, add)
+FNC_EXPR_OPERATOR(-, sub)
+FNC_EXPR_OPERATOR(*, mul)
+FNC_EXPR_OPERATOR(/, div)
+FNC_EXPR_OPERATOR(%, mod)
+FNC_EXPR_OPERATOR(<, lt)
+FNC_EXPR_OPERATOR(<=, le)
+FNC_EXPR_OPERATOR(==, eq)
+FNC_EXPR_OPERATOR(!=, ne)
+FNC_EXPR_OPERATOR(>=, ge)
+FNC_EXPR_OPERATOR(>, gt)
+
+FNC_EXPR_UNARY(sqrt, sqrt)
+FNC_EXPR_UNARY(sqr, sqrt)
+FNC_EXPR_UNARY(abs, abs)
+FNC_EXPR_UNARY(neg, neg)
+FNC_EXPR_UNARY(inv, inv)
+FNC_EXPR_UNARY(exp, exp)
+FNC_EXPR_UNARY(exp10, exp10)
+FNC_EXPR_UNARY(e10x, exp10)
+FNC_EXPR_UNARY(exp2, exp2)
+FNC_EXPR_UNARY(e2x, exp2)
+FNC_EXPR_UNARY(ln, ln)
+FNC_EXPR_UNARY(logn, ln)
+FNC_EXPR_UNARY(log, log10)
+FNC_EXPR_UNARY(log10, log10)
+FNC_EXPR_UNARY(log2, log2)
+FNC_EXPR_UNARY(sinh, sinh)
+FNC_EXPR_UNARY(cosh, cosh)
+FNC_EXPR_UNARY(tanh, tanh)
+FNC_EXPR_UNARY(asinh, asinh)
+FNC_EXPR_UNARY(acosh, acosh)
+FNC_EXPR_UNARY(atanh, atanh)
+FNC_EXPR_UNARY(ceil, ceil)
+FNC_EXPR_UNARY(floor, floor)
+FNC_EXPR_UNARY(frac, frac)
+
+// Radians in and out - the trig functions below convert the default angle unit
+FNC_EXPR_UNARY(sinRad, sin)
+FNC_EXPR_UNARY(cosRad, cos)
+FNC_EXPR_UNARY(tanRad, tan)
+FNC_EXPR_UNARY(asinRad, asin)
+FNC_EXPR_UNARY(acosRad, acos)
+FNC_EXPR_UNARY(atanRad, atan)
+
+#undef FNC_EXPR_BINARY
+#undef FNC_EXPR_OPERATOR
+#undef FNC_EXPR_UNARY
+
+template <typename Node>
+inline Expr<Unary<negOp, Node>> operator-(const Expr<Node>& e) { return {{e.node}}; }
+
+/// @brief a if cond is not 0, otherwise b
+template <typename C, typename A, typename B>
+inline Expr<Select<C, detail::NodeOf<A>, detail::NodeOf<B>>> select(const Expr<C>& cond,
+	const A& a, const B& b)
+{
+	return {{cond.node, detail::node(a), detail::node(b)}};
+}
+
+/// @brief Converts value in unit 'from' to unit 'to' (ex. "km", "mi") - as "::" does
+template <typename Node>
+inline Expr<Convert<Node>> convert(const Expr<Node>& e, const std::string& from, const std::string& to)
+{
+	return {{e.node, detail::resolve(from, to)}};
+}
+
+/// @brief Angle of the default unit to radians (unchanged if it is "rad")
+template <typename Node>
+inline Expr<Convert<Node>> toRadians(const Expr<Node>& e)
+{
+	return {{e.node, detail::angle(FncLib::defaultAngle(), "rad")}};
+}
+
+/// @brief Radians to the default angle unit
+template <typename Node>
+inline Expr<Convert<Node>> fromRadians(const Expr<Node>& e)
+{
+	return {{e.node, detail::angle("rad", FncLib::defaultAngle())}};
+}
+
+template <typename Node>
+inline auto sin(const Expr<Node>& e) { return sinRad(toRadians(e)); }
+
+template <typename Node>
+inline auto cos(const Expr<Node>& e) { return cosRad(toRadians(e)); }
+
+template <typename Node>
+inline auto tan(const Expr<Node>& e) { return tanRad(toRadians(e)); }
+
+template <typename Node>
+inline auto asin(const Expr<Node>& e) { return fromRadians(asinRad(e)); }
+
+template <typename Node>
+inline auto acos(const Expr<Node>& e) { return fromRadians(acosRad(e)); }
+
+template <typename Node>
+inline auto atan(const Expr<Node>& e) { return fromRadians(atanRad(e)); }
+
+} // namespace fnc
@@ -0,0 +1,100 @@
+/// @file
+///
+/// @brief Math of fnc functions on plain numbers - shared by every evaluator.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cmath>
+
+// How the kernels work:
+// Each function of fnc that has double math is one inline function here,
+// for double and float. The functions of the number stack (double values),
+// BlockProgram (columns) and the expressions of fncExpr.h (compiled C++) all
+// call them, so a formula gives the same result however it is run. Integer
+// math, units and formats stay with Num - kernels see plain values; angles
+// are converted before sin() and after asin() (see UnitConversion).
+
+namespace fnc
+{
+namespace kernel
+{
+
+/// @brief x * scale + offset (unit conversion) - two roundings, never fused,
+/// so results do not depend on the CPU or flags a caller is built with
+inline double affine(const double x, const double scale, const double offset)
+{
+	return (x * scale) + offset;
+}
+
+inline float affine(const float x, const float scale, const float offset)
+{
+	return (x * scale) + offset;
+}
+
+// Binary - x is the first operand (left of the function)
+template <typename T> inline T add(const T x, const T y) { return x + y; }
+template <typename T> inline T sub(const T x, const T y) { return x - y; }
+template <typename T> inline T mul(const T x, const T y) { return x * y; }
+template <typename T> inline T div(const T x, const T y) { return x / y; }
+template <typename T> inline T pow(const T x, const T y) { return std::pow(x, y); }
+template <typename T> inline T root(const T x, const T y) { return std::pow(x, T(1) / y); }
+template <typename T> inline T mod(const T x, const T y) { return std::fmod(x, y); }
+template <typename T> inline T max(const T x, const T y) { return std::fmax(x, y); }
+template <typename T> inline T min(const T x, const T y) { return std::fmin(x, y); }
+
+// Comparisons - 1 if true, 0 if false
+template <typename T> inline T lt(const T x, const T y) { return static_cast<T>(x < y); }
+template <typename T> inline T le(const T x, const T y) { return static_cast<T>(x <= y); }
+template <typename T> inline T eq(const T x, const T y) { return static_cast<T>(x == y); }
+template <typename T> inline T ne(const T x, const T y) { return static_cast<T>(x != y); }
+template <typename T> inline T ge(const T x, const T y) { return static_cast<T>(x >= y); }
+template <typename T> inline T gt(const T x, const T y) { return static_cast<T>(x > y); }
+
+// Unary
+template <typename T> inline T sqrt(const T x) { return std::sqrt(x); }
+template <typename T> inline T abs(const T x) { return std::fabs(x); }
+template <typename T> inline T neg(const T x) { return -x; }
+template <typename T> inline T inv(const T x) { return T(1) / x; }
+template <typename T> inline T exp(const T x) { return std::exp(x); }
+template <typename T> inline T exp10(const T x) { return std::pow(T(10), x); }
+template <typename T> inline T exp2(const T x) { return std::pow(T(2), x); }
+template <typename T> inline T ln(const T x) { return std::log(x); }
+template <typename T> inline T log10(const T x) { return std::log10(x); }
+template <typename T> inline T log2(const T x) { return std::log2(x); }
+template <typename T> inline T sin(const T x) { return std::sin(x); }     // Radians
+template <typename T> inline T cos(const T x) { return std::cos(x); }
+template <typename T> inline T tan(const T x) { return std::tan(x); }
+template <typename T> inline T asin(const T x) { return std::asin(x); }   // Radians
+template <typename T> inline T acos(const T x) { return std::acos(x); }
+template <typename T> inline T atan(const T x) { return std::atan(x); }
+template <typename T> inline T sinh(const T x) { return std::sinh(x); }
+template <typename T> inline T cosh(const T x) { return std::cosh(x); }
+template <typename T> inline T tanh(const T x) { return std::tanh(x); }
+template <typename T> inline T asinh(const T x) { return std::asinh(x); }
+template <typename T> inline T acosh(const T x) { return std::acosh(x); }
+template <typename T> inline T atanh(const T x) { return std::atanh(x); }
+template <typename T> inline T ceil(const T x) { return std::ceil(x); }
+template <typename T> inline T floor(const T x) { return std::floor(x); }
+template <typename T> inline T frac(const T x) { T intPart; return std::modf(x, &intPart); }
+
+/// @brief a if cond is not 0 (NaN included), otherwise b
+template <typename T> inline T select(const T cond, const T a, const T b) { return (cond != T(0)) ? a : b; }
+
+} // namespace kernel
+} // namespace fnc
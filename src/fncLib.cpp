@@ -0,0 +1,740 @@
+/// @file
+///
+/// @brief Implementation of libfnc - the fnc evaluator without the command line.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+
+#include "fncLib.h"
+#include "fncConfig.h"
+#include "console.h"
+#include "context.h"
+#include "variableStore.h"
+#include "expressionCache.h"
+#include "evalQueue.h"
+#include "asyncPool.h"
+#include "blockProgram.h"
+#include "configWatcher.h"
+#include "plugins.h"
+#include "program.h"
+#include "numUnit.h"
+
+#define FNC_STRING(x) #x
+#define FNC_VERSION_STRING(major, minor) FNC_STRING(major) "." FNC_STRING(minor)
+
+/// @brief Adds the last diagnostic of a function to a run message
+static void addDetail(std::string& message)
+{
+	const Context& context = Context::current();
+	if (context.exceeded() != FNC_LIMIT_NONE)
+	{
+		message = context.exceededMessage();
+	}
+	else if (!Console::lastLine().empty())
+	{
+		message += " - " + Console::lastLine();
+	}
+}
+
+FncContext::FncContext()
+	: m_context(new Context())
+{
+}
+
+FncContext::~FncContext()
+{
+}
+
+FncContext::FncContext(FncContext&& ref)
+	: m_context(std::move(ref.m_context))
+{
+}
+
+FncContext& FncContext::operator=(FncContext&& ref)
+{
+	m_context = std::move(ref.m_context);
+	return *this;
+}
+
+FncContext FncContext::session() const
+{
+	FncContext session;
+	*session.m_context = m_context->session();
+	return session;
+}
+
+/// @brief Counts compiles - tells programs at a reused address apart (see EvalQueue)
+static std::atomic<uint64_t> s_compiles {0};
+
+FncExpression::FncExpression()
+	: m_serial(0)
+{
+}
+
+FncExpression::~FncExpression()
+{
+}
+
+FncExpression::FncExpression(FncExpression&& ref)
+	: m_program(std::move(ref.m_program))
+	, m_variables(std::move(ref.m_variables))
+	, m_serial(ref.m_serial)
+{
+}
+
+FncExpression& FncExpression::operator=(FncExpression&& ref)
+{
+	m_program = std::move(ref.m_program);
+	m_variables = std::move(ref.m_variables);
+	m_serial = ref.m_serial;
+	return *this;
+}
+
+FncQueue::FncQueue(const unsigned maxWaitUs, const size_t maxBatch)
+	: m_queue(new EvalQueue(std::chrono::microseconds(maxWaitUs), maxBatch))
+{
+}
+
+FncQueue::~FncQueue()
+{
+}
+
+std::future<double> FncQueue::submit(const FncExpression& expression, const double* values)
+{
+	if (!expression.valid())
+	{
+		std::promise<double> failed;
+		failed.set_exception(std::make_exception_ptr(std::runtime_error("Expression is not compiled")));
+		return failed.get_future();
+	}
+	return m_queue->submit(*expression.m_program, expression.m_serial, values);
+}
+
+FncWatcher::FncWatcher(const std::string& iniPath, FncOutput report)
+	: m_watcher(new ConfigWatcher(iniPath, report))
+{
+}
+
+FncWatcher::~FncWatcher()
+{
+}
+
+bool FncWatcher::start(std::string& message)
+{
+	return m_watcher->start(message);
+}
+
+void FncWatcher::stop()
+{
+	m_watcher->stop();
+}
+
+bool FncWatcher::reload(std::string& message)
+{
+	return m_watcher->reload(message);
+}
+
+/// @brief Runs program on double inputs
+static bool runProgram(const Program& program, const double* values, Num& result, std::string& message)
+{
+	std::vector<Num> inputs(program.slots(), Num(0., NUM_DOUBLE));
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		inputs[i].m_dValue = values[i];
+	}
+
+	Console::clearLastLine();
+	if (!program.run(inputs.data(), result, message))
+	{
+		addDetail(message);
+		return false;
+	}
+	return true;
+}
+
+bool FncExpression::evaluate(const double* values, double& result, std::string& message) const
+{
+	if (!valid())
+	{
+		message = "Expression is not compiled";
+		return false;
+	}
+
+	Num no;
+	if (!runProgram(*m_program, values, no, message))
+		return false;
+
+	result = no.asDouble();
+	return true;
+}
+
+bool FncExpression::evaluate(const double* values, std::string& result, std::string& message) const
+{
+	if (!valid())
+	{
+		message = "Expression is not compiled";
+		return false;
+	}
+
+	Num no;
+	if (!runProgram(*m_program, values, no, message))
+		return false;
+
+	result = no.asString();
+	return true;
+}
+
+/// @brief Parses expression into program (not resolved)
+static bool compileProgram(const std::string& expression, Program& program, std::string& message)
+{
+	Console::clearLastLine();
+	if (!ExpressionCache::shared().compile(expression, program, message))
+	{
+		addDetail(message);
+		return false;
+	}
+
+	if (program.empty())
+	{
+		message = "Expression '" + expression + "' has no results";
+		return false;
+	}
+	return true;
+}
+
+/// @brief Runs expression that has no inputs
+static bool evaluateNum(const std::string& expression, Num& result, std::string& message)
+{
+	Program program;
+	if (!compileProgram(expression, program, message) || !program.resolve({}, message))
+		return false;
+	return runProgram(program, nullptr, result, message);
+}
+
+// static
+bool FncLib::evaluate(const std::string& expression, double& result, std::string& message)
+{
+	Num no;
+	if (!evaluateNum(expression, no, message))
+		return false;
+
+	result = no.asDouble();
+	return true;
+}
+
+// static
+bool FncLib::evaluate(const std::string& expression, std::string& result, std::string& message)
+{
+	Num no;
+	if (!evaluateNum(expression, no, message))
+		return false;
+
+	result = no.asString();
+	return true;
+}
+
+/// @brief Rows of an array evaluation split over pool threads
+typedef struct _arrayJob
+{
+	std::atomic<size_t> remaining;  // Chunks not done
+	std::atomic<size_t> failed;
+	FncArrayDone done;
+} ArrayJob;
+
+/// @brief Evaluates rows 'first' to 'last' (not included) - returns rows that failed (NaN)
+static size_t evaluateRows(const Program& program, const double* const* columns, const size_t first,
+	const size_t last, double* results)
+{
+	const size_t slots = program.slots();
+	std::string message;
+	BlockProgram block;
+	bool blocks = block.build(program, message);
+	if (blocks && block.constantResult())
+	{
+		std::fill(results + first, results + last, block.constant().asDouble());
+	}
+	else if (blocks)
+	{
+		std::vector<double> scratch(block.columns() * BLOCK_VALUES);
+		std::vector<const double*> inputs(slots);
+		for (size_t row = first; row < last; row += BLOCK_VALUES)
+		{
+			for (size_t k = 0; k < slots; k++)
+			{
+				inputs[k] = columns[k] + row;
+			}
+			block.run(inputs.data(), std::min(BLOCK_VALUES, last - row), scratch.data(), results + row);
+		}
+	}
+
+	// Rows blocks cannot give exactly (ex. errors - not finite) run alone
+	size_t failed = 0;
+	std::vector<double> values(slots);
+	for (size_t row = first; row < last; row++)
+	{
+		if (blocks && std::isfinite(results[row]))
+			continue;
+
+		for (size_t k = 0; k < slots; k++)
+		{
+			values[k] = columns[k][row];
+		}
+		Num no;
+		if (runProgram(program, values.data(), no, message))
+		{
+			results[row] = no.asDouble();
+		}
+		else
+		{
+			results[row] = NAN;
+			failed++;
+		}
+	}
+	return failed;
+}
+
+/// @brief Completion that sets 'promise' (failures throw std::runtime_error from get())
+static FncDone promiseDone(const std::shared_ptr<std::promise<double> >& promise)
+{
+	return [promise](bool ok, double result, const std::string& message) {
+		if (ok)
+		{
+			promise->set_value(result);
+		}
+		else
+		{
+			promise->set_exception(std::make_exception_ptr(std::runtime_error(message)));
+		}
+	};
+}
+
+FncPool::FncPool(const unsigned threads, const size_t maxQueued)
+	: m_pool(new AsyncPool(threads, maxQueued))
+{
+}
+
+FncPool::~FncPool()
+{
+}
+
+std::future<double> FncPool::submit(const std::string& expression)
+{
+	auto promise = std::make_shared<std::promise<double> >();
+	std::future<double> result = promise->get_future();
+	push(expression, promiseDone(promise), true);
+	return result;
+}
+
+std::future<double> FncPool::submit(const FncExpression& expression, const double* values)
+{
+	auto promise = std::make_shared<std::promise<double> >();
+	std::future<double> result = promise->get_future();
+	push(expression, values, promiseDone(promise), true);
+	return result;
+}
+
+std::future<size_t> FncPool::submit(const FncExpression& expression, const double* const* columns,
+	const size_t rows, double* results)
+{
+	auto promise = std::make_shared<std::promise<size_t> >();
+	std::future<size_t> result = promise->get_future();
+	push(expression, columns, rows, results, [promise](size_t failed) { promise->set_value(failed); }, true);
+	return result;
+}
+
+bool FncPool::trySubmit(const std::string& expression, FncDone done)
+{
+	return push(expression, done, false);
+}
+
+bool FncPool::trySubmit(const FncExpression& expression, const double* values, FncDone done)
+{
+	return push(expression, values, done, false);
+}
+
+bool FncPool::trySubmit(const FncExpression& expression, const double* const* columns,
+	const size_t rows, double* results, FncArrayDone done)
+{
+	return push(expression, columns, rows, results, done, false);
+}
+
+size_t FncPool::queued() const
+{
+	return m_pool->queued();
+}
+
+size_t FncPool::capacity() const
+{
+	return m_pool->capacity();
+}
+
+bool FncPool::push(const std::string& expression, FncDone done, const bool wait)
+{
+	std::vector<AsyncPool::Task> tasks;
+	tasks.push_back([expression, done] {
+		// Session of the worker's context - definitions of the expression do not stay
+		Context session = Context::current().session();
+		Context* previous = Context::bind(&session);
+		double result = NAN;
+		std::string message;
+		bool ok = FncLib::evaluate(expression, result, message);
+		Context::bind(previous);
+		done(ok, result, message);
+	});
+
+	if (!wait)
+		return m_pool->tryPush(tasks);
+
+	m_pool->push(tasks);
+	return true;
+}
+
+bool FncPool::push(const FncExpression& expression, const double* values, FncDone done, const bool wait)
+{
+	if (!expression.valid())
+	{
+		done(false, NAN, "Expression is not compiled");
+		return true;
+	}
+
+	std::vector<double> copy(values, values + expression.m_program->slots());
+	std::vector<AsyncPool::Task> tasks;
+	tasks.push_back([&expression, copy, done] {
+		double result = NAN;
+		std::string message;
+		bool ok = expression.evaluate(copy.data(), result, message);
+		done(ok, result, message);
+	});
+
+	if (!wait)
+		return m_pool->tryPush(tasks);
+
+	m_pool->push(tasks);
+	return true;
+}
+
+bool FncPool::push(const FncExpression& expression, const double* const* columns, const size_t rows,
+	double* results, FncArrayDone done, const bool wait)
+{
+	if (!expression.valid() || (rows == 0))
+	{
+		std::fill(results, results + rows, NAN);
+		done(rows);
+		return true;
+	}
+
+	// One chunk per thread - whole blocks, so only the last one is short
+	const Program* program = expression.m_program.get();
+	size_t blocks = (rows + BLOCK_VALUES - 1) / BLOCK_VALUES;
+	size_t chunks = std::min(blocks, m_pool->threads());
+	size_t chunkRows = ((blocks + chunks - 1) / chunks) * BLOCK_VALUES;
+	auto inputs = std::make_shared<std::vector<const double*> >(columns, columns + program->slots());
+
+	auto job = std::make_shared<ArrayJob>();
+	job->remaining = (rows + chunkRows - 1) / chunkRows;
+	job->failed = 0;
+	job->done = done;
+
+	std::vector<AsyncPool::Task> tasks;
+	for (size_t first = 0; first < rows; first += chunkRows)
+	{
+		size_t last = std::min(first + chunkRows, rows);
+		tasks.push_back([program, inputs, first, last, results, job] {
+			job->failed += evaluateRows(*program, inputs->data(), first, last, results);
+			if (--job->remaining == 0)
+			{
+				job->done(job->failed);
+			}
+		});
+	}
+
+	if (!wait)
+		return m_pool->tryPush(tasks);
+
+	m_pool->push(tasks);
+	return true;
+}
+
+// static
+bool FncLib::compile(const std::string& expression, const std::vector<std::string>& variables,
+	FncExpression& compiled, std::string& message)
+{
+	std::unique_ptr<Program> program(new Program());
+	if (!compileProgram(expression, *program, message))
+		return false;
+
+	std::vector<std::string> inputs = variables.empty() ? program->unsetVariables() : variables;
+
+	if (!program->resolve(inputs, message))
+		return false;
+
+	compiled.m_program = std::move(program);
+	compiled.m_variables = inputs;
+	compiled.m_serial = ++s_compiles;
+	return true;
+}
+
+/// @brief Variable names start with a letter (then letters, digits and '_')
+static bool validName(const std::string& name)
+{
+	if (name.empty() || !isalpha(static_cast<unsigned char>(name[0])))
+		return false;
+
+	for (char c : name)
+	{
+		if (!isalnum(static_cast<unsigned char>(c)) && (c != '_'))
+			return false;
+	}
+	return true;
+}
+
+/// @brief Parses value of a variable (units and format allowed)
+static bool parseValue(const std::string& value, Num& no, std::string& message)
+{
+	CalString text(value);
+	text.trimLeft();
+	if (!no.parse(text, message) || !text.empty())
+	{
+		message = "'" + value + "' is not a number";
+		return false;
+	}
+	return true;
+}
+
+/// @brief Saves number as variable of this thread
+static bool saveVariable(const std::string& name, Num& no, std::string& message)
+{
+	if (!validName(name))
+	{
+		message = "'" + name + "' is not a variable name";
+		return false;
+	}
+
+	// addOrUpdateVariable() returns false for new variables too - check constants first
+	ConstantVars var{"", 0., NUM_DEFAULT, UNIT_NUMBER, ""};
+	int len = -1;
+	if (Num::isVariable(name, len, var) && (len == static_cast<int>(name.size()))
+		&& (var.num_type & NUM_CONSTS))
+	{
+		message = "'" + name + "' is a constant";
+		return false;
+	}
+
+	no.m_varName = name;
+	no.addOrUpdateVariable();
+	return true;
+}
+
+// static
+bool FncLib::setVariable(const std::string& name, const std::string& value, std::string& message)
+{
+	Num no;
+	return parseValue(value, no, message) && saveVariable(name, no, message);
+}
+
+// static
+bool FncLib::setVariable(const std::string& name, const double value, std::string& message)
+{
+	Num no(value, NUM_DOUBLE);
+	return saveVariable(name, no, message);
+}
+
+// static
+bool FncLib::getVariable(const std::string& name, double& value)
+{
+	ConstantVars var{"", 0., NUM_DEFAULT, UNIT_NUMBER, ""};
+	int len = -1;
+	if (!Num::isVariable(name, len, var) || (len != static_cast<int>(name.size())))
+		return false;
+
+	value = Num(var).asDouble();
+	return true;
+}
+
+// static
+bool FncLib::convert(const double value, const std::string& fromUnit, const std::string& toUnit,
+	double& result, std::string& message)
+{
+	// Units as of now - ex. after a reload of the units file
+	Context::current().startEvaluation();
+
+	UnitConversion conv;
+	if (!conv.resolve(fromUnit, toUnit, message))
+		return false;
+
+	result = conv.apply(value);
+	return true;
+}
+
+// static
+bool FncLib::conversion(const std::string& fromUnit, const std::string& toUnit,
+	double& scale, double& offset, std::string& message)
+{
+	Context::current().startEvaluation();
+
+	UnitConversion conv;
+	if (!conv.resolve(fromUnit, toUnit, message))
+		return false;
+
+	scale = conv.scale();
+	offset = conv.offset();
+	return true;
+}
+
+// static
+bool FncLib::loadPlugin(const std::string& path, std::string& message)
+{
+	return Plugins::load(path, message);
+}
+
+// static
+bool FncLib::setDefaultAngle(const std::string& unit)
+{
+	if ((unit != "deg") && (unit != "rad"))
+		return false;
+
+	Context::current().setDefaultAngle(unit);
+	return true;
+}
+
+// static
+std::string FncLib::defaultAngle()
+{
+	// As of now - ex. after the INI file changed it
+	Context::current().startEvaluation();
+	return Context::current().defaultAngle();
+}
+
+// static
+void FncLib::setOutput(FncOutput output)
+{
+	Context::current().setOutput(output);
+}
+
+// static
+void FncLib::setInput(FncInput input)
+{
+	Context::current().setInput(input);
+}
+
+// static
+void FncLib::bind(FncContext* context)
+{
+	Context::bind(context ? context->m_context.get() : nullptr);
+}
+
+// static
+void FncLib::setBudget(const FncBudget& budget)
+{
+	Context::current().setBudget(budget);
+}
+
+// static
+FncLimit FncLib::budgetExceeded()
+{
+	return Context::current().exceeded();
+}
+
+// static
+std::vector<FncCacheEntry> FncLib::cacheStatistics()
+{
+	std::vector<FncCacheEntry> entries;
+	for (auto& it : ExpressionCache::shared().statistics())
+	{
+		entries.push_back(FncCacheEntry{it.expression, it.hits, it.compileNs});
+	}
+	return entries;
+}
+
+// static
+void FncLib::clearCache()
+{
+	ExpressionCache::shared().invalidate();
+}
+
+// static
+void FncLib::share(const FncSharedVariables* shared)
+{
+	Context::current().setShared(shared ? shared->m_store.get() : nullptr);
+}
+
+FncSharedVariables::FncSharedVariables()
+	: m_store(new VariableStore())
+{
+}
+
+FncSharedVariables::~FncSharedVariables()
+{
+}
+
+/// @brief Saves number as shared variable
+static bool shareVariable(VariableStore& store, const std::string& name, Num& no, std::string& message)
+{
+	if (!validName(name))
+	{
+		message = "'" + name + "' is not a variable name";
+		return false;
+	}
+
+	no.m_varName = name;
+	no.setAsVariable();
+	store.set(no.asVariable());
+	return true;
+}
+
+bool FncSharedVariables::set(const std::string& name, const std::string& value, std::string& message)
+{
+	Num no;
+	return parseValue(value, no, message) && shareVariable(*m_store, name, no, message);
+}
+
+bool FncSharedVariables::set(const std::string& name, const double value, std::string& message)
+{
+	Num no(value, NUM_DOUBLE);
+	return shareVariable(*m_store, name, no, message);
+}
+
+bool FncSharedVariables::remove(const std::string& name)
+{
+	return m_store->remove(name);
+}
+
+bool FncSharedVariables::get(const std::string& name, double& value) const
+{
+	ConstantVars var;
+	if (!m_store->find(name, var))
+		return false;
+
+	value = Num(var).asDouble();
+	return true;
+}
+
+uint64_t FncSharedVariables::version() const
+{
+	return m_store->version();
+}
+
+// static
+const char* FncLib::version()
+{
+	return FNC_VERSION_STRING(FNC_VERSION_MAJOR, FNC_VERSION_MINOR);
+}
@@ -0,0 +1,376 @@
+/// @file
+///
+/// @brief Public header of libfnc - the fnc evaluator without the command line.
+///
+/// Expressions are parsed and evaluated with the same rules as the fnc command
+/// (units, formats, variables). Nothing is read from or written to the console:
+/// diagnostics go to an output callback and values of unset variables come
+/// from an input callback (see FncLib::setOutput() and FncLib::setInput()).
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// @brief Receives one line of diagnostics (or interactive results) - no newline
+typedef std::function<void(const std::string& line)> FncOutput;
+
+/// @brief Asks for a line of input (ex. value of an unset variable).
+/// @return false if there is none - the variable stays unset (0)
+typedef std::function<bool(const std::string& prompt, std::string& line)> FncInput;
+
+/// @brief Gets the result of an asynchronous evaluation (on a pool thread - must not throw)
+typedef std::function<void(bool ok, double result, const std::string& message)> FncDone;
+
+/// @brief Gets the number of failed rows (results are NaN) of an array evaluation
+typedef std::function<void(size_t failed)> FncArrayDone;
+
+/// @brief Statistics of an expression in the shared cache (see FncLib::cacheStatistics())
+typedef struct _fncCacheEntry
+{
+	std::string expression;
+	uint64_t    hits;       // Compiles answered by the cache
+	uint64_t    compileNs;  // Time the one real compile took
+} FncCacheEntry;
+
+/// @brief Limit an evaluation ran into (see FncLib::budgetExceeded())
+enum FncLimit
+{
+	FNC_LIMIT_NONE = 0,
+	FNC_LIMIT_OPERATIONS,  // Ran more functions than FncBudget::maxOperations
+	FNC_LIMIT_DEPTH,       // Stack or nesting deeper than FncBudget::maxDepth
+	FNC_LIMIT_TIME,        // Ran longer than FncBudget::maxTimeUs
+	FNC_LIMIT_INPUT        // Needed a value from the user while not interactive
+};
+
+/// @brief Limits of every evaluation of a context (0 - no limit). Contexts
+/// start with only maxDepth set (FNC_DEFAULT_DEPTH).
+typedef struct _fncBudget
+{
+	uint64_t maxOperations;  // Functions run
+	size_t   maxDepth;       // Numbers on the stack, nesting of parentheses
+	uint64_t maxTimeUs;      // Wall time
+	bool     interactive;    // Unset variables may ask the input callback
+} FncBudget;
+
+/// @brief maxDepth of every context until setBudget() - parsing recurses per
+/// parenthesis, so deeper expressions could overflow the stack of a thread
+constexpr size_t FNC_DEFAULT_DEPTH {256};
+
+class Program;
+class Context;
+class EvalQueue;
+class AsyncPool;
+class ConfigWatcher;
+class VariableStore;
+
+/// @brief Variables, settings and callbacks used by evaluations (see FncLib::bind()).
+/// A new context has the constants only and no callbacks.
+class FncContext
+{
+public:
+	FncContext();
+	~FncContext();
+
+	FncContext(FncContext&& ref);
+	FncContext& operator=(FncContext&& ref);
+
+	/// @brief New context with the variables and settings of this one, ex. one
+	/// per user on a context holding site-wide values. Cheap to create and drop:
+	/// variables are shared (frozen - later changes here are not seen) and a
+	/// session keeps only what it assigns.
+	FncContext session() const;
+
+private:
+	friend class FncLib;
+
+	FncContext(const FncContext&) = delete;
+	FncContext& operator=(const FncContext&) = delete;
+
+	std::unique_ptr<Context> m_context;
+};
+
+/// @brief Variables shared by many contexts (ex. calibration constants - see FncLib::share()).
+/// Reading never blocks, even while another thread changes a value: every
+/// change publishes a new version of all values at once.
+class FncSharedVariables
+{
+public:
+	FncSharedVariables();
+	~FncSharedVariables();
+
+	/// @brief Sets variable - 'value' may have units and format (ex. "25F" or "5km")
+	bool set(const std::string& name, const std::string& value, std::string& message);
+
+	/// @brief Sets variable to a plain number
+	bool set(const std::string& name, const double value, std::string& message);
+
+	/// @brief Removes variable - false if there is none
+	bool remove(const std::string& name);
+
+	/// @brief Value of variable
+	bool get(const std::string& name, double& value) const;
+
+	/// @brief Version of the values - +1 per change
+	uint64_t version() const;
+
+private:
+	friend class FncLib;
+
+	FncSharedVariables(const FncSharedVariables&) = delete;
+	FncSharedVariables& operator=(const FncSharedVariables&) = delete;
+
+	std::unique_ptr<VariableStore> m_store;
+};
+
+/// @brief Expression compiled once (see FncLib::compile()) and run many times.
+/// Safe to evaluate from many threads at once - values of other variables are
+/// taken when compiled, the angle unit from the context of the evaluating thread.
+class FncExpression
+{
+public:
+	FncExpression();
+	~FncExpression();
+
+	FncExpression(FncExpression&& ref);
+	FncExpression& operator=(FncExpression&& ref);
+
+	/// @brief Expression was compiled
+	bool valid() const { return m_program != nullptr; }
+
+	/// @brief Variables - values are given to evaluate() in this order
+	const std::vector<std::string>& variables() const { return m_variables; }
+
+	/// @brief Runs expression - 'values' has one value per variable
+	bool evaluate(const double* values, double& result, std::string& message) const;
+
+	/// @brief Same - result is formatted as fnc writes it (units and format kept)
+	bool evaluate(const double* values, std::string& result, std::string& message) const;
+
+private:
+	friend class FncLib;
+	friend class FncQueue;
+	friend class FncPool;
+
+	FncExpression(const FncExpression&) = delete;
+	FncExpression& operator=(const FncExpression&) = delete;
+
+	std::unique_ptr<Program> m_program;
+	std::vector<std::string> m_variables;
+	uint64_t m_serial;
+};
+
+/// @brief Evaluations submitted by many threads, run together: waiting rows of
+/// the same expression are evaluated as columns in one pass. A row waits at
+/// most 'maxWaitUs' microseconds for others (plus the batch before it).
+/// At most 4 * 'maxBatch' rows wait - submit() then waits for room.
+/// Evaluates in a copy of the context that created the queue.
+class FncQueue
+{
+public:
+	/// @param maxWaitUs - longest a row waits for others to join its batch
+	/// @param maxBatch - rows that start a batch without waiting
+	explicit FncQueue(const unsigned maxWaitUs = 50, const size_t maxBatch = 4096);
+
+	/// @brief Evaluates what is queued, then stops
+	~FncQueue();
+
+	/// @brief Queues evaluation - 'values' has one value per variable (copied).
+	/// 'expression' must live until the result is ready; a failed evaluation
+	/// throws std::runtime_error (with the message) from get().
+	std::future<double> submit(const FncExpression& expression, const double* values);
+
+private:
+	FncQueue(const FncQueue&) = delete;
+	FncQueue& operator=(const FncQueue&) = delete;
+
+	std::unique_ptr<EvalQueue> m_queue;
+};
+
+/// @brief Evaluations run asynchronously by a pool of threads. A call
+/// returns at once (or waits for room) and the result comes through a
+/// std::future or a callback - ex. to resume a coroutine or an event loop.
+/// At most 'maxQueued' evaluations wait: submit() then waits, trySubmit()
+/// returns false, so callers can slow down (queued() tells how full it is).
+/// Evaluations run on copies of the context that created the pool; an
+/// expression text runs on a fresh session, so definitions do not stay.
+/// Expressions and arrays must live until their result is ready.
+class FncPool
+{
+public:
+	/// @param threads - worker threads (0 uses all cores)
+	/// @param maxQueued - evaluations waiting at most (at least one per thread)
+	explicit FncPool(const unsigned threads = 0, const size_t maxQueued = 1024);
+
+	/// @brief Finishes what is queued, then stops
+	~FncPool();
+
+	/// @brief Evaluates expression text - a failure throws std::runtime_error from get()
+	std::future<double> submit(const std::string& expression);
+
+	/// @brief Evaluates compiled expression - 'values' has one value per variable (copied)
+	std::future<double> submit(const FncExpression& expression, const double* values);
+
+	/// @brief Evaluates 'rows' rows - 'columns' has one array per variable.
+	/// Rows are split over the threads; the future gets the number of failed rows.
+	std::future<size_t> submit(const FncExpression& expression, const double* const* columns,
+		const size_t rows, double* results);
+
+	/// @brief Same as submit() - false (nothing queued) if the pool is full
+	bool trySubmit(const std::string& expression, FncDone done);
+
+	bool trySubmit(const FncExpression& expression, const double* values, FncDone done);
+
+	bool trySubmit(const FncExpression& expression, const double* const* columns,
+		const size_t rows, double* results, FncArrayDone done);
+
+	/// @brief Evaluations waiting for a thread
+	size_t queued() const;
+
+	/// @brief Evaluations that may wait
+	size_t capacity() const;
+
+private:
+	FncPool(const FncPool&) = delete;
+	FncPool& operator=(const FncPool&) = delete;
+
+	// Queues evaluations - false if 'wait' is not set and the pool is full
+	bool push(const std::string& expression, FncDone done, const bool wait);
+	bool push(const FncExpression& expression, const double* values, FncDone done, const bool wait);
+	bool push(const FncExpression& expression, const double* const* columns, const size_t rows,
+		double* results, FncArrayDone done, const bool wait);
+
+	std::unique_ptr<AsyncPool> m_pool;
+};
+
+/// @brief Reloads an INI file and the units file it names (key Units.File)
+/// when either changes. Files are read on a watcher thread; evaluations that
+/// start later use the new units, running ones finish on the old. Angle unit
+/// and messages of the INI apply to the fnc command line only.
+class FncWatcher
+{
+public:
+	/// @param report - gets reload and error messages from the watcher thread
+	explicit FncWatcher(const std::string& iniPath, FncOutput report = nullptr);
+
+	/// @brief Stops watching
+	~FncWatcher();
+
+	/// @brief Starts watching - false if files cannot be watched (ex. not Linux)
+	bool start(std::string& message);
+
+	void stop();
+
+	/// @brief Reads the files now - false (settings kept) if they do not parse
+	bool reload(std::string& message);
+
+private:
+	FncWatcher(const FncWatcher&) = delete;
+	FncWatcher& operator=(const FncWatcher&) = delete;
+
+	std::unique_ptr<ConfigWatcher> m_watcher;
+};
+
+// How FncLib works:
+// Variables, settings and callbacks belong to a context. Every thread starts
+// with a context of its own (constants only, no callbacks); bind() makes it
+// use a FncContext instead. Threads on different contexts share nothing and
+// run without locks - a context is used by one thread at a time.
+// Compiled expressions are cached for all threads and contexts (by text), so
+// a hot expression is parsed once per process.
+
+class FncLib
+{
+public:
+	/// @brief Evaluates expression (as a command line argument of fnc).
+	/// Definitions (ex. "x=2") are kept for later expressions of this thread.
+	/// @return false if the expression failed or has no result
+	static bool evaluate(const std::string& expression, double& result, std::string& message);
+
+	/// @brief Same - result is formatted as fnc writes it (units and format kept)
+	static bool evaluate(const std::string& expression, std::string& result, std::string& message);
+
+	/// @brief Compiles expression. 'variables' sets the order of values given to
+	/// FncExpression::evaluate() - empty takes them in the order of the expression.
+	/// Other variables must have values (they are taken now).
+	static bool compile(const std::string& expression, const std::vector<std::string>& variables,
+		FncExpression& compiled, std::string& message);
+
+	/// @brief Sets variable - 'value' may have units and format (ex. "25F" or "5km")
+	static bool setVariable(const std::string& name, const std::string& value, std::string& message);
+
+	/// @brief Sets variable to a plain number
+	static bool setVariable(const std::string& name, const double value, std::string& message);
+
+	/// @brief Value of variable (or constant)
+	static bool getVariable(const std::string& name, double& value);
+
+	/// @brief Converts value between units (ex. "km" to "mi")
+	static bool convert(const double value, const std::string& fromUnit, const std::string& toUnit,
+		double& result, std::string& message);
+
+	/// @brief Conversion between units as scale and offset (result = value * scale + offset)
+	static bool conversion(const std::string& fromUnit, const std::string& toUnit,
+		double& scale, double& offset, std::string& message);
+
+	/// @brief Loads plugin (shared object) - its functions can be used in all
+	/// expressions compiled after (see fncPlugin.h). Loading it again does nothing.
+	static bool loadPlugin(const std::string& path, std::string& message);
+
+	/// @brief Unit of angles without units - "deg" (default) or "rad"
+	static bool setDefaultAngle(const std::string& unit);
+
+	/// @brief Unit of angles without units of the calling thread
+	static std::string defaultAngle();
+
+	/// @brief Where diagnostics go - none (default) drops them
+	static void setOutput(FncOutput output);
+
+	/// @brief Where values of unset variables come from - none (default) leaves them unset
+	static void setInput(FncInput input);
+
+	/// @brief Limits of each evaluation on the context of the calling thread.
+	/// An evaluation over budget stops and fails with a "Budget exceeded" message.
+	static void setBudget(const FncBudget& budget);
+
+	/// @brief Limit the last evaluation of the calling thread ran into
+	static FncLimit budgetExceeded();
+
+	/// @brief Calling thread uses 'context' (nullptr - its own context again).
+	/// All other functions work on the context of the calling thread.
+	static void bind(FncContext* context);
+
+	/// @brief Context of the calling thread also reads 'shared' (nullptr - stops).
+	/// Its own variables come first. Values are taken when an expression is
+	/// compiled (or evaluated by evaluate()). 'shared' must outlive its use.
+	static void share(const FncSharedVariables* shared);
+
+	/// @brief Statistics of the expressions in the shared compile cache
+	static std::vector<FncCacheEntry> cacheStatistics();
+
+	/// @brief Empties the shared compile cache
+	static void clearCache();
+
+	/// @brief Version of the library ("major.minor")
+	static const char* version();
+};
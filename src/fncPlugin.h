@@ -0,0 +1,89 @@
+/// @file
+///
+/// @brief Interface of fnc plugins - shared objects that add functions.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Version of this interface - plugins built for another one are not loaded
+#define FNC_PLUGIN_VERSION 1
+
+/// @brief Most arguments of a plugin function
+#define FNC_PLUGIN_ARGUMENTS 3
+
+/// @brief Units of the result - values are part of the ABI and never change
+typedef enum fnc_plugin_units
+{
+	FNC_UNITS_NONE = 0,   // Plain number - units and format of the arguments are dropped
+	FNC_UNITS_KEEP = 1,   // Units and format of the first argument (ex. abs, floor)
+	FNC_UNITS_ANGLE = 2   // Format of the first argument, no units - it is an angle, given in radians (ex. sinc)
+} fnc_plugin_units;
+
+/// @brief Runs one row - 'args' has 'arity' values
+typedef double (*fnc_scalar_kernel)(const double* args);
+
+/// @brief Runs 'count' rows - 'args' has 'arity' columns of 'count' values.
+/// 'results' never overlaps an argument column.
+typedef void (*fnc_array_kernel)(const double* const* args, size_t count, double* results);
+
+/// @brief Function of a plugin
+typedef struct fnc_plugin_function
+{
+	const char* name;          // Letters, digits and '_' (starts with a letter) - copied
+	unsigned arity;            // 1 to FNC_PLUGIN_ARGUMENTS
+	fnc_plugin_units units;
+	fnc_scalar_kernel scalar;  // Required
+	fnc_array_kernel array;    // NULL - batch mode runs 'scalar' per row
+} fnc_plugin_function;
+
+/// @brief Adds function of the plugin - 0 if added
+typedef int (*fnc_plugin_add)(void* registry, const fnc_plugin_function* function);
+
+// How plugins work:
+// A plugin is a shared object that exports fnc_plugin_init(). fnc loads it
+// (INI key Plugins.Load or FncLib::loadPlugin()) and calls it once; the
+// plugin calls 'add' for each of its functions and returns 0. If any of them
+// is refused (bad name, name of a function fnc has, ...) or it returns
+// another value, nothing of the plugin is added and it is unloaded.
+// A function of arity 1 is used as "name(x)" or "x name", of arity 2 as
+// "x name y" or "name(x, y)", of arity 3 as "name(x, y, z)". Expressions run
+// the scalar kernel per evaluation; batch mode and the array functions of
+// the library run the array kernel on blocks of rows - the same kernels, so
+// both give the same results. Kernels are called from many threads at once.
+// Plugins stay loaded until the process ends.
+//
+//   static double lerp(const double* a) { return a[0] + (a[1] - a[0]) * a[2]; }
+//
+//   int fnc_plugin_init(unsigned version, void* registry, fnc_plugin_add add)
+//   {
+//       fnc_plugin_function f = {"lerp", 3, FNC_UNITS_NONE, lerp, NULL};
+//       return (version == FNC_PLUGIN_VERSION) ? add(registry, &f) : 1;
+//   }
+
+/// @brief Entry point of a plugin - adds its functions, 0 if ok
+int fnc_plugin_init(unsigned version, void* registry, fnc_plugin_add add);
+
+#ifdef __cplusplus
+}
+#endif
@@ -20,7 +20,9 @@
 
 
 #include "func.h"
-#include <iostream>
+#include "program.h"
+#include "console.h"
+#include "context.h"
 #include <string>
 #include <string.h>
 #include <map>
@@ -64,10 +66,35 @@ void Func::init()
 }
 
 
+/// @brief Counts functions nested while parsing (see FncBudget::maxDepth)
+class ParseNesting
+{
+public:
+	ParseNesting() { s_depth++; }
+	~ParseNesting() { s_depth--; }
+
+	static size_t depth() { return s_depth; }
+
+private:
+	static thread_local size_t s_depth;
+};
+
+thread_local size_t ParseNesting::s_depth {0};
+
 bool Func::parse(CalString& eq, std::string& message, bool& bDone)
 {
 	bDone = false;
 
+	// Parentheses and functions inside functions parse recursively
+	ParseNesting nesting;
+	Context& context = Context::current();
+	if ((context.budget().maxDepth != 0) && (ParseNesting::depth() > context.budget().maxDepth))
+	{
+		context.exceed(FNC_LIMIT_DEPTH);
+		message = context.exceededMessage();
+		return false;
+	}
+
 	while (!bDone && !eq.empty())
 	{
 		eq.trimLeft();
@@ -95,7 +122,7 @@ bool Func::parseNumber(CalString& eq, std::string& message, bool& bDone)
 	if (!no.parse(eq, message))
 	{
 		// Error occurred
-		std::cout << "Func::parse(" << eq.c_str() << ") - Errored: " << message << std::endl;
+		Console::print(std::string("Func::parse(") + eq.c_str() + ") - Errored: " + message);
 		return false;
 	}
 
@@ -233,8 +260,9 @@ bool Func::addFunction(Functions& fnType, CalString& eq, std::string& message, b
 		while (!bDone && !eq.empty())
 		{
 			fn.init();
-			int i = fn.parse(eq, message, bDone);
-			if (i < 0)
+			// Each function inside ends - the parameter ends at its closing paren
+			bool fnDone = false;
+			if (!fn.parse(eq, message, fnDone))
 			{
 				return false;
 			}
@@ -247,7 +275,7 @@ bool Func::addFunction(Functions& fnType, CalString& eq, std::string& message, b
 			{
 				// TODO: No ending paren
 				fn.m_state = STATE_ERRORED;
-				std::cout << "No closing parentheses!" << std::endl;
+				Console::print("No closing parentheses!");
 			}
 		}
 		bDone = true;
@@ -298,7 +326,30 @@ bool Func::run(NumStack& initValue)
 
 	ok = m_function.run(initValue);
 
-	return true;
+	// Over budget - stop the rest of the expression
+	return ok || (Context::current().exceeded() == FNC_LIMIT_NONE);
 }
 
+bool Func::compile(Program& program, std::string& message) const
+{
+	for (const auto& it : m_prior)
+	{
+		program.addNumber(it);
+	}
+
+	for (const auto& it : m_subFunctions)
+	{
+		if (!it.compile(program, message))
+			return false;
+	}
 
+	for (const auto& it : m_params)
+	{
+		program.addNumber(it);
+	}
+
+	if (isNop())
+		return true;
+
+	return program.addFunction(m_function.m_function, message);
+}
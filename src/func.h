@@ -30,6 +30,8 @@
 #include <string>
 #include <cmath>
 
+class Program;
+
 // Function states
 enum FunctionState : int8_t
 {
@@ -76,6 +78,9 @@ public:
 
 	bool run(NumStack& initValue);
 
+	/// @brief Flattens function into program steps (in the order of run())
+	bool compile(Program& program, std::string& message) const;
+
 	bool isNop() const { return m_function.isNop(); }
 
 	void pushPrior(const Num& arg);
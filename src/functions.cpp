@@ -22,21 +22,46 @@
 ///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 
-#include <iostream>
 #include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 #include "func.h"
 #include "num.h"
 #include "exec.h"
+#include "rolling.h"
+#include "console.h"
+#include "context.h"
+#include "plugins.h"
+#include "fncKernels.h"
 
-// static
-std::string FunctionType::s_defaultAngle{"deg"};
+/// @brief Buckets of the function index - one per first character
+constexpr size_t FUNCTION_INDEX_SIZE {256};
 
 bool nop(NumStack& params)
 {
 	return true;
 }
 
+/// @brief Integer divisor is 0 - the CPU traps on it, so the function fails
+static bool divisionByZero(const Num& inp1, const char* name)
+{
+	if (inp1.m_lValue != 0)
+		return false;
+
+	Console::print(std::string("Function: '") + name + "' - division by zero");
+	return true;
+}
+
+/// @brief Integer quotient does not fit (INT64_MIN / -1 - traps as well)
+static bool divisionOverflows(const Num& inp0, const Num& inp1)
+{
+	return (inp0.m_lValue == INT64_MIN) && (inp1.m_lValue == -1);
+}
+
 // Binary Functions
 bool add(NumStack& params)
 {
@@ -53,7 +78,7 @@ bool add(NumStack& params)
 	if (result.isDouble())
 	{
 		// return results in double:
-		result.m_dValue = inp0.m_dValue + inp1.m_dValue;
+		result.m_dValue = fnc::kernel::add(inp0.m_dValue, inp1.m_dValue);
 	}
 	else
 	{
@@ -77,7 +102,7 @@ bool sub(NumStack& params)
 	if (result.isDouble())
 	{
 		// return results in double:
-		result.m_dValue = inp0.m_dValue - inp1.m_dValue;
+		result.m_dValue = fnc::kernel::sub(inp0.m_dValue, inp1.m_dValue);
 	}
 	else
 	{
@@ -102,7 +127,7 @@ bool mul(NumStack& params)
 	if (result.isDouble())
 	{
 		// return results in double:
-		result.m_dValue = inp0.m_dValue * inp1.m_dValue;
+		result.m_dValue = fnc::kernel::mul(inp0.m_dValue, inp1.m_dValue);
 	}
 	else
 	{
@@ -126,13 +151,17 @@ bool div(NumStack& params)
 	if (result.isDouble())
 	{
 		// return results in double:
-		result.m_dValue = inp0.m_dValue / inp1.m_dValue;
+		result.m_dValue = fnc::kernel::div(inp0.m_dValue, inp1.m_dValue);
 	}
 	else
 	{
 		// Assume integer math
-		int64_t rem = inp0.m_lValue % inp1.m_lValue;
-		if (rem == 0)
+		if (divisionByZero(inp1, "/"))
+		{
+			return false;
+		}
+
+		if (!divisionOverflows(inp0, inp1) && ((inp0.m_lValue % inp1.m_lValue) == 0))
 		{
 			result.m_lValue = inp0.m_lValue / inp1.m_lValue;
 		}
@@ -159,13 +188,13 @@ bool pow(NumStack& params)
     inp0.convertTo(NUM_DOUBLE);
     inp1.convertTo(NUM_DOUBLE);
     result.convertTo(NUM_DOUBLE);
-    result.m_dValue = pow(inp0.m_dValue, inp1.m_dValue);
+    result.m_dValue = fnc::kernel::pow(inp0.m_dValue, inp1.m_dValue);
 #else
 	FunctionType::convertUnits(result, inp0, inp1);
 	if (result.isDouble())
 	{
 		// return results in double:
-		result.m_dValue = pow(inp0.m_dValue, inp1.m_dValue);
+		result.m_dValue = fnc::kernel::pow(inp0.m_dValue, inp1.m_dValue);
 	}
 	else
 	{
@@ -192,7 +221,7 @@ bool max(NumStack& params)
 	if (result.isDouble())
 	{
 		// return results in double:
-		result.m_dValue = fmax(inp0.m_dValue, inp1.m_dValue);
+		result.m_dValue = fnc::kernel::max(inp1.m_dValue, inp0.m_dValue);
 	}
 	else
 	{
@@ -216,7 +245,7 @@ bool min(NumStack& params)
 	if (result.isDouble())
 	{
 		// return results in double:
-		result.m_dValue = fmin(inp0.m_dValue, inp1.m_dValue);
+		result.m_dValue = fnc::kernel::min(inp1.m_dValue, inp0.m_dValue);
 	}
 	else
 	{
@@ -242,7 +271,7 @@ bool root(NumStack& params)
 
 	// return results in double:
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = pow(inp0.m_dValue, (1./inp1.m_dValue));
+	result.m_dValue = fnc::kernel::root(inp0.m_dValue, inp1.m_dValue);
 
 	params.push_back(result);
 	return true;
@@ -261,12 +290,16 @@ bool mod(NumStack& params)
 	if (result.isDouble())
 	{
 		// return results in double:
-		result.m_dValue = fmod(inp0.m_dValue, inp1.m_dValue);
+		result.m_dValue = fnc::kernel::mod(inp0.m_dValue, inp1.m_dValue);
 	}
 	else
 	{
 		// Assume integer math
-		result.m_lValue = inp0.m_lValue % inp1.m_lValue;
+		if (divisionByZero(inp1, "%"))
+		{
+			return false;
+		}
+		result.m_lValue = divisionOverflows(inp0, inp1) ? 0 : (inp0.m_lValue % inp1.m_lValue);
 	}
 	params.push_back(result);
 	return true;
@@ -277,7 +310,7 @@ bool sqrt(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = sqrt(result.m_dValue);
+	result.m_dValue = fnc::kernel::sqrt(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -292,7 +325,7 @@ bool abs(NumStack& params)
 	}
 	else if (result.isDouble())
 	{
-		result.m_dValue = fabs(result.m_dValue);
+		result.m_dValue = fnc::kernel::abs(result.m_dValue);
 	}
 	params.push_back(result);
 	return true;
@@ -308,7 +341,7 @@ bool neg(NumStack& params)
 	}
 	else if (result.isDouble())
 	{
-		result.m_dValue = -result.m_dValue;
+		result.m_dValue = fnc::kernel::neg(result.m_dValue);
 	}
 	params.push_back(result);
 	return true;
@@ -319,7 +352,7 @@ bool inv(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = 1 / result.m_dValue;
+	result.m_dValue = fnc::kernel::inv(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -329,7 +362,7 @@ bool exp(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = exp(result.m_dValue);
+	result.m_dValue = fnc::kernel::exp(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -339,7 +372,7 @@ bool exp10(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = pow(10., result.m_dValue);
+	result.m_dValue = fnc::kernel::exp10(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -354,7 +387,7 @@ bool exp2(NumStack& params)
 	}
 	else if (result.isDouble())
 	{
-		result.m_dValue = pow(2., result.m_dValue);
+		result.m_dValue = fnc::kernel::exp2(result.m_dValue);
 	}
 	params.push_back(result);
 	return true;
@@ -365,7 +398,7 @@ bool ln(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = log(result.m_dValue);
+	result.m_dValue = fnc::kernel::ln(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -375,7 +408,7 @@ bool log10(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = log10(result.m_dValue);
+	result.m_dValue = fnc::kernel::log10(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -385,7 +418,7 @@ bool log2(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = log2(result.m_dValue);
+	result.m_dValue = fnc::kernel::log2(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -396,7 +429,7 @@ bool sin(NumStack& params)
 	params.pop_back();
 	result.convertToRads();
 
-	result.m_dValue = sin(result.m_dValue);
+	result.m_dValue = fnc::kernel::sin(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -407,7 +440,7 @@ bool cos(NumStack& params)
 	params.pop_back();
 	result.convertToRads();
 
-	result.m_dValue = cos(result.m_dValue);
+	result.m_dValue = fnc::kernel::cos(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -418,7 +451,7 @@ bool tan(NumStack& params)
 	params.pop_back();
 	result.convertToRads();
 
-	result.m_dValue = tan(result.m_dValue);
+	result.m_dValue = fnc::kernel::tan(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -428,7 +461,7 @@ bool asin(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = asin(result.m_dValue);
+	result.m_dValue = fnc::kernel::asin(result.m_dValue);
 	result.convertFromRads();
 	params.push_back(result);
 	return true;
@@ -439,7 +472,7 @@ bool acos(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = acos(result.m_dValue);
+	result.m_dValue = fnc::kernel::acos(result.m_dValue);
 	result.convertFromRads();
 	params.push_back(result);
 	return true;
@@ -450,7 +483,7 @@ bool atan(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = atan(result.m_dValue);
+	result.m_dValue = fnc::kernel::atan(result.m_dValue);
 	result.convertFromRads();
 	params.push_back(result);
 	return true;
@@ -461,7 +494,7 @@ bool sinh(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = sinh(result.m_dValue);
+	result.m_dValue = fnc::kernel::sinh(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -471,7 +504,7 @@ bool cosh(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = cosh(result.m_dValue);
+	result.m_dValue = fnc::kernel::cosh(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -481,7 +514,7 @@ bool tanh(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = tanh(result.m_dValue);
+	result.m_dValue = fnc::kernel::tanh(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -491,7 +524,7 @@ bool asinh(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = asinh(result.m_dValue);
+	result.m_dValue = fnc::kernel::asinh(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -501,7 +534,7 @@ bool acosh(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = acosh(result.m_dValue);
+	result.m_dValue = fnc::kernel::acosh(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -511,7 +544,7 @@ bool atanh(NumStack& params)
 	Num result = params.back();
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = atanh(result.m_dValue);
+	result.m_dValue = fnc::kernel::atanh(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -524,7 +557,7 @@ bool ceil(NumStack& params)
 
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = ceil(result.m_dValue);
+	result.m_dValue = fnc::kernel::ceil(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -537,7 +570,7 @@ bool floor(NumStack& params)
 
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	result.m_dValue = floor(result.m_dValue);
+	result.m_dValue = fnc::kernel::floor(result.m_dValue);
 	params.push_back(result);
 	return true;
 }
@@ -550,13 +583,183 @@ bool frac(NumStack& params)
 
 	params.pop_back();
 	result.convertTo(NUM_DOUBLE);
-	double intPart;
-	result.m_dValue = modf(result.m_dValue, &intPart);
+	result.m_dValue = fnc::kernel::frac(result.m_dValue);
 	params.push_back(result);
 	return true;
 
 }
 
+// Rolling (stream mode) functions
+static bool rolling(NumStack& params, const RollingKind kind, const char* name)
+{
+	Num inp1 = params.back();
+	params.pop_back();
+	Num result = params.back();
+	params.pop_back();
+
+	RollingState* state = RollingState::current();
+	if (state == nullptr)
+	{
+		Console::print(std::string("Function: '") + name + "' - runs only in stream mode");
+		return false;
+	}
+
+	inp1.convertTo(NUM_DOUBLE);
+	double param = inp1.m_dValue;
+	if (kind == ROLL_EMA)
+	{
+		if (!(param > 0.) || (param > 1.))
+		{
+			Console::print(std::string("Function: '") + name + "' - alpha must be over 0 and up to 1");
+			return false;
+		}
+	}
+	else
+	{
+		param = floor(param);
+		if (!(param >= 1.) || (param > 1e9))
+		{
+			Console::print(std::string("Function: '") + name + "' - window must be 1 or more values");
+			return false;
+		}
+	}
+
+	// Keeps units and format of the values
+	result.convertTo(NUM_DOUBLE);
+	result.m_dValue = state->next(kind, param).update(result.m_dValue);
+	params.push_back(result);
+	return true;
+}
+
+bool sma(NumStack& params)
+{
+	return rolling(params, ROLL_SMA, "sma");
+}
+
+bool ema(NumStack& params)
+{
+	return rolling(params, ROLL_EMA, "ema");
+}
+
+bool rmin(NumStack& params)
+{
+	return rolling(params, ROLL_MIN, "rmin");
+}
+
+bool rmax(NumStack& params)
+{
+	return rolling(params, ROLL_MAX, "rmax");
+}
+
+bool delta(NumStack& params)
+{
+	RollingState* state = RollingState::current();
+	if (state == nullptr)
+	{
+		Console::print("Function: 'delta' - runs only in stream mode");
+		return false;
+	}
+
+	Num result = params.back();
+	params.pop_back();
+	result.convertTo(NUM_DOUBLE);
+	result.m_dValue = state->next(ROLL_DELTA, 0.).update(result.m_dValue);
+	params.push_back(result);
+	return true;
+}
+
+/// @brief Compares values of the same type
+template <typename T>
+static bool compareValues(const FunctionValue type, const T x, const T y)
+{
+	switch (type)
+	{
+	case F_LT: return x < y;
+	case F_LE: return x <= y;
+	case F_EQ: return x == y;
+	case F_NE: return x != y;
+	case F_GE: return x >= y;
+	default:   return x > y;
+	}
+}
+
+/// @brief Comparison kernels - result is integer 1 (true) or 0 (false)
+static bool compare(NumStack& params, const FunctionValue type)
+{
+	Num result;
+	Num inp1 = params.back();
+	params.pop_back();
+	Num inp0 = params.back();
+	params.pop_back();
+
+	FunctionType::convertUnits(result, inp0, inp1);
+
+	bool flag = result.isDouble() ? compareValues(type, inp0.m_dValue, inp1.m_dValue)
+		: compareValues(type, inp0.m_lValue, inp1.m_lValue);
+
+	result.setInteger();
+	result.m_lValue = flag ? 1 : 0;
+	params.push_back(result);
+	return true;
+}
+
+bool lt(NumStack& params)
+{
+	return compare(params, F_LT);
+}
+
+bool le(NumStack& params)
+{
+	return compare(params, F_LE);
+}
+
+bool eq(NumStack& params)
+{
+	return compare(params, F_EQ);
+}
+
+bool ne(NumStack& params)
+{
+	return compare(params, F_NE);
+}
+
+bool ge(NumStack& params)
+{
+	return compare(params, F_GE);
+}
+
+bool gt(NumStack& params)
+{
+	return compare(params, F_GT);
+}
+
+bool push(NumStack& params)
+{
+	// Number stays as the next argument
+	return !params.empty();
+}
+
+bool select(NumStack& params)
+{
+	if (params.size() < 3)
+	{
+		Console::print("Function: 'select' - needs three parameters: select(cond, a, b)");
+		return false;
+	}
+
+	Num inp2 = params.back();
+	params.pop_back();
+	Num inp1 = params.back();
+	params.pop_back();
+	Num cond = params.back();
+	params.pop_back();
+
+	// Any number but 0 is true (NaN included)
+	bool flag = cond.isInteger() ? (cond.m_lValue != 0) : (cond.m_dValue != 0.);
+	params.push_back(flag ? inp1 : inp2);
+	return true;
+}
+
 bool convert(NumStack& params)
 {
 	// Second param - convert to number unit/format
@@ -567,8 +770,8 @@ bool convert(NumStack& params)
 
 	if (!inp0.convertUnitTo(inp1))
 	{
-		std::cout << "Conversion from " << inp0.asString()
-			<< " to " << inp1.asString() << " <= not implemented yet" << std::endl;
+		Console::print("Conversion from " + inp0.asString()
+			+ " to " + inp1.asString() + " <= not implemented yet");
 		return false;
 	}
 
@@ -587,7 +790,7 @@ bool assign(NumStack& params)
     // If Variable name is not set, keep in stack
     if (!inp1.isVar() || (inp1.varName().isNumber()))
     {
-        std::cout << "! Assignment (=) into a non-variable cannot be executed!" << std::endl;
+        Console::print("! Assignment (=) into a non-variable cannot be executed!");
         return false;
     }
 
@@ -620,10 +823,20 @@ std::vector<Functions> s_functions
 	{"%",    F_MOD,  MODE_BINARY, mod},
 	{"max",  F_MAX,  MODE_BINARY, max},
 	{"min",  F_MIN,  MODE_BINARY, min},
+	{"sma",  F_SMA,  MODE_BINARY, sma},    // Moving average: x sma N (stream mode)
+	{"ema",  F_EMA,  MODE_BINARY, ema},    // Exponential moving average: x ema alpha
+	{"rmin", F_RMIN, MODE_BINARY, rmin},   // Rolling minimum: x rmin N
+	{"rmax", F_RMAX, MODE_BINARY, rmax},   // Rolling maximum: x rmax N
+	{"<=",   F_LE,   MODE_BINARY, le},     // Comparisons - 1 if true, 0 if false
+	{">=",   F_GE,   MODE_BINARY, ge},
+	{"==",   F_EQ,   MODE_BINARY, eq},
+	{"!=",   F_NE,   MODE_BINARY, ne},
+	{"<",    F_LT,   MODE_BINARY, lt},     // "<[", "<[[" and "<@" are longer - still found
+	{">",    F_GT,   MODE_BINARY, gt},     // Found before '>' of "<@name>" (same length)
 	{"::",   F_CONV, MODE_CONVERT, convert},  // Unary, but second param looks for #-format
 
 	{";",    F_RESULT, MODE_UNARY, clearStack},  // Clear stack (one num)
-	{",",    F_RESULT, MODE_UNARY, nullptr},  // Push onto stack - not yet defined
+	{",",    F_PUSH,   MODE_UNARY, push},     // Keeps number on stack - separates arguments
 
 // Unary
 	{"sqrt", F_SQRT,   MODE_UNARY, sqrt},  // Test 4-char functions before 3-chars
@@ -658,6 +871,8 @@ std::vector<Functions> s_functions
 	{"ceil", F_CEIL,   MODE_UNARY, ceil},
 	{"floor",F_FLOOR,  MODE_UNARY, floor},
 	{"frac", F_FRAC,   MODE_UNARY, frac},
+	{"delta",F_DELTA,  MODE_UNARY, delta},  // Difference from previous value (stream mode)
+	{"select",F_SELECT, MODE_UNARY, select}, // select(cond, a, b) - a if cond is not 0, otherwise b
 
 // Assignment
     {"=",    F_RESULT, MODE_ASSIGN, assign},  // = 0x400, Function used to update or save variable
@@ -674,10 +889,39 @@ std::vector<Functions> s_functions
 	{"<[[", F_MATRIX,    MODE_PARAM, nullptr},
 	{"|", F_BOUND_ABS,   MODE_PARAM, nullptr},
 	{"<@", F_SAVE_MEM_NAME,  MODE_PARAM, nullptr},
-	{">", F_CLOSE_SAVE,  MODE_PARAM_END, nullptr},
+	{">", F_CLOSE_SAVE,  MODE_PARAM_END, nullptr},  // Never found - '>' is a comparison
 
 };
 
+/// @brief Functions by first character - largest first, same length in
+/// the order of the table (findFunc() takes the first match)
+typedef struct _functionIndex
+{
+	std::vector<Functions> first[FUNCTION_INDEX_SIZE];
+} FunctionIndex;
+
+static const FunctionIndex* buildIndex(const std::vector<Functions>& functions)
+{
+	FunctionIndex* index = new FunctionIndex;
+	for (const auto& it : functions)
+	{
+		index->first[static_cast<unsigned char>(it.str[0])].push_back(it);
+	}
+	for (auto& it : index->first)
+	{
+		std::stable_sort(it.begin(), it.end(),
+			[](const Functions& a, const Functions& b) { return a.str.size() > b.str.size(); });
+	}
+	return index;
+}
+
+/// @brief Index findFunc() reads - built-ins, then plugins as they are added
+static std::atomic<const FunctionIndex*>& functionIndex()
+{
+	static std::atomic<const FunctionIndex*> s_index {buildIndex(s_functions)};
+	return s_index;
+}
+
 FunctionType::FunctionType()
 	: m_function{"", F_NOP, MODE_NORMAL, nop}
 {
@@ -699,17 +943,20 @@ bool FunctionType::run(NumStack& params)
 	if (m_function.f == nullptr)
 	{
 		// Keep input as results in stack
-		std::cout << "Function: '" << m_function.str.c_str() << "' - not implemented, yet" << std::endl;
+		Console::print(std::string("Function: '") + m_function.str.c_str() + "' - not implemented, yet");
 		return false;
 	}
 
 	size_t len = params.size();
 
+	if (!Context::current().spend(len))
+		return false;
+
 	if (!(m_function.type == F_NOP))
 	{
 		if (params.empty())
 		{
-			std::cout << "Function: '" << m_function.str.c_str() << "' - has no arguments" << std::endl;
+			Console::print(std::string("Function: '") + m_function.str.c_str() + "' - has no arguments");
 			return false;
 		}
 
@@ -718,7 +965,7 @@ bool FunctionType::run(NumStack& params)
 			// Assignment function requires last number to be a variable
 			if ((len < 2) && !params.back().isVar())
 			{
-				std::cout << "Assignment Function: '" << m_function.str.c_str() << "' - missing variable" << std::endl;
+				Console::print(std::string("Assignment Function: '") + m_function.str.c_str() + "' - missing variable");
 				return false;
 			}
 		}
@@ -732,7 +979,7 @@ bool FunctionType::run(NumStack& params)
 		{
 			if (len < 2)
 			{
-				std::cout << "Binary Function: '" << m_function.str.c_str() << "' - missing second parameter" << std::endl;
+				Console::print(std::string("Binary Function: '") + m_function.str.c_str() + "' - missing second parameter");
 				return false;
 			}
 
@@ -766,17 +1013,17 @@ int FunctionType::findFunc(const CalString& str, int& pos, Functions& fx)
 {
 	// Did not find function - assume function was not found
 	pos = -1;
-	for(auto it : s_functions)
+	const char* text = str.c_str();
+	const FunctionIndex* index = functionIndex().load(std::memory_order_acquire);
+	for (const auto& it : index->first[static_cast<unsigned char>(text[0])])
 	{
+		// Largest functions come first - the first match is the largest
 		int len = it.str.size();
-		if( strncmp(str.c_str(), it.str.c_str(), len) == 0)
+		if (strncmp(text, it.str.c_str(), len) == 0)
 		{
-			// Finds the largest function in the list
-			if (len > pos)
-			{
-				fx = it;
-				pos = len;
-			}
+			fx = it;
+			pos = len;
+			break;
 		}
 	}
 
@@ -786,20 +1033,52 @@ int FunctionType::findFunc(const CalString& str, int& pos, Functions& fx)
 // static
 bool FunctionType::getFunc(const FunctionValue type, Functions& func)
 {
-	for(auto it : s_functions)
+	for (const auto& it : s_functions)
 	{
-		if( it.type == type)
+		if (it.type == type)
 		{
 			func = it;
 			return true;
 		}
 	}
-	return false;
+
+	if (!Plugins::isPlugin(type))
+		return false;
+
+	// Plugin functions are only in the index
+	int pos = -1;
+	return findFunc(Plugins::function(type).name, pos, func) && (func.type == type);
+}
+
+// static
+void FunctionType::addFunctions(const std::vector<Functions>& functions)
+{
+	static std::mutex s_adding;
+	static std::vector<std::unique_ptr<const FunctionIndex>> s_replaced;
+	std::lock_guard<std::mutex> lock(s_adding);
+
+	const FunctionIndex* index = functionIndex().load();
+	std::vector<Functions> all;
+	for (const auto& bucket : index->first)
+	{
+		all.insert(all.end(), bucket.begin(), bucket.end());
+	}
+	all.insert(all.end(), functions.begin(), functions.end());
+
+	// Parsers may still read the old index - it is kept (one per load)
+	functionIndex().store(buildIndex(all), std::memory_order_release);
+	s_replaced.emplace_back(index);
 }
 
 
 // static
 bool FunctionType::isDefaultRad()
 {
-	return s_defaultAngle == "rad";
+	return Context::current().defaultAngle() == "rad";
+}
+
+// static
+void FunctionType::setDefaultAngleRad(bool rad)
+{
+	Context::current().setDefaultAngle(rad ? "rad" : "deg");
 }
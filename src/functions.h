@@ -24,6 +24,7 @@
 
 #include <stddef.h>
 #include <string>
+#include <vector>
 #include "num.h"
 
 enum FunctionMode : uint32_t
@@ -52,6 +53,16 @@ enum FunctionValue : uint32_t
 	F_MOD,
 	F_MAX,
 	F_MIN,
+	F_SMA,    // Rolling (stream mode) - x sma N, x ema alpha, ...
+	F_EMA,
+	F_RMIN,
+	F_RMAX,
+	F_LT,     // Comparisons - 1 if true, 0 if false
+	F_LE,
+	F_EQ,
+	F_NE,
+	F_GE,
+	F_GT,
 
 // Unary
 	F_RESULT   = MODE_UNARY,
@@ -80,6 +91,9 @@ enum FunctionValue : uint32_t
 	F_CEIL,
 	F_FLOOR,
 	F_FRAC,		// Fractional part
+	F_DELTA,    // Difference from previous value (stream mode)
+	F_PUSH,     // Keeps number on stack (',' between arguments)
+	F_SELECT,   // select(cond, a, b) - takes three numbers
 
 // Binary conversion
 	F_CONV,
@@ -96,6 +110,9 @@ enum FunctionValue : uint32_t
 	F_CLOSE_PAREN = MODE_PARAM_END,
 	F_CLOSE_KEY,
 	F_CLOSE_SAVE,
+
+// Loaded from plugins - F_PLUGIN + index (see plugins.h)
+	F_PLUGIN = 0x1000,
 };
 
 using Functions = struct _funcs
@@ -152,15 +169,14 @@ public:
 
 	static bool getFunc(const FunctionValue type, Functions& func);
 
+	/// @brief Adds functions to the ones findFunc() finds (names must be new)
+	static void addFunctions(const std::vector<Functions>& functions);
+
 	/// @brief Used to verify that non-angle computation reverts to radians
 	static bool isDefaultRad();
 
-	/// @brief Default angle used for transcendental
-	static void setDefaultAngleRad(bool rad = true) { s_defaultAngle = rad?"rad":"deg";}
-
-	/// @brief Transcendental computation default angle.
-	/// Used to check default numeric computation (as comiled, should be degrees)
-	static std::string s_defaultAngle;
+	/// @brief Default angle used for transcendental (setting of the context)
+	static void setDefaultAngleRad(bool rad = true);
 
 };
 
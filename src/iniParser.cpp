@@ -1,5 +1,4 @@
 
-#include <iostream>
 #include <exception>
 #include <sys/stat.h>
 
@@ -25,9 +24,9 @@
 
 #include "exec.h"
 #include "functions.h"
+#include "console.h"
+#include "context.h"
 
-// static
-bool IniParser::s_forceUseIni = true;
 // static
 std::string IniParser::m_defaultPath;
 // static
@@ -45,9 +44,9 @@ IniParser::IniParser(std::string& iniFile)
 	}
 	else
 	{
-		std::cout << "! INI parser cannot open empty file name" << std::endl;
+		Console::print("! INI parser cannot open empty file name");
 		// Cannot open empty file
-		s_forceUseIni = false;
+		Context::current().m_forceUseIni = false;
 	}
 }
 
@@ -65,6 +64,11 @@ bool IniParser::exists() const
 	return exists(m_iniFile);
 }
 
+bool IniParser::has(const std::string& key_name) const
+{
+	return m_fileWasRead && m_pt.get_optional<std::string>(key_name);
+}
+
 static std::string homeDir()
 {
 #ifdef _MSC_VER
@@ -199,20 +203,20 @@ bool IniParser::pathExists(const std::string& path, const bool constructPath)
 		 	if (stat(tmp.c_str(), &status) == 0)
 			 {
 				 // Skip
-				 std::cout << "'" << tmp << "' - exists, moving on" << std::endl;
+				 Console::print(std::string("'") + tmp + "' - exists, moving on");
 			 }
 			 else
 			 {
 				 int check = mkdir(tmp.c_str(), 0777);
 				 if (check < 0)
 				 {
-					 std::cout << "!Error creating '" << tmp << "' - returned " << check << std::endl;
+					 Console::print(std::string("!Error creating '") + tmp + "' - returned " + std::to_string(check));
 					 itsThere = false;
 					 break;
 				 }
 				 else
 				 {
-					 std::cout << "Created '" << tmp << "' directory" << std::endl;
+					 Console::print(std::string("Created '") + tmp + "' directory");
 					 itsThere = true;
 				 }
 			 }
@@ -249,7 +253,7 @@ int IniParser::getInt(const std::string& key_name, const int defValue)
 		}
 		catch(std::exception& e)
 		{
-			std::cout << e.what() << std::endl;
+			Console::print(e.what());
 		}
 	}
 	return value;
@@ -266,7 +270,7 @@ std::string IniParser::getString(const std::string& key_name, const char* defVal
 		}
 		catch(std::exception& e)
 		{
-			std::cout << e.what() << std::endl;
+			Console::print(e.what());
 		}
 	}
 	return value;
@@ -284,7 +288,7 @@ double IniParser::getFloat(const std::string& key_name, const double defValue)
 		}
 		catch(std::exception& e)
 		{
-			std::cout << e.what() << std::endl;
+			Console::print(e.what());
 			value = defValue;
 		}
 	}
@@ -305,7 +309,7 @@ bool IniParser::getBool(const std::string& key_name, const bool defValue)
 		}
 		catch(std::exception& e)
 		{
-			std::cout << e.what() << std::endl;
+			Console::print(e.what());
 		}
 	}
 	return value;
@@ -369,33 +373,32 @@ bool IniParser::openIni()
 		}
 		catch(std::exception& e)
 		{
-			std::cout << e.what() << std::endl;
-			std::cout << "Using file: '" << m_iniFile << "' -- exception caught at contructor" << std::endl;
+			Console::print(e.what());
+			Console::print(std::string("Using file: '") + m_iniFile + "' -- exception caught at contructor");
 			m_fileWasRead = false;
 		}
 	}
 	else
 	{
-		std::cout << "INI file '" << m_iniFile << "' - not found." << std::endl;
+		Console::print("INI file '" + m_iniFile + "' - not found.");
 		m_fileWasRead = false;
 
-		if (s_forceUseIni)
+		if (Context::current().m_forceUseIni)
 		{
 			if (pathExists(m_defaultPath, true))
 			{
 #ifdef DEFINE_APP
-				std::cout << " Writing default.";
+				Console::print(" Writing default.");
 				ok = write();
 #else
-				std::cout << " Writing empty .";
+				Console::print(" Writing empty .");
 #endif
 				ok = true;
 			}
 			else
 			{
-				std::cout << "! Cannot create path '" << m_defaultPath << "' !" << std::endl;
+				Console::print(std::string("! Cannot create path '") + m_defaultPath + "' !");
 			}
-			std::cout << std::endl;
 		}
 	}
 	return ok;
@@ -469,7 +472,7 @@ bool IniParser::createPath(const std::string& path)
 		if (stat(tmp.c_str(), &status) == 0)
 			{
 				// Skip
-				std::cout << "'" << tmp << "' - exists, moving on" << std::endl;
+				Console::print(std::string("'") + tmp + "' - exists, moving on");
 			}
 			else
 			{
@@ -480,13 +483,13 @@ bool IniParser::createPath(const std::string& path)
 #endif
 				if (check < 0)
 				{
-					std::cout << "!Error creating '" << tmp << "' - returned " << check << std::endl;
+					Console::print(std::string("!Error creating '") + tmp + "' - returned " + std::to_string(check));
 					itsThere = false;
 					break;
 				}
 				else
 				{
-					std::cout << "Created '" << tmp << "' directory" << std::endl;
+					Console::print(std::string("Created '") + tmp + "' directory");
 					itsThere = true;
 				}
 			}
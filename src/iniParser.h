@@ -20,6 +20,12 @@ public:
 	/// @brief Checks if INI exists
 	bool exists() const;
 
+	/// @brief INI file was read (it exists and parsed)
+	bool wasRead() const { return m_fileWasRead; }
+
+	/// @brief Checks if key is in the INI file (optional keys - no message if not)
+	bool has(const std::string& key_name) const;
+
 #ifdef DEFINE_APP
 	/// @brief Applies INI file to settings.
 	/// NOTE: This was a base class where "apply" is a derived class. For
@@ -64,9 +70,6 @@ public:
 	/// @brief Checks file exists - fstat.h in come cases
 	static bool exists(const std::string& fileName);
 
-	/// @brief Forces writing default INI file (if true) if none found
-	static bool s_forceUseIni;
-
 private:
 	/// @brief Creates paths one at a time
 	static bool createPath(const std::string& path);
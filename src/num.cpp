@@ -21,29 +21,77 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 
-#include <iostream>
 
 #include <string>
 
 #include <cstdlib>
+#include <string.h>
 
 #include "num.h"
 #include "func.h"
-#include "exec.h"
+#include "console.h"
+#include "context.h"
 
 #include "numUnit.h"
+#include "numScan.h"
 
-#include <boost/math/constants/constants.hpp>
+/// @brief Size of formatted number (longer results are cut)
+constexpr size_t FORMAT_BUFFER_SIZE {1024};
 
-/// @brief PI used as a constant.
-// From: https://stackoverflow.com/questions/14954066/does-the-c-standard-library-define-pi
-// long double __pi = boost::math::constants::pi<long double>();
-constexpr double __pi = boost::math::double_constants::pi;
-
-std::vector<ConstantVars> Num::s_constants
+/// @brief Conversion of a user format - the only '%' that is not "%%"
+typedef struct _formatConversion
+{
+	size_t start;    // '%'
+	size_t end;      // After the conversion character
+	std::string spec; // Flags, width and precision (length modifiers dropped)
+	char type;       // d, i, o, u, x, X, e, E, f, F, g, G, a or A
+} FormatConversion;
+
+/// @brief Finds the one numeric conversion of a format - false if it has none,
+/// more than one or another one (ex. "%s", "%n" or '*' would read arguments
+/// the number does not pass)
+static bool findConversion(const std::string& format, FormatConversion& conversion)
 {
-	{"pi", __pi, NUM_DOUBLE | NUM_CONSTS, UNIT_NUMBER, "rad"}
-};
+	bool found = false;
+	for (size_t i = 0; i < format.size(); i++)
+	{
+		if (format[i] != '%')
+			continue;
+		if ((i + 1 < format.size()) && (format[i + 1] == '%'))
+		{
+			i++;
+			continue;
+		}
+		if (found)
+			return false;
+
+		size_t j = i + 1;
+		size_t specStart = j;
+		while ((j < format.size()) && strchr("-+ #0", format[j]))
+			j++;
+		while ((j < format.size()) && isdigit(static_cast<unsigned char>(format[j])))
+			j++;
+		if ((j < format.size()) && (format[j] == '.'))
+		{
+			j++;
+			while ((j < format.size()) && isdigit(static_cast<unsigned char>(format[j])))
+				j++;
+		}
+		size_t specEnd = j;
+		while ((j < format.size()) && strchr("hlLqjzt", format[j]))
+			j++;
+		if ((j >= format.size()) || !strchr("diouxXeEfFgGaA", format[j]))
+			return false;
+
+		conversion.start = i;
+		conversion.end = j + 1;
+		conversion.spec = format.substr(specStart, specEnd - specStart);
+		conversion.type = format[j];
+		found = true;
+		i = j;
+	}
+	return found;
+}
 
 
 Num::Num(const double value,
@@ -132,7 +180,7 @@ bool Num::parse(CalString& eq, std::string& message)
 		{
 			if (!parseNumber(eq, message))
 			{
-				std::cout << "Num::parse() - errored: " << message << std::endl;
+				Console::print(std::string("Num::parse() - errored: ") + message);
 				return false;
 			}
 		}
@@ -186,41 +234,24 @@ bool Num::parseNumber(CalString& eq, std::string& message)
 	}
 
 	int pos = eq.size();
-	int i = 0;
-	int decPt = 0;
-	std::string numb;
 
-	// Local loop done
-	bool done = false;
-
-	// Check for negative number, first
-	if ((eq[0] == '-') && (pos > 1) && isdigit(eq[1]))
-	{
-		numb.push_back('-');
-		eq.left(1);
-		--pos;
-	}
 	// Check for hexidecimal number
-	else if ((eq[0] == '0') && (pos > 2) && (eq[1]=='x'))
+	if ((eq[0] == '0') && (pos > 2) && (eq[1]=='x'))
 	{
-		eq.left(2); // Remove "0x" - expose hex numbers
-		CalString tmp = eq.leftHexOnly();
-		// There is no decimal point, so collect alpha-numerics using CalString check
-		pos = tmp.size();
-
+		ScannedNumber hex;
 		m_varName = "0x";
 
 		// If no hex numbers, parse as number
-		if (pos > 0)
+		if (scanNumber(eq.c_str(), eq.c_str() + pos, SCAN_HEX, hex) && hex.isHex)
 		{
-			char *ptr;
-			m_lValue = strtol(tmp.c_str(), &ptr, 16);
+			m_lValue = hex.intValue;
 			setInteger();
-			eq.left(pos);
-			m_varName += tmp;
+			m_varName.append(eq.c_str() + 2, hex.length - 2);
+			eq.left(hex.length);
 		}
 		else
 		{
+			eq.left(2); // Remove "0x"
 			m_lValue = 0;
 		}
 		// Default formatting
@@ -228,60 +259,33 @@ bool Num::parseNumber(CalString& eq, std::string& message)
 		return true;
 	}
 
-	while(!done && (pos > 0))
+	// No exponents here - "2e10x" is 2 times function 'e10x'
+	ScannedNumber numb;
+	if (!scanNumber(eq.c_str(), eq.c_str() + pos, SCAN_DEFAULT, numb))
 	{
-		if (isdigit(eq[0]))
-		{
-			numb.push_back(eq[0]);
-			eq.left(1);
-			pos--;
-			i++;
-		}
-		else if ((eq[0] == '.') && (decPt == 0))
-		{
-			// Decimal value
-			if (i == 0)
-			{
-				numb.push_back('0');
-			}
-			numb.push_back('.');
-			eq.left(1);
-			pos--;
-			i++;
-			decPt++;
-		}
-		else if (i == 0)
-		{
-			message = "Num::parseNumer '";
-			message += eq.c_str();
-			message += "' <= Not a number";
-			return false;
-		}
-		else
-		{
-			done = true;
-		}
-	}
-
-	if (numb.empty())
+		message = "Num::parseNumer '";
+		message += eq.c_str();
+		message += "' <= Not a number";
 		return false;
+	}
 
     // Make sure number or variable type is not set
-	if ((decPt == 0) && !isDouble())
+	if (numb.isInteger && !isDouble())
 	{
 		setInteger();
-		m_lValue = atoi(numb.c_str());
+		m_lValue = numb.intValue;
 	}
 	else
 	{
 		setDouble();
-		m_dValue = atof(numb.c_str());
+		m_dValue = numb.dblValue;
 	}
 
 	if (m_varName.empty())
 	{
-		m_varName = numb;
+		m_varName.assign(eq.c_str(), numb.length);
 	}
+	eq.left(numb.length);
 
 	return true;
 }
@@ -340,11 +344,21 @@ bool Num::parseFormat(CalString& eq, std::string& message)
 	}
 
 	// Look for space after formatting
+	std::string format;
 	while (!eq.empty() && !isspace(eq[0]))
 	{
-		m_format.push_back(eq[0]);
+		format.push_back(eq[0]);
 		eq.left(1);
 	}
+
+	// Formats are given to snprintf() - only with the one value it passes
+	FormatConversion conversion;
+	if (!findConversion(format, conversion))
+	{
+		message = "Format '" + format + "' needs one numeric conversion (ex. %.2f or %x)";
+		return false;
+	}
+	m_format = format;
 	return true;
 }
 
@@ -476,16 +490,14 @@ bool Num::isVariable(const CalString& string, int& len, ConstantVars& var)
 		return false;
 
     len = tmp.size();
-	for (auto it : s_constants)
+	const Context& context = Context::current();
+	const ConstantVars* found = context.findVariable(tmp);
+	if (found)
 	{
-		int sz = it.varName.size();
-		if ((sz == len) && (strncmp(it.varName.c_str(), tmp.c_str(), len) == 0))
-		{
-			var = it;
-			return true;
-		}
+		var = *found;
+		return true;
 	}
-	return false;
+	return (context.shared() != nullptr) && context.shared()->find(tmp, var);
 }
 
 bool Num::setNumber(const Num& value)
@@ -550,18 +562,29 @@ bool Num::updateFromUser()
     bool done = false;
 
     // Most like when it gets here, "isUnsetVar" returned true
-	if (Exec::s_showUndefinedVarMsg)
+	Context& context = Context::current();
+	if (!context.budget().interactive)
+	{
+		context.exceed(FNC_LIMIT_INPUT);
+		Console::print("Variable '" + m_varName + "' is not set");
+		return false;
+	}
+	if (context.m_showUndefinedVarMsg)
 	{
-		std::cout << "Functions: variable '" << m_varName << "' is not set. Enter value to continue calculations." << std::endl;
-		Exec::s_showUndefinedVarMsg = false;
+		Console::print(std::string("Functions: variable '") + m_varName + "' is not set. Enter value to continue calculations.");
+		context.m_showUndefinedVarMsg = false;
 	}
 
     do {
-        std::cout << m_varName << "=";
-        getline(std::cin, tmp);
-        if (tmp.empty())
+        if (!Console::input(m_varName + "=", tmp))
         {
-            std::cout << m_varName << "= 0 (integer)" << std::endl;
+            // No one to ask (or end of input) - variable stays unset
+            Console::print("Variable '" + m_varName + "' is not set");
+            done = true;
+        }
+        else if (tmp.empty())
+        {
+            Console::print(m_varName + "= 0 (integer)");
             done = true;
             // NOTE: if default (0), then variable is not updated
         }
@@ -574,7 +597,7 @@ bool Num::updateFromUser()
         }
         else
         {
-            std::cout << "Error parsing: '" << tmp << "' - errored: " << message << " - try again? (<CR> to enter 0 and continue)" << std::endl;
+            Console::print(std::string("Error parsing: '") + tmp + "' - errored: " + message + " - try again? (<CR> to enter 0 and continue)");
         }
     } while (!done);
 
@@ -592,40 +615,53 @@ void Num::updateFromVariable(const ConstantVars& var)
 
 std::string Num::asString() const
 {
-	std::string s_tmp;
-	s_tmp.resize(1024);
-	const char* fmt; 
-#ifdef _MSC_VER
-	if (isInteger())
+	char text[FORMAT_BUFFER_SIZE];
+	FormatConversion conversion;
+	if (m_format.empty() || !findConversion(m_format, conversion))
 	{
-		fmt = m_format.empty() ? "%lld" : m_format.c_str();
-		sprintf_s(const_cast<char*>(s_tmp.data()),1024,fmt, m_lValue, m_unit.asString().c_str());
+		// Default formats
+		if (isInteger())
+		{
+			snprintf(text, sizeof(text), "%lld", static_cast<long long>(m_lValue));
+		}
+		else
+		{
+			snprintf(text, sizeof(text), "%.9f", m_dValue);
+		}
 	}
 	else
 	{
-		fmt = m_format.empty() ? "%.9f" : m_format.c_str();
-		sprintf_s(const_cast<char*>(s_tmp.data()),1024,fmt, m_dValue, m_unit.asString().c_str());
+		// Conversion of the format with the length of the value passed
+		bool integer = strchr("diouxX", conversion.type) != nullptr;
+		std::string fmt = m_format.substr(0, conversion.start) + "%" + conversion.spec
+			+ (integer ? "ll" : "") + conversion.type + m_format.substr(conversion.end);
+
+		double value = asDouble();
+		if (!integer)
+		{
+			snprintf(text, sizeof(text), fmt.c_str(), value);
+		}
+		else if (isInteger())
+		{
+			snprintf(text, sizeof(text), fmt.c_str(), static_cast<long long>(m_lValue));
+		}
+		else if ((value >= -9.2e18) && (value <= 9.2e18))
+		{
+			snprintf(text, sizeof(text), fmt.c_str(), static_cast<long long>(value));
+		}
+		else
+		{
+			// Does not fit an integer (or NaN)
+			snprintf(text, sizeof(text), "%.9f", value);
+		}
 	}
-    size_t len = strlen(s_tmp.c_str());
-    s_tmp.resize(len);
-#else
-    if (isInteger())
-    {
-		fmt = m_format.empty() ? "%ld" : m_format.c_str();
-	    sprintf(const_cast<char*>(s_tmp.data()), fmt, m_lValue);
-    }
-    else
-    {
-		fmt = m_format.empty() ? "%.9f" : m_format.c_str();
-		sprintf(const_cast<char*>(s_tmp.data()), fmt, m_dValue);
-    }
+
+	std::string result(text);
 	if (!m_unit.asString().empty())
 	{
-		strcat(const_cast<char*>(s_tmp.data()), m_unit.asString().c_str());
+		result += m_unit.asString();
 	}
-
-#endif
-	return s_tmp;
+	return result;
 }
 
 // static
@@ -667,39 +703,27 @@ bool Num::isNumber(const CalString& string)
 
 bool Num::addOrUpdateVariable()
 {
-    ConstantVars var;
-    int len = m_varName.size();
-    const char* vName = m_varName.c_str();
-
     // This will reset the "unset" flag
     setAsVariable();
 
-    var.varName = m_varName;
-    var.value = m_dValue;
-    var.num_type = m_type;
-    var.unit_type = m_unit.unitType();
-    var.units = m_unit.keyString();
-
-    for (auto &it : s_constants)
+    Context& context = Context::current();
+    const ConstantVars* found = context.findVariable(m_varName);
+    if (found)
     {
-        int sz = it.varName.size();
 		// Make sure it is not a constant
-        if ( (sz == len) && (strncmp(it.varName.c_str(), vName, len) == 0))
+        if (found->num_type & NUM_CONSTS)
         {
-			if (it.num_type & NUM_CONSTS)
-			{
-				std::cout << "!!! Attempting to update a constant '" << m_varName << "'" << std::endl;
-				return false;
-			}
-			else if (!(*this == it))
-            {
-                it = var;
-            }
-            return true;
+            Console::print(std::string("!!! Attempting to update a constant '") + m_varName + "'");
+            return false;
+        }
+        else if (!(*this == *found))
+        {
+            context.setVariable(asVariable());
         }
+        return true;
     }
 
-    s_constants.push_back(var);
+    context.setVariable(asVariable());
 
     return false;
 }
@@ -738,31 +762,28 @@ bool Num::convertTo(const NumberType type)
 
 bool Num::convertUnitTo(Num& to)
 {
-	CalString func;
-	if (!convertUnit(to, func))
+	// Conversions are resolved when settings are built - this only looks up
+	const UnitConversion* conversion = nullptr;
+	if (!(m_unit == to.m_unit))
 	{
-		std::cout << "Conversion from " << asString()
-			<< " to " << to.asString() << " <= not implemented yet" << std::endl;
-		return false;
+		conversion = Context::current().settings().findConversion(m_unit, to.m_unit);
+		if (!conversion)
+		{
+			Console::print("Conversion from " + asString()
+				+ " to " + to.asString() + " <= not implemented yet");
+			return false;
+		}
 	}
 
-	Exec ex;
-	ex.inputParseAndRun(*this, func);
-
-	return true;
-}
-
-
-bool Num::convertUnit(const Num& to, CalString& func)
-{
-	if (m_unit.findConversion(to.m_unit, func))
+	// Result has no units (same as running the formula)
+	convertTo(NUM_DOUBLE);
+	if (conversion)
 	{
-		// If conversion completed, units on origin number
-		m_unit = to.m_unit;
-		convertTo(to.m_unit.numberType());
-		return true;
+		m_dValue = conversion->apply(m_dValue);
 	}
-	return false;
+	m_unit = NumUnit();
+
+	return true;
 }
 
 bool Num::convertToRads()
@@ -770,22 +791,17 @@ bool Num::convertToRads()
 	// Recomputes the number from assumed default (degrees to radians)
 	if (isRad())
 		return true;
-	
-	NumUnit conv("deg");
-	NumUnit to("rad");
 
-	CalString func;
-	if (conv.findConversion(to, func))
-	{
-		// We cannot modify unit - especially if used
-		convertTo(NUM_DOUBLE);
-
-		Exec ex;
-		ex.inputParseAndRun(*this, func);
+	// Resolved with the settings - trig functions call this for every value
+	const UnitConversion& toRads = Context::current().settings().toRads();
+	if (!toRads.valid())
+		return false;
 
-		return true;
-	}
-	return false;
+	// Result has no units (same as running the formula)
+	convertTo(NUM_DOUBLE);
+	m_dValue = toRads.apply(m_dValue);
+	m_unit = NumUnit();
+	return true;
 }
 
 bool Num::convertFromRads()
@@ -794,34 +810,30 @@ bool Num::convertFromRads()
 	if (isRad())
 		return true;
 
-	UnitDefs def;
-	int pos = NumUnit::findUnits("rad", def);
-	NumUnit conv(def);
-	pos = NumUnit::findUnits("deg", def);
-
-	CalString func;
-	if (conv.findConversion(def, func))
-	{
-		// We cannot modify unit
-		convertTo(NUM_DOUBLE);
+	const UnitConversion& fromRads = Context::current().settings().fromRads();
+	if (!fromRads.valid())
+		return false;
 
-		Exec ex;
-		ex.inputParseAndRun(*this, func);
+	convertTo(NUM_DOUBLE);
+	m_dValue = fromRads.apply(m_dValue);
+	m_unit = NumUnit();
+	return true;
+}
 
-		return true;
-	}
-	return false;
+ConstantVars Num::asVariable() const
+{
+    return ConstantVars{m_varName, m_dValue, m_type, m_unit.unitType(), m_unit.keyString()};
 }
 
 // static
 void Num::showVariables()
 {
-    for (auto it : s_constants)
+    for (auto it : Context::current().variables())
     {
         Num no(it);
         if (no.isVar())
         {
-            std::cout << no.varName() << "=" << no.asString() << std::endl;
+            Console::print(no.varName() + "=" + no.asString());
         }
     }
 }
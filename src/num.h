@@ -106,8 +106,14 @@ public:
     // Adds itself as a variable
     bool addOrUpdateVariable();
 
+    /// @brief Definition of this number as variable 'm_varName'
+    ConstantVars asVariable() const;
+
 	std::string asString() const;
 
+	/// @brief Plain value (units are not converted)
+	double asDouble() const { return isInteger() ? static_cast<double>(m_lValue) : m_dValue; }
+
 	const CalString& varName() const { return m_varName; }
 
 	static bool isNumber(const CalString& string);
@@ -121,9 +127,6 @@ public:
 private:
 	void copyHelper(const Num& ref);
 
-	// Does the number conversion. "to" Num is populated with new value
-	bool convertUnit(const Num& to, CalString& func);
-
 public:
 
 	// Number description
@@ -152,9 +155,6 @@ public:
 
 	// Real number or varName
 	CalString m_varName;
-
-	static std::vector<ConstantVars> s_constants;
-
 };
 
 using NumStack = std::vector<Num>;
@@ -0,0 +1,253 @@
+/// @file
+///
+/// @brief Implementation of scanNumber() - fast numeric literal scanning.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "numScan.h"
+#include "binaryIO.h"
+
+// Digits that always fit in uint64 (10^19 - 1 < 2^64)
+constexpr int MAX_MANTISSA_DIGITS {19};
+
+// Doubles hold integers up to 2^53 exactly
+constexpr uint64_t MAX_EXACT_MANTISSA {uint64_t(1) << 53};
+
+// Powers of ten that are exact doubles
+static const double s_powersOfTen[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+constexpr int MAX_EXACT_POWER {22};
+
+/// @brief All 8 characters are '0'..'9'
+static inline bool isEightDigits(const uint64_t value)
+{
+	// High nibbles must be 3, and adding 6 must not carry into them
+	return (((value & 0xF0F0F0F0F0F0F0F0ULL)
+		| (((value + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4))
+		== 0x3333333333333333ULL);
+}
+
+/// @brief Converts 8 digits (see isEightDigits()) to their value
+static inline uint32_t parseEightDigits(uint64_t value)
+{
+	// Pairs, then fours, then all eight - three multiplies instead of eight
+	value -= 0x3030303030303030ULL;
+	value = (value * 10) + (value >> 8);
+	value = (((value & 0x000000FF000000FFULL) * 0x000F424000000064ULL)
+		+ (((value >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >> 32;
+	return uint32_t(value);
+}
+
+/// @brief Number of digits in value (value < 10^8)
+static inline int countDigits(uint32_t value)
+{
+	int digits = 0;
+	while (value > 0)
+	{
+		value /= 10;
+		digits++;
+	}
+	return digits;
+}
+
+/// @brief Collects decimal digits into mantissa.
+/// 'digits' counts significant digits (leading zeros are not counted);
+/// beyond MAX_MANTISSA_DIGITS they are skipped and mantissa is inexact.
+/// @return Position after the last digit
+static const char* scanDigits(const char* p, const char* end, uint64_t& mantissa, int& digits)
+{
+	while (((end - p) >= 8) && (digits <= (MAX_MANTISSA_DIGITS - 8)))
+	{
+		// First character in the low byte
+		uint64_t chars = readRaw64(p);
+		if (!isEightDigits(chars))
+			break;
+
+		uint32_t value = parseEightDigits(chars);
+		digits += (mantissa == 0) ? countDigits(value) : 8;
+		mantissa = (mantissa * 100000000) + value;
+		p += 8;
+	}
+
+	while ((p < end) && (*p >= '0') && (*p <= '9'))
+	{
+		if (digits < MAX_MANTISSA_DIGITS)
+		{
+			mantissa = (mantissa * 10) + uint64_t(*p - '0');
+		}
+		if ((mantissa != 0) || (digits > 0))
+		{
+			digits++;
+		}
+		p++;
+	}
+	return p;
+}
+
+/// @brief Hex digit value - -1 if not a hex digit
+static inline int hexValue(const char c)
+{
+	if ((c >= '0') && (c <= '9'))
+		return c - '0';
+	if ((c >= 'a') && (c <= 'f'))
+		return c - 'a' + 10;
+	if ((c >= 'A') && (c <= 'F'))
+		return c - 'A' + 10;
+	return -1;
+}
+
+/// @brief Exactly rounded conversion of text that scanDigits() could not keep exact
+static double slowConvert(const char* begin, const size_t length)
+{
+	// strtod() needs a terminated string
+	char buffer[128];
+	if (length < sizeof(buffer))
+	{
+		memcpy(buffer, begin, length);
+		buffer[length] = '\0';
+		return strtod(buffer, nullptr);
+	}
+	return strtod(std::string(begin, length).c_str(), nullptr);
+}
+
+bool scanNumber(const char* begin, const char* end, const uint32_t flags, ScannedNumber& number)
+{
+	number.length = 0;
+	number.isInteger = false;
+	number.isHex = false;
+	number.intValue = 0;
+	number.dblValue = 0.;
+
+	const char* p = begin;
+	bool negative = false;
+	if ((p < end) && (*p == '-'))
+	{
+		negative = true;
+		p++;
+	}
+
+	// Hexadecimal - "0x" followed by at least one hex digit
+	if ((flags & SCAN_HEX) && ((end - p) > 2) && (p[0] == '0') && ((p[1] == 'x') || (p[1] == 'X'))
+		&& (hexValue(p[2]) >= 0))
+	{
+		p += 2;
+		uint64_t value = 0;
+		int digit;
+		while ((p < end) && ((digit = hexValue(*p)) >= 0))
+		{
+			// Bits beyond 64 are dropped (like a register)
+			value = (value << 4) | uint64_t(digit);
+			p++;
+		}
+		number.length = size_t(p - begin);
+		number.isInteger = true;
+		number.isHex = true;
+		number.intValue = negative ? int64_t(0 - value) : int64_t(value);
+		number.dblValue = double(number.intValue);
+		return true;
+	}
+
+	uint64_t mantissa = 0;
+	int digits = 0;
+
+	const char* start = p;
+	p = scanDigits(p, end, mantissa, digits);
+	bool hasDigits = (p != start);
+
+	// Digits after the decimal point move the exponent
+	int exponent = 0;
+	bool isInteger = true;
+	if ((p < end) && (*p == '.'))
+	{
+		const char* fraction = p + 1;
+		const char* after = scanDigits(fraction, end, mantissa, digits);
+		if (hasDigits || (after != fraction))
+		{
+			hasDigits = true;
+			isInteger = false;
+			exponent = -int(after - fraction);
+			p = after;
+		}
+	}
+
+	if (!hasDigits)
+		return false;
+
+	if ((flags & SCAN_EXPONENT) && ((end - p) > 1) && ((*p == 'e') || (*p == 'E')))
+	{
+		const char* q = p + 1;
+		bool negativeExp = false;
+		if ((*q == '+') || (*q == '-'))
+		{
+			negativeExp = (*q == '-');
+			q++;
+		}
+		if ((q < end) && (*q >= '0') && (*q <= '9'))
+		{
+			int value = 0;
+			while ((q < end) && (*q >= '0') && (*q <= '9'))
+			{
+				// Anything larger is zero or infinity anyway
+				if (value < 100000)
+				{
+					value = (value * 10) + (*q - '0');
+				}
+				q++;
+			}
+			exponent += negativeExp ? -value : value;
+			isInteger = false;
+			p = q;
+		}
+	}
+
+	number.length = size_t(p - begin);
+
+	// Digits beyond MAX_MANTISSA_DIGITS were skipped - strtod() gets those
+	bool exact = (digits <= MAX_MANTISSA_DIGITS);
+
+	if (isInteger && exact)
+	{
+		// Full 64-bit range, including INT64_MIN
+		uint64_t limit = negative ? (uint64_t(INT64_MAX) + 1) : uint64_t(INT64_MAX);
+		if (mantissa <= limit)
+		{
+			number.isInteger = true;
+			number.intValue = negative ? int64_t(0 - mantissa) : int64_t(mantissa);
+			number.dblValue = double(number.intValue);
+			return true;
+		}
+	}
+
+	// Mantissa and power of ten are both exact doubles, so one multiply or
+	// divide rounds exactly once (Clinger's fast path)
+	if (exact && (mantissa <= MAX_EXACT_MANTISSA) && (exponent >= -MAX_EXACT_POWER) && (exponent <= MAX_EXACT_POWER))
+	{
+		double value = double(mantissa);
+		value = (exponent < 0) ? (value / s_powersOfTen[-exponent]) : (value * s_powersOfTen[exponent]);
+		number.dblValue = negative ? -value : value;
+		return true;
+	}
+
+	number.dblValue = slowConvert(begin, number.length);
+	return true;
+}
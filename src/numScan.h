@@ -0,0 +1,49 @@
+/// @file
+///
+/// @brief Header for fast numeric literal scanning (no allocations).
+///
+/// Digits are checked and converted eight at a time within a 64-bit register
+/// (SWAR). Integers keep all 64 bits, doubles are exactly rounded.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// @brief What scanNumber() accepts besides [-]digits[.digits]
+enum ScanFlags : uint32_t
+{
+	SCAN_DEFAULT  = 0,
+	SCAN_EXPONENT = 0x1,  // 1.5e-3 (not in expressions: "2e10x" is 2*10^x)
+	SCAN_HEX      = 0x2   // 0x1F (always an integer)
+};
+
+/// @brief Number found by scanNumber()
+typedef struct _scannedNumber
+{
+	size_t  length;     // Characters used - 0 if not a number
+	bool    isInteger;  // No decimal point/exponent and fits in int64
+	bool    isHex;
+	int64_t intValue;   // Set if isInteger
+	double  dblValue;   // Always set
+} ScannedNumber;
+
+/// @brief Scans number at start of [begin, end).
+/// @return false if there is no number
+bool scanNumber(const char* begin, const char* end, const uint32_t flags, ScannedNumber& number);
@@ -23,6 +23,8 @@
 
 #include "numUnit.h"
 #include "num.h"
+#include "exec.h"
+#include "context.h"
 
 #include "calstring.h"
 
@@ -175,7 +177,7 @@ std::vector<UnitDefs> NumUnit::s_units
 // such as temperature and radian/degree requires a formula. This
 // is conversion for both of these conversion functions.
 
-std::vector<ConversionFunction> s_conversions
+std::vector<ConversionFunction> NumUnit::s_conversions
 {
 	{UNIT_ANGLE,       "deg", "rad", "*pi/180"},
 	{UNIT_ANGLE,       "rad", "deg", "*180/pi"},
@@ -184,6 +186,10 @@ std::vector<ConversionFunction> s_conversions
 //	{UNIT_MEMORY,         // Used for conversion of digital storage
 	{UNIT_TEMPERATURE, "C",   "F", "*9/5+32."},
 	{UNIT_TEMPERATURE, "F",   "C", "- 32.*5/9"},
+	{UNIT_TEMPERATURE, "C",   "K", "+273.15"},
+	{UNIT_TEMPERATURE, "K",   "C", "- 273.15"},
+	{UNIT_TEMPERATURE, "F",   "K", "- 32.*5/9+273.15"},
+	{UNIT_TEMPERATURE, "K",   "F", "- 273.15*9/5+32."},
 
 	{UNIT_LENGTH,      "mm",  "cm", "/10."},
 	{UNIT_LENGTH,      "mm",  "m", "/1000."},
@@ -255,7 +261,12 @@ std::vector<ConversionFunction> s_conversions
 //	{UNIT_FORCE,
 //	{UNIT_ENERGY,
 //	{UNIT_WORK,
-//	{UNIT_PRESSURE,
+	{UNIT_PRESSURE,    "psi", "kPa", "*6.894757293168"},
+	{UNIT_PRESSURE,    "kPa", "psi", "/6.894757293168"},
+	{UNIT_PRESSURE,    "atm", "kPa", "*101.325"},
+	{UNIT_PRESSURE,    "kPa", "atm", "/101.325"},
+	{UNIT_PRESSURE,    "atm", "psi", "*101.325/6.894757293168"},
+	{UNIT_PRESSURE,    "psi", "atm", "*6.894757293168/101.325"},
 //	{UNIT_VOLTAGE,
 //	{UNIT_CURRENT,
 //	{UNIT_RESISTANCE,
@@ -345,7 +356,7 @@ bool NumUnit::findConversion(const UnitDefs& to, CalString& func)
 	if ((m_units.unitType != UNIT_NUMBER) && (m_units.unitType != to.unitType))
 		return false;
 
-	for (auto it : s_conversions)
+	for (auto& it : Context::current().settings().conversions())
 	{
 		if((it.type == to.unitType)
 			&& (strcmp(m_units.unitKey.c_str(), it.from.c_str()) == 0)
@@ -366,7 +377,7 @@ int NumUnit::findUnits(const std::string& string, UnitDefs& def)
 	int len = string.size();
 	if (len > 0)
 	{
-		for (auto it : s_units)
+		for (auto it : Context::current().units())
 		{
 			int sz = it.unitStr.size();
 			if ((sz == len) && strncmp(it.unitStr.c_str(), string.c_str(), sz) == 0)
@@ -380,3 +391,133 @@ int NumUnit::findUnits(const std::string& string, UnitDefs& def)
 }
 
 
+//----------------------------------------------------------
+// Unit Conversion
+//----------------------------------------------------------
+
+// Values the formula is run with - a power of 2 keeps (f(x) - f(0)) / x exact
+constexpr double SCALE_PROBE {1048576.};
+constexpr double CHECK_PROBE {-12345.678};
+
+// Relative error allowed when checking the formula is affine
+constexpr double AFFINE_TOLERANCE {1e-12};
+
+UnitConversion::UnitConversion()
+	: m_valid(false)
+	, m_scale(1.)
+	, m_offset(0.)
+{
+}
+
+bool UnitConversion::resolve(const std::string& from, const std::string& to, std::string& message)
+{
+	m_valid = false;
+
+	UnitDefs fromDef;
+	UnitDefs toDef;
+	if (NumUnit::findUnits(from, fromDef) < 0)
+	{
+		message = "Unit '" + from + "' is unknown";
+		return false;
+	}
+	if (NumUnit::findUnits(to, toDef) < 0)
+	{
+		message = "Unit '" + to + "' is unknown";
+		return false;
+	}
+	return resolve(NumUnit(fromDef), NumUnit(toDef), message);
+}
+
+bool UnitConversion::resolve(const NumUnit& from, const NumUnit& to, std::string& message)
+{
+	m_valid = false;
+	m_from = from;
+	m_to = to;
+
+	if (m_from == m_to)
+	{
+		// Same unit (ex. "C" and "degC")
+		m_scale = 1.;
+		m_offset = 0.;
+		m_valid = true;
+		return true;
+	}
+
+	// Resolved when the settings were built
+	const UnitConversion* conversion = Context::current().settings().findConversion(m_from, m_to);
+	if (!conversion)
+	{
+		message = "No conversion from '" + from.keyString() + "' to '" + to.keyString() + "'";
+		return false;
+	}
+
+	m_scale = conversion->m_scale;
+	m_offset = conversion->m_offset;
+	m_valid = true;
+	return true;
+}
+
+bool UnitConversion::resolve(const CalString& formula, const NumUnit& from, const NumUnit& to, std::string& message)
+{
+	m_valid = false;
+	m_from = from;
+	m_to = to;
+
+	double atZero;
+	double atProbe;
+	double atCheck;
+	if (!evaluate(formula, 0., atZero) || !evaluate(formula, SCALE_PROBE, atProbe)
+		|| !evaluate(formula, CHECK_PROBE, atCheck))
+	{
+		message = "Conversion from '" + from.keyString() + "' to '" + to.keyString() + "' failed (" + formula + ")";
+		return false;
+	}
+
+	m_offset = atZero;
+	m_scale = (atProbe - atZero) / SCALE_PROBE;
+
+	if (std::fabs(apply(CHECK_PROBE) - atCheck) > (AFFINE_TOLERANCE * (std::fabs(atCheck) + 1.)))
+	{
+		message = "Conversion from '" + from.keyString() + "' to '" + to.keyString() + "' is not linear (" + formula + ")";
+		return false;
+	}
+
+	m_valid = true;
+	return true;
+}
+
+void UnitConversion::apply(const double* in, double* out, const size_t count) const
+{
+	// Locals stay in registers - the loop vectorizes
+	const double scale = m_scale;
+	const double offset = m_offset;
+	for (size_t i = 0; i < count; i++)
+	{
+		out[i] = fnc::kernel::affine(in[i], scale, offset);
+	}
+}
+
+void UnitConversion::apply(const float* in, float* out, const size_t count) const
+{
+	// Twice the lanes of the double version
+	const float scale = static_cast<float>(m_scale);
+	const float offset = static_cast<float>(m_offset);
+	for (size_t i = 0; i < count; i++)
+	{
+		out[i] = fnc::kernel::affine(in[i], scale, offset);
+	}
+}
+
+// static
+bool UnitConversion::evaluate(const CalString& formula, const double value, double& result)
+{
+	Num no(value, NUM_DOUBLE);
+	CalString tmp(formula);
+
+	Exec ex;
+	if (!ex.inputParseAndRun(no, tmp) || (Context::current().exceeded() != FNC_LIMIT_NONE))
+		return false;
+
+	result = no.isInteger() ? double(no.m_lValue) : no.m_dValue;
+	return true;
+}
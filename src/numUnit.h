@@ -21,10 +21,12 @@
 #pragma once
 
 #include <vector>
+#include <cmath>
 
 #include "calstring.h"
 
 #include "numDefs.h"
+#include "fncKernels.h"
 
 /// @brief Struct to construct Conversion functions.
 /// The list is in convert.cpp and constructed to add more unit conversions
@@ -115,9 +117,12 @@ public:
 	/// @brief Finds the Unit Def for a given string
 	static int findUnits(const std::string& string, UnitDefs& def);
 
-	/// @brief List of Units other functions can use, if needed
+	/// @brief Built-in units (units in use are Context::current().units())
 	static std::vector<UnitDefs> s_units;
 
+	/// @brief Built-in conversions (see Settings)
+	static std::vector<ConversionFunction> s_conversions;
+
 private:
 	void copyHelper(const NumUnit& ref)
 	{
@@ -132,5 +137,52 @@ private:
 	UnitDefs m_units;
 };
 
+/// @brief Conversion between two units resolved once: to = (from * scale) + offset.
+/// Every conversion in the list is affine (scaled, or scaled and shifted like
+/// temperatures), so its formula is run only to find scale and offset.
+class UnitConversion
+{
+public:
+	UnitConversion();
+
+	/// @brief Finds conversion between unit strings (ex. "in", "mm").
+	/// @return false if a unit is unknown or there is no conversion
+	bool resolve(const std::string& from, const std::string& to, std::string& message);
+
+	/// @brief Finds conversion between units of numbers
+	bool resolve(const NumUnit& from, const NumUnit& to, std::string& message);
+
+	/// @brief Resolves conversion formula (ex. "*pi/180") - it must be affine
+	bool resolve(const CalString& formula, const NumUnit& from, const NumUnit& to, std::string& message);
+
+	/// @brief Conversion was resolved
+	bool valid() const { return m_valid; }
+
+	double scale() const { return m_scale; }
 
+	double offset() const { return m_offset; }
 
+	/// @brief Converts one value
+	double apply(const double value) const { return fnc::kernel::affine(value, m_scale, m_offset); }
+
+	/// @brief Converts array (in place if 'in' == 'out')
+	void apply(const double* in, double* out, const size_t count) const;
+
+	/// @brief Converts float32 array - scale and offset are rounded to float32.
+	/// Error is at most 2 * 2^-24 * (|value * scale| + |offset|) (see README).
+	void apply(const float* in, float* out, const size_t count) const;
+
+	/// @brief Units of results
+	const NumUnit& to() const { return m_to; }
+
+private:
+	// Runs the conversion formula with a value
+	static bool evaluate(const CalString& formula, const double value, double& result);
+
+	bool m_valid;
+	double m_scale;
+	double m_offset;
+
+	NumUnit m_from;
+	NumUnit m_to;
+};
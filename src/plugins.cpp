@@ -0,0 +1,268 @@
+/// @file
+///
+/// @brief Implementation of Plugins - functions loaded from shared objects.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#ifndef _MSC_VER
+ #include <dlfcn.h>
+#endif
+
+#include "plugins.h"
+#include "console.h"
+#include "expressionCache.h"
+
+/// @brief Name of the entry point of a plugin
+constexpr const char* PLUGIN_INIT {"fnc_plugin_init"};
+
+/// @brief Loaded functions - entries below s_count never change
+static PluginFunction s_plugins[PLUGIN_FUNCTIONS];
+static std::atomic<size_t> s_count {0};
+
+/// @brief Loads (and shared objects loaded)
+static std::mutex s_loading;
+static std::vector<std::string> s_paths;
+
+/// @brief Functions of the table - one per plugin function (the table has no
+/// room for more than the type, so the index is part of the function)
+template <size_t I>
+static bool runPlugin(NumStack& params)
+{
+	return Plugins::run(I, params);
+}
+
+template <size_t... I>
+static constexpr std::array<bool (*)(NumStack&), sizeof...(I)> pluginKernels(std::index_sequence<I...>)
+{
+	return {{&runPlugin<I>...}};
+}
+
+static const std::array<bool (*)(NumStack&), PLUGIN_FUNCTIONS> s_kernels
+	= pluginKernels(std::make_index_sequence<PLUGIN_FUNCTIONS>());
+
+/// @brief Functions a plugin adds while it is initialized
+typedef struct _registration
+{
+	std::string path;
+	std::vector<PluginFunction> functions;
+	std::string message;   // First function refused
+} Registration;
+
+/// @brief Letters, digits and '_' - starts with a letter
+static bool validName(const std::string& name)
+{
+	if (name.empty() || !isalpha(static_cast<unsigned char>(name[0])))
+		return false;
+
+	for (char c : name)
+	{
+		if (!isalnum(static_cast<unsigned char>(c)) && (c != '_'))
+			return false;
+	}
+	return true;
+}
+
+/// @brief 'add' given to plugins
+static int addFunction(void* registry, const fnc_plugin_function* function)
+{
+	Registration& added = *static_cast<Registration*>(registry);
+	if (!added.message.empty())
+		return 1;
+
+	if ((function == nullptr) || (function->name == nullptr) || !validName(function->name))
+	{
+		added.message = "function name must be letters, digits or '_'";
+		return 1;
+	}
+
+	std::string name = function->name;
+	int pos = -1;
+	Functions found;
+	bool exists = FunctionType::findFunc(name, pos, found) && (found.str == name);
+	for (const auto& it : added.functions)
+	{
+		exists = exists || (it.name == name);
+	}
+
+	if (exists)
+	{
+		added.message = "function '" + name + "' exists";
+	}
+	else if ((function->arity < 1) || (function->arity > FNC_PLUGIN_ARGUMENTS))
+	{
+		added.message = "function '" + name + "' must take 1 to " + std::to_string(FNC_PLUGIN_ARGUMENTS) + " arguments";
+	}
+	else if (function->scalar == nullptr)
+	{
+		added.message = "function '" + name + "' has no scalar kernel";
+	}
+	else if ((function->units != FNC_UNITS_NONE) && (function->units != FNC_UNITS_KEEP)
+		&& (function->units != FNC_UNITS_ANGLE))
+	{
+		added.message = "function '" + name + "' has unknown units";
+	}
+	else if ((s_count.load() + added.functions.size()) >= PLUGIN_FUNCTIONS)
+	{
+		added.message = "more than " + std::to_string(PLUGIN_FUNCTIONS) + " plugin functions";
+	}
+
+	if (!added.message.empty())
+		return 1;
+
+	added.functions.push_back(PluginFunction{name, added.path, function->arity, function->units,
+		function->scalar, function->array});
+	return 0;
+}
+
+#ifdef _MSC_VER
+
+// static
+bool Plugins::load(const std::string& path, std::string& message)
+{
+	message = "Plugins are not available on this platform";
+	return false;
+}
+
+#else
+
+// static
+bool Plugins::load(const std::string& path, std::string& message)
+{
+	std::lock_guard<std::mutex> lock(s_loading);
+	for (const auto& it : s_paths)
+	{
+		if (it == path)
+			return true;
+	}
+
+	void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (handle == nullptr)
+	{
+		const char* error = dlerror();
+		message = "Plugin '" + path + "' cannot be loaded - " + (error ? error : "unknown error");
+		return false;
+	}
+
+	auto init = reinterpret_cast<int (*)(unsigned, void*, fnc_plugin_add)>(dlsym(handle, PLUGIN_INIT));
+	if (init == nullptr)
+	{
+		message = "Plugin '" + path + "' has no " + PLUGIN_INIT + "()";
+		dlclose(handle);
+		return false;
+	}
+
+	Registration added{path, {}, ""};
+	int status = init(FNC_PLUGIN_VERSION, &added, addFunction);
+	if ((status != 0) || !added.message.empty())
+	{
+		message = "Plugin '" + path + "' - " + (added.message.empty()
+			? "failed to initialize (" + std::to_string(status) + ")" : added.message);
+		dlclose(handle);
+		return false;
+	}
+
+	// Entries first - the parser finds them once they are in the table
+	size_t first = s_count.load();
+	std::vector<Functions> table;
+	for (size_t i = 0; i < added.functions.size(); i++)
+	{
+		const PluginFunction& fn = added.functions[i];
+		s_plugins[first + i] = fn;
+		table.push_back(Functions{fn.name, FunctionValue(F_PLUGIN + first + i),
+			(fn.arity == 2) ? MODE_BINARY : MODE_UNARY, s_kernels[first + i]});
+	}
+	s_count.store(first + added.functions.size(), std::memory_order_release);
+	FunctionType::addFunctions(table);
+
+	// Cached programs took the new names for variables
+	ExpressionCache::shared().invalidate();
+
+	// Kernels are used until the process ends - never closed
+	s_paths.push_back(path);
+	return true;
+}
+
+#endif
+
+// static
+const PluginFunction& Plugins::function(const FunctionValue type)
+{
+	return s_plugins[type - F_PLUGIN];
+}
+
+// static
+bool Plugins::run(const size_t index, NumStack& params)
+{
+	const PluginFunction& fn = s_plugins[index];
+	if (params.size() < fn.arity)
+	{
+		Console::print("Function: '" + fn.name + "' - needs " + std::to_string(fn.arity) + " parameters");
+		return false;
+	}
+
+	size_t first = params.size() - fn.arity;
+	double args[FNC_PLUGIN_ARGUMENTS];
+	for (size_t i = 0; i < fn.arity; i++)
+	{
+		Num& no = params[first + i];
+		no.confirm();
+		if ((i == 0) && (fn.units == FNC_UNITS_ANGLE))
+		{
+			no.convertToRads();
+		}
+		no.convertTo(NUM_DOUBLE);
+		args[i] = no.m_dValue;
+	}
+
+	Num result = (fn.units == FNC_UNITS_NONE) ? Num(0., NUM_DOUBLE) : params[first];
+	if (fn.units == FNC_UNITS_ANGLE)
+	{
+		// Result is not an angle - format only
+		result.m_unit = NumUnit();
+	}
+	result.m_dValue = fn.scalar(args);
+	params.resize(first);
+	params.push_back(result);
+	return true;
+}
+
+// static
+void Plugins::runArray(const PluginFunction& fn, const double* const* args, const size_t count, double* results)
+{
+	if (fn.array != nullptr)
+	{
+		fn.array(args, count, results);
+		return;
+	}
+
+	double row[FNC_PLUGIN_ARGUMENTS];
+	for (size_t i = 0; i < count; i++)
+	{
+		for (size_t j = 0; j < fn.arity; j++)
+		{
+			row[j] = args[j][i];
+		}
+		results[i] = fn.scalar(row);
+	}
+}
@@ -0,0 +1,69 @@
+/// @file
+///
+/// @brief Header for Plugins - functions loaded from shared objects.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <string>
+
+#include "fncPlugin.h"
+#include "functions.h"
+
+/// @brief Most functions of all plugins
+constexpr size_t PLUGIN_FUNCTIONS {256};
+
+/// @brief Loaded function
+typedef struct _pluginFunction
+{
+	std::string       name;
+	std::string       path;    // Shared object it came from
+	unsigned          arity;
+	fnc_plugin_units  units;
+	fnc_scalar_kernel scalar;
+	fnc_array_kernel  array;   // nullptr - scalar per row
+} PluginFunction;
+
+// How Plugins works:
+// A loaded function is one more entry of the function table: type
+// F_PLUGIN + index, mode by arity, and a function of its own that runs its
+// scalar kernel on the number stack - so the parser, Program and the
+// expression cache treat it as a built-in, and built-ins run as before.
+// BlockProgram runs the array kernel over each block of rows. Functions are
+// only added (never removed or changed), each one before the parser can find
+// it, so threads read them without locks; loads are serialized.
+// See fncPlugin.h for writing a plugin.
+
+class Plugins
+{
+public:
+	/// @brief Loads shared object and adds its functions (nothing if it was loaded before)
+	static bool load(const std::string& path, std::string& message);
+
+	/// @brief Function type is of a plugin
+	static bool isPlugin(const FunctionValue type) { return type >= F_PLUGIN; }
+
+	/// @brief Function of type (isPlugin())
+	static const PluginFunction& function(const FunctionValue type);
+
+	/// @brief Runs scalar kernel of function 'index' on the number stack
+	static bool run(const size_t index, NumStack& params);
+
+	/// @brief Runs array kernel of function (scalar kernel per row if it has none)
+	static void runArray(const PluginFunction& fn, const double* const* args, const size_t count, double* results);
+};
@@ -0,0 +1,279 @@
+/// @file
+///
+/// @brief Implementation of Program - compiled expressions.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "program.h"
+#include "exec.h"
+#include "func.h"
+#include "context.h"
+#include "plugins.h"
+
+Program::Program()
+	: m_depth(0)
+	, m_maxDepth(0)
+{
+}
+
+bool Program::compile(const CalString& equ, std::string& message)
+{
+	m_expression = equ;
+	m_steps.clear();
+	Context::current().startEvaluation();
+	m_slots.clear();
+	m_depth = 0;
+	m_maxDepth = 0;
+
+	CalString tmp = equ;
+	Exec ex;
+	if (!ex.parse(tmp, message))
+	{
+		if (message.empty())
+		{
+			message = "Could not parse '";
+			message += equ;
+			message += "'";
+		}
+		return false;
+	}
+
+	for (const auto& it : ex.functions())
+	{
+		if (!it.compile(*this, message))
+			return false;
+	}
+
+	if ((m_depth == 0) && !m_steps.empty())
+	{
+		message = "Expression '";
+		message += equ;
+		message += "' has no results";
+		return false;
+	}
+	return true;
+}
+
+void Program::addNumber(const Num& no)
+{
+	ProgramStep step{STEP_NUMBER, -1, no, Functions{"", F_NOP, MODE_NORMAL, nullptr}};
+
+	if (no.isVar() && !no.isConstant())
+	{
+		step.type = STEP_VARIABLE;
+		step.slot = findSlot(no.varName());
+		if (step.slot < 0)
+		{
+			step.slot = static_cast<int>(m_slots.size());
+			m_slots.push_back(no.varName());
+		}
+	}
+
+	// Steps never look up variables when run (see Num::confirm())
+	step.value.m_type &= ~(NUM_VAR | NUM_VAR_UNSET);
+
+	m_steps.push_back(step);
+
+	m_depth++;
+	if (m_depth > m_maxDepth)
+		m_maxDepth = m_depth;
+}
+
+bool Program::addFunction(const Functions& fn, std::string& message)
+{
+	if ((fn.f == nullptr) || (fn.mode == MODE_ASSIGN))
+	{
+		message = "Function '";
+		message += fn.str;
+		message += "' cannot be used in a compiled expression";
+		return false;
+	}
+
+	// Number of arguments taken off the stack and results pushed back
+	size_t args = arguments(fn);
+	size_t results = (fn.type == F_RESULT) ? 0 : 1;  // Clear stack (one number)
+
+	if (m_depth < args)
+	{
+		message = "Function '";
+		message += fn.str;
+		message += "' - missing parameter";
+		return false;
+	}
+	m_depth = m_depth - args + results;
+
+	m_steps.push_back(ProgramStep{STEP_FUNCTION, -1, Num(), fn});
+	return true;
+}
+
+// static
+size_t Program::arguments(const Functions& fn)
+{
+	if ((fn.mode == MODE_BINARY) || (fn.mode == MODE_CONVERT))
+		return 2;
+	if (fn.type == F_SELECT)
+		return 3;
+	if (Plugins::isPlugin(fn.type))
+		return Plugins::function(fn.type).arity;
+	return 1;
+}
+
+std::vector<std::string> Program::unsetVariables() const
+{
+	std::vector<std::string> names;
+	for (const auto& name : m_slots)
+	{
+		ConstantVars var{"", 0., NUM_DEFAULT, UNIT_NUMBER, ""};
+		int len = -1;
+		if (!Num::isVariable(name, len, var) || (len != static_cast<int>(name.size())))
+		{
+			names.push_back(name);
+		}
+	}
+	return names;
+}
+
+int Program::findSlot(const std::string& varName) const
+{
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		if (m_slots[i] == varName)
+			return static_cast<int>(i);
+	}
+	return -1;
+}
+
+bool Program::resolve(const std::vector<std::string>& inputs, std::string& message)
+{
+	for (auto& it : m_steps)
+	{
+		if (it.type != STEP_VARIABLE)
+			continue;
+
+		const std::string& name = m_slots[it.slot];
+		int slot = -1;
+		for (size_t i = 0; (slot < 0) && (i < inputs.size()); i++)
+		{
+			if (inputs[i] == name)
+				slot = static_cast<int>(i);
+		}
+
+		if (slot >= 0)
+		{
+			it.slot = slot;
+			continue;
+		}
+
+		// Not an input - must be a variable with a value
+		ConstantVars var{"", 0., NUM_DEFAULT, UNIT_NUMBER, ""};
+		int len = -1;
+		if (!Num::isVariable(name, len, var) || (len != static_cast<int>(name.size())))
+		{
+			message = "Variable '";
+			message += name;
+			message += "' has no input or value";
+			return false;
+		}
+
+		Num no(var);
+		no.m_type &= ~(NUM_VAR | NUM_VAR_UNSET);
+		if (!it.value.m_unit.keyString().empty())
+		{
+			// Units given in the expression override saved units
+			no.m_unit = it.value.m_unit;
+		}
+		it.type = STEP_NUMBER;
+		it.slot = -1;
+		it.value = no;
+	}
+
+	m_slots = inputs;
+	return true;
+}
+
+bool Program::run(const Num* values, NumStack& stack, std::string& message) const
+{
+	stack.clear();
+
+	Context& context = Context::current();
+	context.startBudget();
+	if ((context.budget().maxDepth != 0) && (m_maxDepth > context.budget().maxDepth))
+	{
+		context.exceed(FNC_LIMIT_DEPTH);
+		message = context.exceededMessage();
+		return false;
+	}
+
+	for (const auto& it : m_steps)
+	{
+		switch (it.type)
+		{
+		case STEP_NUMBER:
+			stack.push_back(it.value);
+			break;
+
+		case STEP_VARIABLE:
+			{
+				const Num& inp = values[it.slot];
+				stack.push_back(it.value);
+				Num& no = stack.back();
+				no.m_complex = inp.m_complex;
+				no.m_type = inp.m_type;
+				if (!inp.m_unit.keyString().empty())
+				{
+					no.m_unit = inp.m_unit;
+				}
+			}
+			break;
+
+		case STEP_FUNCTION:
+			if (!context.spend(stack.size()))
+			{
+				message = context.exceededMessage();
+				return false;
+			}
+
+			// Stack depth was checked when compiled
+			if (!(*it.func.f)(stack))
+			{
+				message = "Function '";
+				message += it.func.str;
+				message += "' failed";
+				return false;
+			}
+			break;
+		}
+	}
+
+	if (stack.empty())
+	{
+		message = "No results";
+		return false;
+	}
+	return true;
+}
+
+bool Program::run(const Num* values, Num& result, std::string& message) const
+{
+	NumStack stack;
+	stack.reserve(m_maxDepth);
+	if (!run(values, stack, message))
+		return false;
+
+	result = stack.back();
+	return true;
+}
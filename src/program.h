@@ -0,0 +1,121 @@
+/// @file
+///
+/// @brief Header file for Program - expression compiled into a list of steps.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include "num.h"
+#include "functions.h"
+
+#include "calstring.h"
+
+/// @brief Program step types
+enum StepType : uint8_t
+{
+	STEP_NUMBER = 0,  // Push a constant number
+	STEP_VARIABLE,    // Push a value from an input slot
+	STEP_FUNCTION     // Run function on the stack
+};
+
+/// @brief Single step of a compiled program
+typedef struct _programStep
+{
+	StepType  type;
+	int       slot;   // Input slot (STEP_VARIABLE)
+	Num       value;  // Constant - or units/format template of a variable
+	Functions func;   // Function to run (STEP_FUNCTION)
+} ProgramStep;
+
+// How Program works:
+// Exec parses an expression into a tree of Func objects and runs the tree
+// recursively (copying it as it goes). Program flattens the same tree once
+// into steps, in the order Func::run() pushes numbers and runs functions.
+// Variables become input "slots", so the same expression can be run for
+// many values (batch mode) without being parsed again. Programs are not
+// interactive - a variable without a value is an error, not a prompt.
+
+class Program
+{
+public:
+	Program();
+
+	/// @brief Parses expression and flattens it into steps.
+	/// NOTE: Expression with only variable definitions (ex. "x=2") has no steps
+	/// @return false if parsing failed or expression cannot be compiled
+	bool compile(const CalString& equ, std::string& message);
+
+	/// @brief Program has no steps (see compile())
+	bool empty() const { return m_steps.empty(); }
+
+	/// @brief Assigns input slots in the order of 'inputs'.
+	/// Variables not in 'inputs' are taken from the variable list (as constants).
+	/// @return false if a variable has no input and no value
+	bool resolve(const std::vector<std::string>& inputs, std::string& message);
+
+	/// @brief Runs program - 'values' holds one number per slot.
+	/// Results are left on the stack (last one is the result).
+	bool run(const Num* values, NumStack& stack, std::string& message) const;
+
+	/// @brief Runs program and returns last result
+	bool run(const Num* values, Num& result, std::string& message) const;
+
+	/// @brief Number of input slots
+	size_t slots() const { return m_slots.size(); }
+
+	/// @brief Name of variable in slot
+	const std::string& slotName(const size_t slot) const { return m_slots[slot]; }
+
+	/// @brief Returns slot of variable - -1 if not used
+	int findSlot(const std::string& varName) const;
+
+	/// @brief Slot variables that have no value (yet), in order of the expression
+	std::vector<std::string> unsetVariables() const;
+
+	/// @brief Stack size needed to run
+	size_t depth() const { return m_maxDepth; }
+
+	const CalString& expression() const { return m_expression; }
+
+	/// @brief Steps in the order they run (see BlockProgram)
+	const std::vector<ProgramStep>& steps() const { return m_steps; }
+
+	/// @brief Adds number (or variable) - used by Func::compile()
+	void addNumber(const Num& no);
+
+	/// @brief Numbers function takes off the stack
+	static size_t arguments(const Functions& fn);
+
+	/// @brief Adds function - used by Func::compile()
+	bool addFunction(const Functions& fn, std::string& message);
+
+private:
+	CalString m_expression;
+
+	std::vector<ProgramStep> m_steps;
+
+	// Variable names of slots
+	std::vector<std::string> m_slots;
+
+	// Stack depth while compiling and maximum used
+	size_t m_depth;
+	size_t m_maxDepth;
+};
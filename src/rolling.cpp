@@ -0,0 +1,127 @@
+/// @file
+///
+/// @brief Implementation of Rolling - stateful window operators of stream mode.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "rolling.h"
+
+// static
+thread_local RollingState* RollingState::s_current {nullptr};
+
+RollingOp::RollingOp(const RollingKind kind, const double param)
+	: m_kind(kind)
+	, m_param(param)
+	, m_index(0)
+	, m_last(NAN)
+{
+	if (kind == ROLL_SMA)
+	{
+		m_ring.resize(static_cast<size_t>(param));
+	}
+}
+
+double RollingOp::update(const double value)
+{
+	if (std::isnan(value))
+		return NAN;
+
+	const size_t window = static_cast<size_t>(m_param);
+	double result = value;
+	switch (m_kind)
+	{
+	case ROLL_SMA:
+		{
+			// Until the window is full, the average of the values so far
+			double& slot = m_ring[m_index % window];
+			if (m_index >= window)
+			{
+				m_sum.add(-slot);
+			}
+			slot = value;
+			m_sum.add(value);
+			result = m_sum.value() / static_cast<double>(std::min<uint64_t>(m_index + 1, window));
+		}
+		break;
+
+	case ROLL_EMA:
+		result = (m_index == 0) ? value : m_last + (m_param * (value - m_last));
+		m_last = result;
+		break;
+
+	case ROLL_MIN:
+	case ROLL_MAX:
+		{
+			bool isMin = (m_kind == ROLL_MIN);
+			while (!m_deque.empty() && (isMin ? (m_deque.back().second >= value) : (m_deque.back().second <= value)))
+			{
+				m_deque.pop_back();
+			}
+			m_deque.emplace_back(m_index, value);
+			if ((m_index - m_deque.front().first) >= window)
+			{
+				m_deque.pop_front();
+			}
+			result = m_deque.front().second;
+		}
+		break;
+
+	case ROLL_DELTA:
+		result = value - m_last;
+		m_last = value;
+		break;
+
+	default:
+		break;
+	}
+
+	m_index++;
+	return result;
+}
+
+
+RollingState::RollingState()
+	: m_used{}
+{
+}
+
+void RollingState::beginLine()
+{
+	for (auto& it : m_used)
+	{
+		it = 0;
+	}
+}
+
+RollingOp& RollingState::next(const RollingKind kind, const double param)
+{
+	std::vector<std::unique_ptr<RollingOp> >& ops = m_ops[kind];
+	size_t index = m_used[kind]++;
+	if (index >= ops.size())
+	{
+		ops.emplace_back(new RollingOp(kind, param));
+	}
+	else if (ops[index]->param() != param)
+	{
+		ops[index].reset(new RollingOp(kind, param));
+	}
+	return *ops[index];
+}
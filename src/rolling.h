@@ -0,0 +1,100 @@
+/// @file
+///
+/// @brief Header file for Rolling - stateful window operators of stream mode.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "aggregate.h"
+
+/// @brief Rolling operators
+enum RollingKind : uint8_t
+{
+	ROLL_SMA = 0,  // Simple moving average of the last N values
+	ROLL_EMA,      // Exponential moving average (alpha)
+	ROLL_MIN,      // Minimum of the last N values
+	ROLL_MAX,      // Maximum of the last N values
+	ROLL_DELTA,    // Difference from previous value
+	ROLL_KINDS
+};
+
+/// @brief State of one rolling operator - every update is O(1) (amortized)
+class RollingOp
+{
+public:
+	RollingOp(const RollingKind kind, const double param);
+
+	/// @brief Adds value and returns the operator's result (NaN is not added)
+	double update(const double value);
+
+	RollingKind kind() const { return m_kind; }
+
+	double param() const { return m_param; }
+
+private:
+	RollingKind m_kind;
+	double m_param;
+	uint64_t m_index;  // Values added
+
+	// SMA - ring buffer of the window and its (compensated) sum
+	std::vector<double> m_ring;
+	CompensatedSum m_sum;
+
+	// Min/max - monotonic deque of (index, value): the front is the result,
+	// values that can never be the result again are dropped from the back
+	std::deque<std::pair<uint64_t, double> > m_deque;
+
+	// EMA and delta
+	double m_last;
+};
+
+// How rolling operators keep state:
+// Each line of a stream is a separate expression, so operators are matched by
+// position - the n-th 'sma' of a line continues the n-th 'sma' of the lines
+// before it. A different window (or alpha) starts a new state. Stream sets
+// the state of its evaluate thread (current()) and calls beginLine() before
+// every line. Anywhere else current() is nullptr and the functions fail.
+
+class RollingState
+{
+public:
+	RollingState();
+
+	/// @brief Next line - operators are counted from the first again
+	void beginLine();
+
+	/// @brief State of the next operator of 'kind' on this line
+	RollingOp& next(const RollingKind kind, const double param);
+
+	/// @brief State of this thread (nullptr outside stream mode)
+	static RollingState* current() { return s_current; }
+
+	static void setCurrent(RollingState* state) { s_current = state; }
+
+private:
+	std::vector<std::unique_ptr<RollingOp> > m_ops[ROLL_KINDS];
+	size_t m_used[ROLL_KINDS];
+
+	static thread_local RollingState* s_current;
+};
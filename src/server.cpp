@@ -0,0 +1,417 @@
+/// @file
+///
+/// @brief Implementation of Server and Client - evaluations served over a local (Unix) socket.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <exception>
+
+#ifndef _MSC_VER
+ #include <poll.h>
+ #include <unistd.h>
+ #include <sys/socket.h>
+ #include <sys/un.h>
+#endif
+
+#include "server.h"
+#include "binaryIO.h"
+#include "console.h"
+#include "expressionCache.h"
+
+/// @brief Largest request or reply - larger frames close the connection
+constexpr uint32_t MAX_FRAME_SIZE {1 << 20};
+
+/// @brief Compiled programs kept per connection - the cache is emptied when full
+constexpr size_t SERVER_CACHE_ENTRIES {4096};
+
+/// @brief How often the server checks for a stop signal (ms)
+constexpr int SERVER_POLL_MS {200};
+
+#ifdef _MSC_VER
+
+Server::Server(const std::string& path)
+	: m_path(path)
+	, m_listenFd(-1)
+{
+}
+
+Server::~Server()
+{
+}
+
+bool Server::run(std::string& message)
+{
+	message = "Server mode is not available on this platform";
+	return false;
+}
+
+Client::Client(const std::string& path)
+	: m_path(path)
+	, m_fd(-1)
+{
+}
+
+Client::~Client()
+{
+}
+
+bool Client::open(std::string& message)
+{
+	message = "Client mode is not available on this platform";
+	return false;
+}
+
+bool Client::request(const std::string& expression, bool& ok, std::string& result, std::string& message)
+{
+	message = "Client mode is not available on this platform";
+	return false;
+}
+
+#else
+
+static volatile sig_atomic_t s_stop = 0;
+
+static void stopServer(int)
+{
+	s_stop = 1;
+}
+
+/// @brief Writes all bytes (retries short writes)
+static bool writeAll(const int fd, const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t written = write(fd, data, size);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		data += written;
+		size -= static_cast<size_t>(written);
+	}
+	return true;
+}
+
+/// @brief Reads exactly 'size' bytes - false at end of connection or error
+static bool readAll(const int fd, char* data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t got = read(fd, data, size);
+		if (got < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		if (got == 0)
+			return false;
+		data += got;
+		size -= static_cast<size_t>(got);
+	}
+	return true;
+}
+
+bool writeFrame(const int fd, const std::string& payload)
+{
+	uint32_t size = static_cast<uint32_t>(payload.size());
+	std::string frame;
+	frame.reserve(sizeof(size) + payload.size());
+	for (size_t i = 0; i < sizeof(size); i++)
+	{
+		frame.push_back(static_cast<char>((size >> (8 * i)) & 0xff));
+	}
+	frame += payload;
+	return writeAll(fd, frame.data(), frame.size());
+}
+
+bool readFrame(const int fd, std::string& payload)
+{
+	char header[sizeof(uint32_t)];
+	if (!readAll(fd, header, sizeof(header)))
+		return false;
+
+	uint32_t size = readRaw32(header);
+	if (size > MAX_FRAME_SIZE)
+		return false;
+
+	payload.resize(size);
+	return (size == 0) || readAll(fd, &payload[0], size);
+}
+
+/// @brief Socket address of path
+static bool socketAddress(const std::string& path, sockaddr_un& address, std::string& message)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.empty() || (path.size() >= sizeof(address.sun_path)))
+	{
+		message = "Socket path '" + path + "' is empty or too long";
+		return false;
+	}
+	memcpy(address.sun_path, path.c_str(), path.size());
+	return true;
+}
+
+Server::Server(const std::string& path)
+	: m_path(path)
+	, m_listenFd(-1)
+{
+}
+
+Server::~Server()
+{
+	reap(true);
+	if (m_listenFd >= 0)
+	{
+		close(m_listenFd);
+		unlink(m_path.c_str());
+	}
+}
+
+bool Server::run(std::string& message)
+{
+	sockaddr_un address;
+	if (!socketAddress(m_path, address, message))
+		return false;
+
+	m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_listenFd < 0)
+	{
+		message = "Cannot create socket";
+		return false;
+	}
+
+	if (bind(m_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+	{
+		// A socket nobody answers on is left from a server that did not stop
+		bool inUse = (errno == EADDRINUSE);
+		int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+		bool answered = (probe >= 0)
+			&& (connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+		if (probe >= 0)
+		{
+			close(probe);
+		}
+		if (!inUse || answered || (unlink(m_path.c_str()) != 0)
+			|| (bind(m_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0))
+		{
+			message = answered ? "A server is running on '" + m_path + "'" : "Cannot bind '" + m_path + "'";
+			close(m_listenFd);
+			m_listenFd = -1;
+			return false;
+		}
+	}
+
+	if (listen(m_listenFd, SOMAXCONN) < 0)
+	{
+		message = "Cannot listen on '" + m_path + "'";
+		return false;
+	}
+
+	s_stop = 0;
+	signal(SIGINT, stopServer);
+	signal(SIGTERM, stopServer);
+	signal(SIGPIPE, SIG_IGN);
+
+	// Connections start from the settings of the server - without its console
+	Context context = Context::current();
+	context.setOutput(FncOutput());
+	context.setInput(FncInput());
+
+	while (!s_stop)
+	{
+		pollfd fds {m_listenFd, POLLIN, 0};
+		int ready = poll(&fds, 1, SERVER_POLL_MS);
+		reap(false);
+		if (ready <= 0)
+			continue;
+
+		int fd = accept(m_listenFd, nullptr, nullptr);
+		if (fd < 0)
+			continue;
+
+		m_connections.emplace_back();
+		Connection& connection = m_connections.back();
+		connection.fd = fd;
+		connection.done = false;
+		connection.thread = std::thread(&Server::serve, this, &connection, context);
+	}
+	return true;
+}
+
+void Server::serve(Connection* connection, const Context& context)
+{
+	Context::current() = context;
+
+	std::unordered_map<std::string, Program> cache;
+	std::string request;
+	std::string reply;
+	while (readFrame(connection->fd, request))
+	{
+		try
+		{
+			evaluate(cache, request, reply);
+		}
+		catch (const std::exception& e)
+		{
+			// Fails the request - not the server
+			cache.clear();
+			reply = std::string(1, static_cast<char>(REPLY_FAILED)) + e.what();
+		}
+		if (!writeFrame(connection->fd, reply))
+			break;
+	}
+	connection->done = true;
+}
+
+// static
+void Server::evaluate(std::unordered_map<std::string, Program>& cache,
+	const std::string& request, std::string& reply)
+{
+	std::string message;
+	Program compiled;
+	const Program* program = nullptr;
+
+	auto found = cache.find(request);
+	if (found != cache.end())
+	{
+		program = &found->second;
+	}
+	else
+	{
+		Context& context = Context::current();
+		uint64_t version = context.variablesVersion();
+		Console::clearLastLine();
+		if (!ExpressionCache::shared().compile(request, compiled, message) || !compiled.resolve(std::vector<std::string>(), message))
+		{
+			if (!Console::lastLine().empty())
+			{
+				message += " - " + Console::lastLine();
+			}
+			reply = std::string(1, static_cast<char>(REPLY_FAILED)) + message;
+			return;
+		}
+
+		if (context.variablesVersion() != version)
+		{
+			// Definitions - cached programs may hold old values
+			cache.clear();
+			program = &compiled;
+		}
+		else
+		{
+			if (cache.size() >= SERVER_CACHE_ENTRIES)
+			{
+				cache.clear();
+			}
+			program = &cache.emplace(request, std::move(compiled)).first->second;
+		}
+	}
+
+	reply = std::string(1, static_cast<char>(REPLY_OK));
+	if (program->empty())
+		return;
+
+	Num result;
+	Console::clearLastLine();
+	if (!program->run(nullptr, result, message))
+	{
+		if (!Console::lastLine().empty())
+		{
+			message += " - " + Console::lastLine();
+		}
+		reply = std::string(1, static_cast<char>(REPLY_FAILED)) + message;
+		return;
+	}
+	reply += result.asString();
+}
+
+void Server::reap(const bool all)
+{
+	for (auto it = m_connections.begin(); it != m_connections.end(); )
+	{
+		if (all && !it->done)
+		{
+			// Wakes the connection thread from its read
+			shutdown(it->fd, SHUT_RDWR);
+		}
+		if (all || it->done)
+		{
+			it->thread.join();
+			close(it->fd);
+			it = m_connections.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+Client::Client(const std::string& path)
+	: m_path(path)
+	, m_fd(-1)
+{
+}
+
+Client::~Client()
+{
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+	}
+}
+
+bool Client::open(std::string& message)
+{
+	sockaddr_un address;
+	if (!socketAddress(m_path, address, message))
+		return false;
+
+	m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ((m_fd < 0) || (connect(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0))
+	{
+		message = "Cannot connect to server on '" + m_path + "' - start it with 'fnc --serve " + m_path + "'";
+		return false;
+	}
+
+	// A server that stops makes writes fail - not the process
+	signal(SIGPIPE, SIG_IGN);
+	return true;
+}
+
+bool Client::request(const std::string& expression, bool& ok, std::string& result, std::string& message)
+{
+	std::string reply;
+	if (!writeFrame(m_fd, expression) || !readFrame(m_fd, reply) || reply.empty())
+	{
+		message = "Connection to server failed";
+		return false;
+	}
+
+	ok = (static_cast<uint8_t>(reply[0]) == REPLY_OK);
+	result = reply.substr(1);
+	return true;
+}
+
+#endif
@@ -0,0 +1,120 @@
+/// @file
+///
+/// @brief Header for Server and Client - evaluations served over a local (Unix) socket.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "context.h"
+#include "program.h"
+
+/// @brief Status byte of a reply
+enum ReplyStatus : uint8_t
+{
+	REPLY_OK = 0,     // Result follows (empty for definitions only)
+	REPLY_FAILED = 1  // Message follows
+};
+
+// How Server works:
+// 'fnc --serve <path>' listens on a Unix socket; every connection gets a
+// thread and its own Context, copied from the server's (INI settings are read
+// once, at start). Requests and replies are frames: a 32-bit little-endian
+// length, then the bytes. A request is one expression (as a line of stream
+// mode - "x=2" defines x for the connection); the reply is a status byte
+// (ReplyStatus) and the result as fnc writes it, or the message.
+// Compiled programs are cached per connection by expression text (parsed
+// ones are also shared by all connections - see ExpressionCache). Values of
+// variables are part of a compiled program, so a request that changes a
+// variable empties the connection's cache. The server stops on SIGINT or SIGTERM and
+// removes its socket. POSIX only.
+
+class Server
+{
+public:
+	explicit Server(const std::string& path);
+
+	~Server();
+
+	/// @brief Serves until stopped by a signal
+	bool run(std::string& message);
+
+private:
+	Server(const Server&) = delete;
+	Server& operator=(const Server&) = delete;
+
+	typedef struct _connection
+	{
+		int fd;
+		std::thread thread;
+		std::atomic<bool> done;
+	} Connection;
+
+	/// @brief Answers requests of a connection until it closes
+	void serve(Connection* connection, const Context& context);
+
+	/// @brief Evaluates request - reply is the status byte and text
+	static void evaluate(std::unordered_map<std::string, Program>& cache,
+		const std::string& request, std::string& reply);
+
+	/// @brief Joins threads of closed connections (all if 'all' - they are closed first)
+	void reap(const bool all);
+
+	std::string m_path;
+	int m_listenFd;
+	std::list<Connection> m_connections;
+};
+
+// How Client works:
+// 'fnc --client <path> "<expression>"' sends the expression to a server and
+// writes the result as 'fnc --stream' would. Without an expression, every
+// line of stdin is sent (one connection, so definitions carry over).
+
+class Client
+{
+public:
+	explicit Client(const std::string& path);
+
+	~Client();
+
+	/// @brief Connects to server
+	bool open(std::string& message);
+
+	/// @brief Sends expression and waits for the reply
+	/// @return false if the connection failed ('ok' is false if the expression failed)
+	bool request(const std::string& expression, bool& ok, std::string& result, std::string& message);
+
+private:
+	Client(const Client&) = delete;
+	Client& operator=(const Client&) = delete;
+
+	std::string m_path;
+	int m_fd;
+};
+
+/// @brief Writes frame (length and bytes) - false if the connection failed
+bool writeFrame(const int fd, const std::string& payload);
+
+/// @brief Reads frame - false at end of connection, if it failed or the frame is too large
+bool readFrame(const int fd, std::string& payload);
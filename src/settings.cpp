@@ -0,0 +1,330 @@
+/// @file
+///
+/// @brief Implementation of Settings - INI settings and unit tables evaluations use.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <fstream>
+#include <mutex>
+
+#include "settings.h"
+#include "context.h"
+#include "expressionCache.h"
+#include "iniParser.h"
+
+/// @brief Fields of a unit line - unit, key, parsed, type, displayed, description
+constexpr size_t UNIT_FIELDS {6};
+
+/// @brief Fields of a conversion line - conv, type, from, to, formula
+constexpr size_t CONVERSION_FIELDS {5};
+
+std::atomic<uint64_t> Settings::s_version {0};
+
+/// @brief Names of unit types in units files
+static const std::unordered_map<std::string, UnitType> s_unitTypes
+{
+	{"number", UNIT_NUMBER},
+	{"angle", UNIT_ANGLE},
+	{"memory", UNIT_MEMORY},
+	{"temperature", UNIT_TEMPERATURE},
+	{"length", UNIT_LENGTH},
+	{"area", UNIT_AREA},
+	{"volume", UNIT_VOLUME},
+	{"frequency", UNIT_FREQUENCY},
+	{"wavelength", UNIT_WAVELENGTH},
+	{"speed", UNIT_SPEED},
+	{"acceleration", UNIT_ACCELERATION},
+	{"mass", UNIT_MASS},
+	{"force", UNIT_FORCE},
+	{"energy", UNIT_ENERGY},
+	{"work", UNIT_WORK},
+	{"pressure", UNIT_PRESSURE},
+	{"voltage", UNIT_VOLTAGE},
+	{"current", UNIT_CURRENT},
+	{"resistance", UNIT_RESISTANCE},
+	{"capacitance", UNIT_CAPACITANCE},
+	{"inductance", UNIT_INDUCTANCE},
+	{"time", UNIT_TIME},
+};
+
+/// @brief Published snapshot - read and written with std::atomic_load/store
+static std::shared_ptr<const Settings>& published()
+{
+	static std::shared_ptr<const Settings> s_published = std::make_shared<const Settings>();
+	return s_published;
+}
+
+/// @brief Key of a resolved conversion
+static std::string conversionKey(const std::string& from, const std::string& to, const UnitType type)
+{
+	return from + ">" + to + ":" + std::to_string(type);
+}
+
+/// @brief First unit with key 'key' - nullptr if none
+static const UnitDefs* findUnit(const std::vector<UnitDefs>& units, const std::string& key)
+{
+	for (auto& it : units)
+	{
+		if (it.unitKey == key)
+			return &it;
+	}
+	return nullptr;
+}
+
+/// @brief Splits line at ',' into at most 'count' trimmed fields (the last
+/// one keeps the rest of the line)
+static std::vector<std::string> splitFields(const std::string& line, const size_t count)
+{
+	std::vector<std::string> fields;
+	size_t start = 0;
+	while (start <= line.size())
+	{
+		size_t end = (fields.size() + 1 < count) ? line.find(',', start) : std::string::npos;
+		if (end == std::string::npos)
+		{
+			end = line.size();
+		}
+		std::string field = line.substr(start, end - start);
+		size_t first = field.find_first_not_of(" \t\r");
+		size_t last = field.find_last_not_of(" \t\r");
+		fields.push_back(first == std::string::npos ? std::string() : field.substr(first, last - first + 1));
+		start = end + 1;
+	}
+	return fields;
+}
+
+/// @brief Paths of a list separated by ':'
+static std::vector<std::string> splitPaths(const std::string& list)
+{
+	std::vector<std::string> paths;
+	size_t start = 0;
+	while (start < list.size())
+	{
+		size_t end = list.find(':', start);
+		if (end == std::string::npos)
+		{
+			end = list.size();
+		}
+		paths.push_back(list.substr(start, end - start));
+		start = end + 1;
+	}
+	return paths;
+}
+
+/// @brief Relative 'path' is in the directory of the INI file
+static std::string nextTo(const std::string& iniPath, const std::string& path)
+{
+	size_t slash = iniPath.find_last_of('/');
+	if ((path[0] == '/') || (slash == std::string::npos))
+		return path;
+
+	return iniPath.substr(0, slash + 1) + path;
+}
+
+Settings::Settings()
+	: m_version{0}
+	, m_fromIni{false}
+	, m_ini{"deg", true, true, "", ""}
+	, m_units(NumUnit::s_units)
+	, m_conversions(NumUnit::s_conversions)
+{
+	// Built-in formulas resolve
+	std::string message;
+	resolve(m_units, m_conversions, m_resolved, message);
+	findAngles();
+}
+
+bool Settings::load(const std::string& iniPath, std::string& message)
+{
+	if (!IniParser::exists(iniPath))
+	{
+		message = "INI file '" + iniPath + "' not found";
+		return false;
+	}
+
+	std::string path = iniPath;
+	IniParser ini(path);
+	if (!ini.wasRead())
+	{
+		message = "INI file '" + iniPath + "' cannot be read";
+		return false;
+	}
+
+	m_fromIni = true;
+	m_ini.defaultAngle = ini.getString("Number.Angle", "deg");
+	m_ini.showUndefinedVarMsg = ini.getBool("Exec.UndefinedMsg", true);
+	m_ini.quitMsgFirstTime = ini.getBool("Exec.quitMsg", true);
+	m_ini.unitsFile = ini.has("Units.File") ? ini.getString("Units.File", "") : std::string();
+	m_ini.plugins = ini.has("Plugins.Load") ? ini.getString("Plugins.Load", "") : std::string();
+
+	for (const auto& it : splitPaths(m_ini.plugins))
+	{
+		if (!it.empty())
+		{
+			m_pluginPaths.push_back(nextTo(iniPath, it));
+		}
+	}
+
+	if (m_ini.unitsFile.empty())
+		return true;
+
+	m_unitsPath = nextTo(iniPath, m_ini.unitsFile);
+	return loadUnits(m_unitsPath, message);
+}
+
+bool Settings::loadUnits(const std::string& path, std::string& message)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		message = "Units file '" + path + "' cannot be read";
+		return false;
+	}
+
+	std::vector<UnitDefs> units;
+	std::vector<ConversionFunction> conversions;
+	std::string line;
+	size_t lineNo = 0;
+	while (std::getline(file, line))
+	{
+		lineNo++;
+		line = line.substr(0, line.find('#'));
+		std::vector<std::string> fields = splitFields(line, UNIT_FIELDS);
+		if ((fields.size() == 1) && fields[0].empty())
+			continue;
+
+		std::string kind = fields[0];
+		if (kind == "conv")
+		{
+			fields = splitFields(line, CONVERSION_FIELDS);
+		}
+
+		bool ok = ((kind == "unit") && (fields.size() == UNIT_FIELDS))
+			|| ((kind == "conv") && (fields.size() == CONVERSION_FIELDS));
+		auto type = s_unitTypes.end();
+		if (ok)
+		{
+			type = s_unitTypes.find(fields[(kind == "unit") ? 3 : 1]);
+			ok = (type != s_unitTypes.end()) && !fields[1].empty() && !fields[2].empty();
+		}
+		if (!ok)
+		{
+			message = "Units file '" + path + "' line " + std::to_string(lineNo)
+				+ " - expected 'unit, <key>, <parsed>, <type>, <displayed>, <description>'"
+				+ " or 'conv, <type>, <from>, <to>, <formula>'";
+			return false;
+		}
+
+		if (kind == "unit")
+		{
+			units.push_back({fields[1], fields[2], type->second, NUM_DOUBLE, fields[4], fields[5]});
+		}
+		else
+		{
+			conversions.push_back({type->second, fields[2], fields[3], CalString(fields[4])});
+		}
+	}
+
+	units.insert(units.end(), m_units.begin(), m_units.end());
+	conversions.insert(conversions.end(), m_conversions.begin(), m_conversions.end());
+
+	std::unordered_map<std::string, UnitConversion> resolved;
+	if (!resolve(units, conversions, resolved, message))
+	{
+		message = "Units file '" + path + "' - " + message;
+		return false;
+	}
+
+	m_units.swap(units);
+	m_conversions.swap(conversions);
+	m_resolved.swap(resolved);
+	findAngles();
+	return true;
+}
+
+const UnitConversion* Settings::findConversion(const NumUnit& from, const NumUnit& to) const
+{
+	if ((from.unitType() != UNIT_NUMBER) && (from.unitType() != to.unitType()))
+		return nullptr;
+
+	auto it = m_resolved.find(conversionKey(from.keyString(), to.keyString(), to.unitType()));
+	return (it == m_resolved.end()) ? nullptr : &it->second;
+}
+
+bool Settings::resolve(const std::vector<UnitDefs>& units, const std::vector<ConversionFunction>& conversions,
+	std::unordered_map<std::string, UnitConversion>& resolved, std::string& message) const
+{
+	// Formulas run on a context of their own - these settings are not
+	// published yet (the built-in ones are built by the first Context). No
+	// input: a formula with an unset variable fails.
+	Context scratch(std::shared_ptr<const Settings>(std::shared_ptr<const Settings>(), this));
+	scratch.setBudget({0, 0, 0, false});
+	Context* previous = Context::bind(&scratch);
+
+	bool ok = true;
+	for (auto& it : conversions)
+	{
+		// Units the parser does not know cannot be converted
+		const UnitDefs* from = findUnit(units, it.from);
+		const UnitDefs* to = findUnit(units, it.to);
+		if (!from || !to)
+			continue;
+
+		std::string key = conversionKey(it.from, it.to, it.type);
+		if (resolved.count(key) != 0)
+			continue;
+
+		UnitConversion conversion;
+		if (!conversion.resolve(it.formula, NumUnit(*from), NumUnit(*to), message))
+		{
+			ok = false;
+			break;
+		}
+		resolved.emplace(key, conversion);
+	}
+
+	Context::bind(previous);
+	return ok;
+}
+
+void Settings::findAngles()
+{
+	auto it = m_resolved.find(conversionKey("deg", "rad", UNIT_ANGLE));
+	m_toRads = (it == m_resolved.end()) ? UnitConversion() : it->second;
+	it = m_resolved.find(conversionKey("rad", "deg", UNIT_ANGLE));
+	m_fromRads = (it == m_resolved.end()) ? UnitConversion() : it->second;
+}
+
+// static
+std::shared_ptr<const Settings> Settings::current()
+{
+	return std::atomic_load(&published());
+}
+
+// static
+void Settings::publish(const std::shared_ptr<Settings>& settings)
+{
+	static std::mutex s_publisher;
+	std::lock_guard<std::mutex> lock(s_publisher);
+
+	settings->m_version = s_version.load() + 1;
+	std::atomic_store(&published(), std::shared_ptr<const Settings>(settings));
+	s_version.store(settings->m_version, std::memory_order_release);
+
+	// Programs compiled with the old units are not used again
+	ExpressionCache::shared().invalidate();
+}
@@ -0,0 +1,130 @@
+/// @file
+///
+/// @brief Header for Settings - INI settings and unit tables evaluations use.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "numUnit.h"
+
+/// @brief Values read from the INI file
+typedef struct _iniSettings
+{
+	std::string defaultAngle;   // Number.Angle
+	bool showUndefinedVarMsg;   // Exec.UndefinedMsg
+	bool quitMsgFirstTime;      // Exec.quitMsg
+	std::string unitsFile;      // Units.File - "" if none (relative to the INI file)
+	std::string plugins;        // Plugins.Load - shared objects separated by ':' (relative to the INI file)
+} IniSettings;
+
+// How Settings works:
+// INI settings, units and unit conversions are one immutable snapshot. The
+// process publishes one snapshot at a time (built-in units and default
+// settings to start with); a context takes the published one when an
+// evaluation starts (Context::startEvaluation()) and keeps it until the next,
+// so a reload never changes tables under an evaluation - it finishes on the
+// version it started with, and the old snapshot is freed with its last user.
+// Seeing whether a newer one is published is one atomic load.
+// Everything is built before it is published: units of the units file,
+// conversions resolved to scale and offset (see UnitConversion) - an
+// evaluation only looks them up.
+// Units file - one definition per line, fields separated by ',' ('#' starts
+// a comment). Its units and conversions come before the built-in ones, so
+// they replace built-ins of the same name:
+//   unit, <key>, <parsed>, <type>, <displayed>, <description>
+//   conv, <type>, <from key>, <to key>, <formula>   (ex. conv, length, mi, km, *1.609344)
+
+class Settings
+{
+public:
+	/// @brief Built-in units and conversions, default settings
+	Settings();
+
+	/// @brief Reads INI file and the units file it names. On failure units
+	/// stay built-in; settings keep what was read.
+	bool load(const std::string& iniPath, std::string& message);
+
+	/// @brief Adds units and conversions of 'path' (before the built-in ones)
+	bool loadUnits(const std::string& path, std::string& message);
+
+	/// @brief Counts published snapshots - 0 before the first publish()
+	uint64_t version() const { return m_version; }
+
+	/// @brief Settings were read from an INI file
+	bool fromIni() const { return m_fromIni; }
+
+	const IniSettings& ini() const { return m_ini; }
+
+	/// @brief Path of the units file load() read - "" if none
+	const std::string& unitsPath() const { return m_unitsPath; }
+
+	/// @brief Paths of the plugins load() read (see Plugins - loaded once, at startup)
+	const std::vector<std::string>& pluginPaths() const { return m_pluginPaths; }
+
+	/// @brief Units known to the parser - first match wins
+	const std::vector<UnitDefs>& units() const { return m_units; }
+
+	/// @brief Conversion formulas - first match wins
+	const std::vector<ConversionFunction>& conversions() const { return m_conversions; }
+
+	/// @brief Conversion between different units - nullptr if none
+	const UnitConversion* findConversion(const NumUnit& from, const NumUnit& to) const;
+
+	/// @brief Degrees to radians and back (trig functions in the default angle)
+	const UnitConversion& toRads() const { return m_toRads; }
+
+	const UnitConversion& fromRads() const { return m_fromRads; }
+
+	/// @brief Snapshot evaluations start with
+	static std::shared_ptr<const Settings> current();
+
+	/// @brief Version of current() - tells a context its snapshot is old
+	static uint64_t currentVersion() { return s_version.load(std::memory_order_acquire); }
+
+	/// @brief Makes 'settings' current for evaluations that start from now
+	/// on (compiled expressions are cleared - they are bound to the old units)
+	static void publish(const std::shared_ptr<Settings>& settings);
+
+private:
+	// Resolves formulas of 'conversions' between 'units' to scale and offset
+	bool resolve(const std::vector<UnitDefs>& units, const std::vector<ConversionFunction>& conversions,
+		std::unordered_map<std::string, UnitConversion>& resolved, std::string& message) const;
+
+	// Takes the deg<->rad pair out of m_resolved
+	void findAngles();
+
+	uint64_t m_version;
+	bool m_fromIni;
+	IniSettings m_ini;
+	std::string m_unitsPath;
+	std::vector<std::string> m_pluginPaths;
+	std::vector<UnitDefs> m_units;
+	std::vector<ConversionFunction> m_conversions;
+	std::unordered_map<std::string, UnitConversion> m_resolved;  // "<from>><to>:<type>" keys
+	UnitConversion m_toRads;
+	UnitConversion m_fromRads;
+
+	static std::atomic<uint64_t> s_version;
+};
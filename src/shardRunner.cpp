@@ -0,0 +1,232 @@
+/// @file
+///
+/// @brief Implementation of ShardRunner - batch input split across worker processes.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+#include <iostream>
+
+#ifndef _MSC_VER
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/wait.h>
+#endif
+
+#include "shardRunner.h"
+
+// Bytes copied at once when merging results
+constexpr size_t SHARD_COPY_SIZE {1 << 20};
+
+ShardRunner::ShardRunner(const BatchOptions& options, const size_t processes)
+	: m_options(options)
+	, m_processes(processes)
+	, m_exitCode(0)
+{
+}
+
+#ifdef _MSC_VER
+
+bool ShardRunner::run(std::string& message)
+{
+	message = "Worker processes are not available on this platform";
+	return false;
+}
+
+#else
+
+bool ShardRunner::run(std::string& message)
+{
+	if (m_options.rawInputs.empty() && m_options.inputFile.empty())
+	{
+		message = "Shards need an input file";
+		return false;
+	}
+
+	// Bad expressions fail once - not in every worker
+	Program program;
+	if (!program.compile(m_options.expression, message))
+		return false;
+
+	// Results of each worker - unlinked, so nothing is left behind
+	const char* tmpDir = getenv("TMPDIR");
+	std::string pattern = std::string((tmpDir != nullptr) && (*tmpDir != 0) ? tmpDir : "/tmp") + "/fnc-shard-XXXXXX";
+	std::vector<int> files;
+	for (size_t i = 0; i < m_processes; i++)
+	{
+		std::vector<char> name(pattern.begin(), pattern.end());
+		name.push_back(0);
+		int fd = mkstemp(name.data());
+		if (fd < 0)
+		{
+			message = "Cannot create temporary file in '" + pattern.substr(0, pattern.rfind('/')) + "'";
+			for (auto it : files)
+			{
+				close(it);
+			}
+			return false;
+		}
+		unlink(name.data());
+		files.push_back(fd);
+	}
+
+	// Nothing buffered may be written twice
+	std::cout.flush();
+	fflush(stdout);
+
+	std::vector<pid_t> workers;
+	for (size_t i = 0; i < m_processes; i++)
+	{
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			for (size_t j = 0; j < files.size(); j++)
+			{
+				if (j != i)
+					close(files[j]);
+			}
+			runWorker(i, files[i]);
+		}
+		if (pid < 0)
+		{
+			message = "Cannot start worker process";
+			break;
+		}
+		workers.push_back(pid);
+	}
+
+	bool ok = message.empty();
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		int status = 0;
+		while ((waitpid(workers[i], &status, 0) < 0) && (errno == EINTR))
+		{
+		}
+
+		int code = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+		if (WIFSIGNALED(status) && ok)
+		{
+			message = "Shard " + std::to_string(i) + " stopped by signal " + std::to_string(WTERMSIG(status));
+		}
+		else if ((code != 0) && (code != 2) && ok)
+		{
+			message = "Shard " + std::to_string(i) + " failed";
+		}
+		ok = ok && message.empty();
+		m_exitCode = std::max(m_exitCode, code);
+	}
+
+	// Merge results in shard order
+	int output = STDOUT_FILENO;
+	if (ok && !m_options.outputFile.empty() && (m_options.outputFile != "-"))
+	{
+		output = open(m_options.outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (output < 0)
+		{
+			message = "Cannot write '" + m_options.outputFile + "'";
+			ok = false;
+		}
+	}
+	for (size_t i = 0; ok && (i < files.size()); i++)
+	{
+		if (!copyResults(files[i], output))
+		{
+			message = "Error writing results";
+			ok = false;
+		}
+	}
+	if ((output != STDOUT_FILENO) && (output >= 0) && (close(output) != 0) && ok)
+	{
+		message = "Error writing results";
+		ok = false;
+	}
+
+	for (auto it : files)
+	{
+		close(it);
+	}
+	return ok;
+}
+
+void ShardRunner::runWorker(const size_t shard, const int outputFd)
+{
+	// Results go to stdout of worker (the temporary file)
+	int code = 1;
+	if (dup2(outputFd, STDOUT_FILENO) >= 0)
+	{
+		close(outputFd);
+
+		BatchOptions options = m_options;
+		options.outputFile.clear();
+		options.shard = shard;
+		options.shards = m_processes;
+
+		Batch batch(options);
+		std::string message;
+		if (batch.run(message))
+		{
+			code = (batch.errors() == 0) ? 0 : 2;
+		}
+		else
+		{
+			std::cerr << "! Shard " << shard << "/" << m_processes << ": " << message << std::endl;
+		}
+	}
+
+	std::cout.flush();
+	fflush(stdout);
+	std::cerr.flush();
+	_exit(code);
+}
+
+bool ShardRunner::copyResults(const int fromFd, const int toFd)
+{
+	if (lseek(fromFd, 0, SEEK_SET) != 0)
+		return false;
+
+	std::vector<char> buffer(SHARD_COPY_SIZE);
+	for (;;)
+	{
+		ssize_t got = read(fromFd, buffer.data(), buffer.size());
+		if (got == 0)
+			return true;
+		if (got < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		for (ssize_t done = 0; done < got; )
+		{
+			ssize_t put = write(toFd, buffer.data() + done, static_cast<size_t>(got - done));
+			if (put < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			done += put;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,58 @@
+/// @file
+///
+/// @brief Header file for ShardRunner - batch input split across worker processes.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include "batch.h"
+
+// How ShardRunner works:
+// The coordinator forks one worker process per shard. Each worker runs a Batch
+// on its shard (see BatchOptions::shard) and writes its results to its own
+// unlinked temporary file. When every worker has finished, the files are
+// copied to the output in shard order, so the output is the same as one
+// process would write. Workers share no memory (variables, constants, ...),
+// they start from a copy of the coordinator. POSIX only.
+
+class ShardRunner
+{
+public:
+	ShardRunner(const BatchOptions& options, const size_t processes);
+
+	/// @brief Runs all shards and merges their results
+	bool run(std::string& message);
+
+	/// @brief Highest exit code of workers (2 - some rows failed)
+	int exitCode() const { return m_exitCode; }
+
+private:
+	/// @brief Runs shard in worker process - does not return
+	void runWorker(const size_t shard, const int outputFd);
+
+	/// @brief Copies results of worker to output
+	bool copyResults(const int fromFd, const int toFd);
+
+	BatchOptions m_options;
+	size_t m_processes;
+	int m_exitCode;
+};
@@ -0,0 +1,170 @@
+/// @file
+///
+/// @brief SpscQueue - bounded single-producer/single-consumer ring buffer.
+///
+/// Lock-free: the producer only writes the tail, the consumer only writes the
+/// head. A full queue makes the producer wait (back-pressure), an empty queue
+/// makes the consumer wait. Counters show how full the queue was kept.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+/// @brief Waits progressively longer (spin, yield, then sleep)
+class Backoff
+{
+public:
+	Backoff() : m_count(0) {}
+
+	void wait()
+	{
+		if (m_count < 64)
+		{
+			// Spin
+		}
+		else if (m_count < 128)
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+		m_count++;
+	}
+
+private:
+	unsigned m_count;
+};
+
+template <typename T>
+class SpscQueue
+{
+public:
+	/// @brief Queue of 'capacity' entries (rounded up to a power of 2)
+	explicit SpscQueue(const size_t capacity)
+		: m_head(0)
+		, m_tail(0)
+		, m_closed(false)
+		, m_pushes(0)
+		, m_occupancy(0)
+		, m_fullWaits(0)
+		, m_emptyWaits(0)
+	{
+		size_t size = 2;
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+		m_slots.resize(size);
+		m_mask = size - 1;
+	}
+
+	/// @brief Adds entry - waits while queue is full (producer only)
+	void push(T&& value)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		size_t used = tail - m_head.load(std::memory_order_acquire);
+		if (used > m_mask)
+		{
+			m_fullWaits++;
+			Backoff backoff;
+			do {
+				backoff.wait();
+				used = tail - m_head.load(std::memory_order_acquire);
+			} while (used > m_mask);
+		}
+
+		m_pushes++;
+		m_occupancy += used;
+
+		m_slots[tail & m_mask] = std::move(value);
+		m_tail.store(tail + 1, std::memory_order_release);
+	}
+
+	/// @brief No more entries will be pushed (producer only)
+	void close()
+	{
+		m_closed.store(true, std::memory_order_release);
+	}
+
+	/// @brief Takes entry - waits while queue is empty (consumer only)
+	/// @return false if queue is closed and empty
+	bool pop(T& value)
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (m_tail.load(std::memory_order_acquire) == head)
+		{
+			m_emptyWaits++;
+			Backoff backoff;
+			while (m_tail.load(std::memory_order_acquire) == head)
+			{
+				// Check tail again - entries pushed before closing are still taken
+				if (m_closed.load(std::memory_order_acquire)
+					&& (m_tail.load(std::memory_order_acquire) == head))
+					return false;
+				backoff.wait();
+			}
+		}
+
+		value = std::move(m_slots[head & m_mask]);
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t capacity() const { return m_mask + 1; }
+
+	/// @brief Average entries in queue when pushed
+	double averageOccupancy() const
+	{
+		return (m_pushes == 0) ? 0. : static_cast<double>(m_occupancy) / static_cast<double>(m_pushes);
+	}
+
+	/// @brief Times the producer waited for space (consumer is slower)
+	uint64_t fullWaits() const { return m_fullWaits; }
+
+	/// @brief Times the consumer waited for entries (producer is slower)
+	uint64_t emptyWaits() const { return m_emptyWaits; }
+
+	uint64_t pushes() const { return m_pushes; }
+
+private:
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	std::vector<T> m_slots;
+	size_t m_mask;
+
+	// Consumer and producer positions on their own cache lines
+	alignas(64) std::atomic<size_t> m_head;
+	alignas(64) std::atomic<size_t> m_tail;
+	std::atomic<bool> m_closed;
+
+	// Producer counters
+	uint64_t m_pushes;
+	uint64_t m_occupancy;
+	uint64_t m_fullWaits;
+
+	// Consumer counter
+	alignas(64) uint64_t m_emptyWaits;
+};
@@ -0,0 +1,229 @@
+/// @file
+///
+/// @brief Implementation of Stream - pipelined evaluation of expression lines.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <fstream>
+#include <thread>
+
+#include "stream.h"
+#include "console.h"
+
+// Errors shown on stderr
+constexpr size_t MAX_STREAM_MESSAGES {10};
+
+Stream::Stream(const StreamOptions& options)
+	: m_options(options)
+	, m_toParse(options.queueSize)
+	, m_toEvaluate(options.queueSize)
+	, m_toFormat(options.queueSize)
+	, m_lines(0)
+	, m_errors(0)
+{
+	if (m_options.batchSize == 0)
+	{
+		m_options.batchSize = 1;
+	}
+}
+
+bool Stream::run(std::string& message)
+{
+	Console::Quiet quiet;
+
+	std::ifstream file;
+	std::istream* input = &std::cin;
+	if (!m_options.inputFile.empty())
+	{
+		file.open(m_options.inputFile);
+		if (!file)
+		{
+			message = "Cannot open '" + m_options.inputFile + "'";
+			return false;
+		}
+		input = &file;
+	}
+
+	std::ofstream outFile;
+	std::ostream* output = &std::cout;
+	if (!m_options.outputFile.empty())
+	{
+		outFile.open(m_options.outputFile);
+		if (!outFile)
+		{
+			message = "Cannot write '" + m_options.outputFile + "'";
+			return false;
+		}
+		output = &outFile;
+	}
+
+	// Stages start with the variables and settings of this thread
+	Context state = Context::current();
+	std::thread parser(&Stream::parseStage, this, state);
+	std::thread evaluator(&Stream::evaluateStage, this, state);
+	std::thread formatter(&Stream::formatStage, this, output);
+
+	// Read stage
+	StreamBatch batch;
+	batch.reserve(m_options.batchSize);
+	std::string line;
+	size_t lineNo = 0;
+	while (std::getline(*input, line))
+	{
+		lineNo++;
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+
+		batch.push_back(StreamLine{lineNo, line, Program(), Num(), true, ""});
+		if (batch.size() >= m_options.batchSize)
+		{
+			m_toParse.push(std::move(batch));
+			batch = StreamBatch();
+			batch.reserve(m_options.batchSize);
+		}
+	}
+	if (!batch.empty())
+	{
+		m_toParse.push(std::move(batch));
+	}
+	m_toParse.close();
+
+	parser.join();
+	evaluator.join();
+	formatter.join();
+
+	if (m_options.stats)
+	{
+		showStats("read -> parse", m_toParse);
+		showStats("parse -> evaluate", m_toEvaluate);
+		showStats("evaluate -> format", m_toFormat);
+	}
+	if (m_errors > 0)
+	{
+		std::cerr << "! " << m_errors << " of " << m_lines << " lines failed" << std::endl;
+	}
+	return output->good();
+}
+
+void Stream::parseStage(const Context& state)
+{
+	Context::current() = state;
+
+	StreamBatch batch;
+	while (m_toParse.pop(batch))
+	{
+		for (auto& it : batch)
+		{
+			// Variables without values are errors - nothing is interactive here
+			it.ok = it.program.compile(it.text, it.message)
+				&& it.program.resolve(std::vector<std::string>(), it.message);
+		}
+		m_toEvaluate.push(std::move(batch));
+	}
+	m_toEvaluate.close();
+}
+
+void Stream::evaluateStage(const Context& state)
+{
+	Context::current() = state;
+	RollingState::setCurrent(&m_rolling);
+
+	StreamBatch batch;
+	NumStack stack;
+	while (m_toEvaluate.pop(batch))
+	{
+		for (auto& it : batch)
+		{
+			if (!it.ok || it.program.empty())
+				continue;
+
+			m_rolling.beginLine();
+			it.ok = it.program.run(nullptr, stack, it.message);
+			if (it.ok)
+			{
+				it.result = stack.back();
+			}
+			else if (!Console::lastLine().empty())
+			{
+				it.message += " - " + Console::lastLine();
+				Console::clearLastLine();
+			}
+		}
+		m_toFormat.push(std::move(batch));
+	}
+	RollingState::setCurrent(nullptr);
+	m_toFormat.close();
+}
+
+void Stream::formatStage(std::ostream* output)
+{
+	StreamBatch batch;
+	std::string text;
+	while (m_toFormat.pop(batch))
+	{
+		text.clear();
+		for (const auto& it : batch)
+		{
+			m_lines++;
+			if (!it.ok)
+			{
+				m_errors++;
+				if (m_errors <= MAX_STREAM_MESSAGES)
+				{
+					std::cerr << "! Line " << it.lineNo << ": " << it.message << std::endl;
+				}
+				if (m_options.summary)
+				{
+					m_summary.add(NAN);
+					continue;
+				}
+				text += "nan";
+			}
+			else if (m_options.summary)
+			{
+				if (!it.program.empty())
+				{
+					m_summary.add(it.result.isInteger() ? static_cast<double>(it.result.m_lValue) : it.result.m_dValue);
+				}
+				continue;
+			}
+			else if (!it.program.empty())
+			{
+				text += it.result.asString();
+			}
+			// Only variables were defined - empty line
+			text += '\n';
+		}
+		output->write(text.data(), text.size());
+	}
+
+	if (m_options.summary)
+	{
+		text = m_summary.report(m_options.quantiles);
+		output->write(text.data(), text.size());
+	}
+	output->flush();
+}
+
+void Stream::showStats(const char* name, const SpscQueue<StreamBatch>& queue) const
+{
+	std::cerr << name << ": " << queue.pushes() << " batches, average occupancy "
+		<< queue.averageOccupancy() << "/" << queue.capacity()
+		<< ", producer waited " << queue.fullWaits() << "x (full)"
+		<< ", consumer waited " << queue.emptyWaits() << "x (empty)" << std::endl;
+}
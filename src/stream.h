@@ -0,0 +1,106 @@
+/// @file
+///
+/// @brief Header file for Stream - pipelined evaluation of expression lines.
+///
+/// Every input line is an expression. Reading, parsing, evaluating and
+/// formatting run on their own threads, connected by bounded lock-free
+/// queues (SpscQueue) that carry batches of lines.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "program.h"
+#include "context.h"
+#include "spscQueue.h"
+#include "aggregate.h"
+#include "rolling.h"
+
+/// @brief Stream settings (usually from command line)
+typedef struct _streamOptions
+{
+	std::string inputFile;   // stdin if empty
+	std::string outputFile;  // stdout if empty
+	size_t      batchSize;   // Lines passed between stages at once
+	size_t      queueSize;   // Batches each queue holds (bounds memory)
+	bool        stats;       // Show queue statistics (stderr)
+	bool        summary;     // Write summary statistics instead of results
+	std::vector<double> quantiles;  // Quantiles of summary (0..1)
+} StreamOptions;
+
+/// @brief One expression line as it moves through the stages
+typedef struct _streamLine
+{
+	size_t      lineNo;
+	CalString   text;     // Expression (read)
+	Program     program;  // (parsed)
+	Num         result;   // (evaluated)
+	bool        ok;
+	std::string message;  // Error message of failed stage
+} StreamLine;
+
+using StreamBatch = std::vector<StreamLine>;
+
+// How Stream works:
+// The calling thread reads lines. The parse stage compiles each line in order
+// (so "x=2" on one line defines 'x' for following lines), the evaluate stage
+// runs the compiled program and the format stage writes results, one line of
+// output per expression ("nan" for errors - message on stderr). A full queue
+// makes the stage before it wait, so memory stays bounded. In summary mode
+// the format stage adds results to an Aggregate instead of writing them.
+// Rolling functions (sma, delta, ...) keep their state in the evaluate stage,
+// which runs lines in input order.
+
+class Stream
+{
+public:
+	Stream(const StreamOptions& options);
+
+	/// @brief Runs all stages until input ends
+	bool run(std::string& message);
+
+	size_t lines() const { return m_lines; }
+
+	size_t errors() const { return m_errors; }
+
+private:
+	void parseStage(const Context& state);
+
+	void evaluateStage(const Context& state);
+
+	void formatStage(std::ostream* output);
+
+	void showStats(const char* name, const SpscQueue<StreamBatch>& queue) const;
+
+	StreamOptions m_options;
+
+	SpscQueue<StreamBatch> m_toParse;
+	SpscQueue<StreamBatch> m_toEvaluate;
+	SpscQueue<StreamBatch> m_toFormat;
+
+	size_t m_lines;
+	size_t m_errors;
+
+	Aggregate m_summary;
+
+	// Rolling functions (sma, ema, ...) - used by evaluate stage only
+	RollingState m_rolling;
+};
@@ -0,0 +1,429 @@
+/// @file
+///
+/// @brief Implementation of Table - expression tabulated over a range.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+
+#include "table.h"
+#include "console.h"
+#include "workPool.h"
+#include "context.h"
+#include "numScan.h"
+
+// Rows per chunk (a multiple of BLOCK_VALUES)
+constexpr size_t TABLE_CHUNK_ROWS {16 * BLOCK_VALUES};
+
+// Chunks in flight (per thread) - bounds memory used by the reorder buffer
+constexpr size_t TABLE_CHUNKS_PER_THREAD {4};
+
+// Rounding allowed when counting values up to 'stop'
+constexpr double RANGE_TOLERANCE {1e-9};
+
+// Most values of one range - more would not end (and may not fit size_t)
+constexpr double RANGE_MAX_VALUES {4294967296.};
+
+Table::Table(const TableOptions& options)
+	: m_options(options)
+	, m_vectorized(false)
+	, m_count(0)
+	, m_text(&std::cout)
+	, m_rows(0)
+	, m_errors(0)
+{
+}
+
+// static
+bool Table::parseRange(const std::string& arg, SweepRange& range, std::string& message)
+{
+	size_t pos = arg.find('=');
+	if ((pos == std::string::npos) || (pos == 0) || !isalpha(arg[0]))
+	{
+		message = "Range '" + arg + "' is not <var>=<start>:<stop>[:<step>]";
+		return false;
+	}
+	range.var = arg.substr(0, pos);
+
+	// start, stop and (optional) step
+	double values[3] = {0., 0., 1.};
+	size_t count = 0;
+	while ((pos < arg.size()) && (count < 3))
+	{
+		size_t begin = pos + 1;
+		pos = arg.find(':', begin);
+		if (pos == std::string::npos)
+			pos = arg.size();
+
+		ScannedNumber numb;
+		if (!scanNumber(arg.data() + begin, arg.data() + pos, SCAN_EXPONENT, numb) || (numb.length != (pos - begin)))
+		{
+			message = "Range '" + arg + "' has '" + arg.substr(begin, pos - begin) + "' - not a number";
+			return false;
+		}
+		values[count++] = numb.dblValue;
+	}
+	if ((count < 2) || (pos < arg.size()))
+	{
+		message = "Range '" + arg + "' is not <var>=<start>:<stop>[:<step>]";
+		return false;
+	}
+
+	range.start = values[0];
+	range.stop = values[1];
+	range.step = values[2];
+
+	double steps = (range.stop - range.start) / range.step;
+	if ((range.step == 0.) || !std::isfinite(steps) || (steps < 0.))
+	{
+		message = "Range '" + arg + "' never reaches its stop value";
+		return false;
+	}
+	if ((steps + 1.) > RANGE_MAX_VALUES)
+	{
+		message = "Range '" + arg + "' has more than " + std::to_string(static_cast<uint64_t>(RANGE_MAX_VALUES)) + " values";
+		return false;
+	}
+	range.count = static_cast<size_t>(std::floor(steps + RANGE_TOLERANCE)) + 1;
+	return true;
+}
+
+bool Table::run(std::string& message)
+{
+	Console::Quiet quiet;
+
+	if (m_options.ranges.empty())
+	{
+		message = "Table has no range";
+		return false;
+	}
+
+	// Rows of the grid - must fit
+	m_count = 1;
+	std::vector<std::string> names;
+	for (const auto& it : m_options.ranges)
+	{
+		if (m_count > (SIZE_MAX / it.count))
+		{
+			message = "Grid has too many points";
+			return false;
+		}
+		m_count *= it.count;
+		names.push_back(it.var);
+	}
+
+	if (!m_program.compile(m_options.expression, message))
+		return false;
+
+	if (m_program.empty())
+	{
+		message = "Expression '" + m_options.expression + "' has no results";
+		return false;
+	}
+
+	if (!m_program.resolve(names, message))
+		return false;
+
+	// Falls back to running one value at a time
+	std::string reason;
+	m_vectorized = m_block.build(m_program, reason);
+
+	std::ofstream textFile;
+	if (m_options.outFormat != RAW_NONE)
+	{
+		if (!m_raw.open(m_options.outputFile, m_options.outFormat, message))
+			return false;
+		if (m_options.header && !writeHeader())
+		{
+			message = "Error writing results";
+			m_raw.close();
+			return false;
+		}
+	}
+	else if (!m_options.outputFile.empty())
+	{
+		textFile.open(m_options.outputFile);
+		if (!textFile)
+		{
+			message = "Cannot write '" + m_options.outputFile + "'";
+			return false;
+		}
+		m_text = &textFile;
+	}
+
+	size_t threads = WorkPool::threadCount(m_options.threads);
+	bool ok = (threads > 1) ? runThreaded(threads, message) : runSerial(message);
+
+	if (!m_raw.close() && ok)
+	{
+		message = "Error writing results";
+		ok = false;
+	}
+	m_text->flush();
+	m_text = &std::cout;
+
+	if (m_errors > 0)
+	{
+		std::cerr << "! " << m_errors << " of " << m_rows << " rows failed" << std::endl;
+	}
+	return ok;
+}
+
+bool Table::writeHeader()
+{
+	std::string header(GRID_MAGIC, sizeof(GRID_MAGIC) - 1);
+	appendRawInt(header, RAW_INT64, static_cast<int64_t>(m_options.ranges.size()));
+	appendRawInt(header, RAW_INT64, static_cast<int64_t>(m_options.outFormat));
+
+	for (const auto& it : m_options.ranges)
+	{
+		std::string name = it.var.substr(0, GRID_NAME_SIZE);
+		name.resize(GRID_NAME_SIZE, '\0');
+		header += name;
+		appendRawDouble(header, RAW_FLOAT64, it.start);
+		appendRawDouble(header, RAW_FLOAT64, it.stop);
+		appendRawDouble(header, RAW_FLOAT64, it.step);
+		appendRawInt(header, RAW_INT64, static_cast<int64_t>(it.count));
+	}
+	return m_raw.write(header);
+}
+
+void Table::evaluate(TableChunk& chunk) const
+{
+	const std::vector<SweepRange>& ranges = m_options.ranges;
+	const size_t dims = ranges.size();
+
+	// One input column per variable
+	std::vector<std::vector<double> > columns(dims, std::vector<double>(BLOCK_VALUES));
+	std::vector<const double*> inputs(dims);
+	for (size_t k = 0; k < dims; k++)
+	{
+		inputs[k] = columns[k].data();
+	}
+	std::vector<double> results(BLOCK_VALUES);
+	std::vector<double> scratch(m_block.columns() * BLOCK_VALUES);
+
+	// Index of first row on each axis - last axis changes fastest
+	std::vector<size_t> index(dims);
+	size_t rest = chunk.first;
+	for (size_t k = dims; k-- > 0; )
+	{
+		index[k] = rest % ranges[k].count;
+		rest /= ranges[k].count;
+	}
+
+	std::vector<Num> values(dims, Num(0., NUM_DOUBLE));
+	Num result;
+	std::string message;
+
+	for (size_t done = 0; done < chunk.rows; )
+	{
+		size_t count = std::min(BLOCK_VALUES, chunk.rows - done);
+		for (size_t i = 0; i < count; i++)
+		{
+			for (size_t k = 0; k < dims; k++)
+			{
+				columns[k][i] = ranges[k].start + (static_cast<double>(index[k]) * ranges[k].step);
+			}
+
+			// Next point of the grid
+			for (size_t k = dims; k-- > 0; )
+			{
+				if (++index[k] < ranges[k].count)
+					break;
+				index[k] = 0;
+			}
+		}
+
+		if (!m_vectorized)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				for (size_t k = 0; k < dims; k++)
+				{
+					values[k].m_dValue = columns[k][i];
+				}
+				bool ok = m_program.run(values.data(), result, message);
+				putValues(chunk, columns, i);
+				putResult(chunk, result, ok);
+			}
+		}
+		else if (m_block.constantResult())
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				putValues(chunk, columns, i);
+				putResult(chunk, m_block.constant(), true);
+			}
+		}
+		else
+		{
+			m_block.run(inputs.data(), count, scratch.data(), results.data());
+			for (size_t i = 0; i < count; i++)
+			{
+				putValues(chunk, columns, i);
+				putResult(chunk, results[i]);
+			}
+		}
+		done += count;
+	}
+}
+
+void Table::putValues(TableChunk& chunk, const std::vector<std::vector<double> >& values, const size_t row) const
+{
+	if (m_options.outFormat != RAW_NONE)
+		return;
+
+	// Same default format as Num::asString()
+	char text[400];
+	for (const auto& it : values)
+	{
+		int len = snprintf(text, sizeof(text), "%.9f ", it[row]);
+		chunk.output.append(text, len);
+	}
+}
+
+void Table::putResult(TableChunk& chunk, const double result) const
+{
+	// Counted as the Program counts them - either way gives the same errors
+	if (!std::isfinite(result))
+	{
+		chunk.errors++;
+	}
+
+	if (m_options.outFormat != RAW_NONE)
+	{
+		appendRawDouble(chunk.output, m_options.outFormat, result);
+		return;
+	}
+
+	if (std::isnan(result))
+	{
+		chunk.output += "nan\n";
+		return;
+	}
+	char text[400];
+	int len = snprintf(text, sizeof(text), "%.9f\n", result);
+	chunk.output.append(text, len);
+}
+
+void Table::putResult(TableChunk& chunk, const Num& result, const bool ok) const
+{
+	if (!ok)
+	{
+		// NaN - counted as an error
+		putResult(chunk, NAN);
+		return;
+	}
+
+	if (result.isDouble() && !std::isfinite(result.m_dValue))
+	{
+		chunk.errors++;
+	}
+
+	if (m_options.outFormat != RAW_NONE)
+	{
+		if (result.isInteger())
+		{
+			appendRawInt(chunk.output, m_options.outFormat, result.m_lValue);
+		}
+		else
+		{
+			appendRawDouble(chunk.output, m_options.outFormat, result.m_dValue);
+		}
+	}
+	else
+	{
+		chunk.output += result.asString();
+		chunk.output += '\n';
+	}
+}
+
+bool Table::writeChunk(const TableChunk& chunk)
+{
+	m_rows += chunk.rows;
+	m_errors += chunk.errors;
+
+	if (m_options.outFormat != RAW_NONE)
+	{
+		return m_raw.write(chunk.output);
+	}
+
+	m_text->write(chunk.output.data(), chunk.output.size());
+	return m_text->good();
+}
+
+bool Table::runSerial(std::string& message)
+{
+	TableChunk chunk;
+	for (size_t first = 0; first < m_count; first += TABLE_CHUNK_ROWS)
+	{
+		chunk.first = first;
+		chunk.rows = std::min(TABLE_CHUNK_ROWS, m_count - first);
+		chunk.output.clear();
+		chunk.errors = 0;
+
+		evaluate(chunk);
+		if (!writeChunk(chunk))
+		{
+			message = "Error writing results";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Table::runThreaded(const size_t threads, std::string& message)
+{
+	// Workers start with the variables and settings of this thread
+	Context state = Context::current();
+	WorkPool pool(threads, [state] { Context::current() = state; });
+
+	ReorderBuffer<TableChunk> order;
+	bool ok = true;
+
+	for (size_t first = 0; ok && (first < m_count); first += TABLE_CHUNK_ROWS)
+	{
+		// Write finished chunks before running too far ahead
+		TableChunk done;
+		while (ok && (order.outstanding() >= threads * TABLE_CHUNKS_PER_THREAD) && order.take(done))
+		{
+			ok = writeChunk(done);
+		}
+
+		TableChunk chunk{first, std::min(TABLE_CHUNK_ROWS, m_count - first), "", 0};
+		size_t sequence = order.reserve();
+		pool.submit([this, &order, sequence, chunk]() mutable {
+			evaluate(chunk);
+			order.put(sequence, std::move(chunk));
+		});
+	}
+
+	TableChunk done;
+	while (order.take(done))
+	{
+		ok = writeChunk(done) && ok;
+	}
+
+	if (!ok)
+	{
+		message = "Error writing results";
+	}
+	return ok;
+}
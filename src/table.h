@@ -0,0 +1,137 @@
+/// @file
+///
+/// @brief Header file for Table - expression tabulated over a range.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+
+#include "program.h"
+#include "blockProgram.h"
+#include "binaryIO.h"
+
+/// @brief Values of a variable: start, start + step, ... up to stop (included)
+typedef struct _sweepRange
+{
+	std::string var;
+	double      start;
+	double      stop;
+	double      step;
+	size_t      count;  // Number of values
+} SweepRange;
+
+/// @brief Table settings (usually from command line)
+typedef struct _tableOptions
+{
+	CalString   expression;
+	std::vector<SweepRange> ranges;  // One per variable - last one changes fastest
+	RawFormat   outFormat;   // RAW_NONE is text output ("x y result" rows)
+	std::string outputFile;  // stdout if empty
+	size_t      threads;     // Worker threads (0 - all cores)
+	bool        header;      // Raw output starts with a GridHeader (grid mode)
+} TableOptions;
+
+// Raw grid output (all values little-endian, 8 bytes each):
+//   "FNCGRID1"                  magic
+//   dims, format                int64 - format is RAW_FLOAT64 or RAW_INT64
+//   per axis: name[16]          variable name (NUL padded)
+//             start, stop, step float64
+//             count             int64
+//   results                     count[0] * count[1] * ... values, row-major
+//                               (last axis changes fastest)
+constexpr char GRID_MAGIC[] {"FNCGRID1"};
+constexpr size_t GRID_NAME_SIZE {16};
+
+/// @brief Rows evaluated together (by one thread)
+typedef struct _tableChunk
+{
+	size_t      first;   // Index of first value
+	size_t      rows;
+	std::string output;  // Formatted (or raw) results
+	size_t      errors;
+} TableChunk;
+
+// How Table works:
+// The expression is compiled once and, if it can, built into a BlockProgram
+// that runs blocks of values at once. Otherwise every value runs the Program.
+// With more than one range, rows are the Cartesian product of the ranges in
+// row-major order. Values are start + (i * step), so long tables do not drift.
+// Chunks of consecutive rows are split between threads like Batch and
+// written in order. Rows that fail or give NaN/inf are counted as errors on
+// both paths.
+
+class Table
+{
+public:
+	Table(const TableOptions& options);
+
+	/// @brief Compiles expression and writes all rows
+	bool run(std::string& message);
+
+	/// @brief Rows written
+	size_t rows() const { return m_rows; }
+
+	/// @brief Rows that failed (written as NaN) or gave NaN/inf
+	size_t errors() const { return m_errors; }
+
+	/// @brief Expression runs over blocks (see BlockProgram)
+	bool vectorized() const { return m_vectorized; }
+
+	/// @brief Parses range "x=start:stop:step"
+	static bool parseRange(const std::string& arg, SweepRange& range, std::string& message);
+
+private:
+	/// @brief Evaluates rows of chunk (any thread)
+	void evaluate(TableChunk& chunk) const;
+
+	/// @brief Formats values of one row (text only)
+	void putValues(TableChunk& chunk, const std::vector<std::vector<double> >& values, const size_t row) const;
+
+	/// @brief Formats one result into chunk output
+	void putResult(TableChunk& chunk, const double result) const;
+	void putResult(TableChunk& chunk, const Num& result, const bool ok) const;
+
+	/// @brief Writes GridHeader (raw output)
+	bool writeHeader();
+
+	bool writeChunk(const TableChunk& chunk);
+
+	bool runSerial(std::string& message);
+
+	bool runThreaded(const size_t threads, std::string& message);
+
+	TableOptions m_options;
+
+	Program m_program;
+	BlockProgram m_block;
+	bool m_vectorized;
+
+	// Rows in total (product of range counts)
+	size_t m_count;
+
+	// Output - one of them is used
+	RawWriter m_raw;
+	std::ostream* m_text;
+
+	size_t m_rows;
+	size_t m_errors;
+};
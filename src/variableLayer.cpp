@@ -0,0 +1,67 @@
+/// @file
+///
+/// @brief Implementation of VariableLayer - immutable variables shared by many contexts.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "variableLayer.h"
+
+#include <boost/math/constants/constants.hpp>
+
+/// @brief PI used as a constant.
+constexpr double __pi = boost::math::double_constants::pi;
+
+VariableLayer::VariableLayer()
+{
+}
+
+VariableLayer::VariableLayer(const std::vector<ConstantVars>& variables)
+{
+	m_variables.reserve(variables.size());
+	for (auto& it : variables)
+	{
+		set(it);
+	}
+}
+
+const ConstantVars* VariableLayer::find(const std::string& name) const
+{
+	auto it = m_index.find(name);
+	return (it == m_index.end()) ? nullptr : &m_variables[it->second];
+}
+
+void VariableLayer::set(const ConstantVars& var)
+{
+	auto it = m_index.find(var.varName);
+	if (it != m_index.end())
+	{
+		m_variables[it->second] = var;
+		return;
+	}
+	m_index.emplace(var.varName, m_variables.size());
+	m_variables.push_back(var);
+}
+
+// static
+std::shared_ptr<const VariableLayer> VariableLayer::constants()
+{
+	static const std::shared_ptr<const VariableLayer> s_constants = std::make_shared<const VariableLayer>(
+		std::vector<ConstantVars>{
+			{"pi", __pi, NUM_DOUBLE | NUM_CONSTS, UNIT_NUMBER, "rad"}
+		});
+	return s_constants;
+}
@@ -0,0 +1,63 @@
+/// @file
+///
+/// @brief Header for VariableLayer - immutable variables shared by many contexts.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "num.h"
+
+// How VariableLayer works:
+// Variables of a context are two layers: a base layer (constants and the
+// values every session starts with) and the variables the context set itself.
+// The base layer never changes once built, so any number of contexts (and
+// threads) share it by pointer - a new context costs one reference count, and
+// an assignment goes to the context's own layer, shadowing the base.
+// Variables keep the order they were added in (for listing); names are
+// hashed, so a lookup does not depend on how many variables there are.
+
+class VariableLayer
+{
+public:
+	VariableLayer();
+
+	explicit VariableLayer(const std::vector<ConstantVars>& variables);
+
+	/// @brief Variable named 'name' - nullptr if none
+	const ConstantVars* find(const std::string& name) const;
+
+	/// @brief Adds variable or replaces the one of the same name
+	void set(const ConstantVars& var);
+
+	/// @brief Variables in the order they were added
+	const std::vector<ConstantVars>& variables() const { return m_variables; }
+
+	bool empty() const { return m_variables.empty(); }
+
+	/// @brief Layer of constants (pi) - base of every new context
+	static std::shared_ptr<const VariableLayer> constants();
+
+private:
+	std::vector<ConstantVars> m_variables;
+	std::unordered_map<std::string, size_t> m_index;
+};
@@ -0,0 +1,123 @@
+/// @file
+///
+/// @brief Implementation of VariableStore - variables shared by many contexts, lock-free to read.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+
+#include "variableStore.h"
+
+/// @brief Current snapshot, safe to use while the guard lives
+class ReadGuard
+{
+public:
+	explicit ReadGuard(const std::atomic<const VariableSnapshot*>& current)
+		: m_snapshot(current.load())
+	{
+	}
+
+	const VariableSnapshot& snapshot() const { return *m_snapshot; }
+
+private:
+	EpochGuard m_epoch;  // Announced before the snapshot is loaded
+	const VariableSnapshot* m_snapshot;
+};
+
+/// @brief Position of name in sorted variables
+static std::vector<ConstantVars>::const_iterator findName(const std::vector<ConstantVars>& variables,
+	const std::string& name)
+{
+	return std::lower_bound(variables.begin(), variables.end(), name,
+		[](const ConstantVars& var, const std::string& key) { return var.varName < key; });
+}
+
+VariableStore::VariableStore()
+	: m_current{new VariableSnapshot{0, {}}}
+{
+}
+
+VariableStore::~VariableStore()
+{
+	delete m_current.load();
+}
+
+bool VariableStore::find(const std::string& name, ConstantVars& var, uint64_t* version) const
+{
+	ReadGuard guard(m_current);
+	const VariableSnapshot& snapshot = guard.snapshot();
+	auto it = findName(snapshot.variables, name);
+	if ((it == snapshot.variables.end()) || (it->varName != name))
+		return false;
+
+	var = *it;
+	if (version)
+	{
+		*version = snapshot.version;
+	}
+	return true;
+}
+
+std::vector<ConstantVars> VariableStore::variables() const
+{
+	ReadGuard guard(m_current);
+	return guard.snapshot().variables;
+}
+
+uint64_t VariableStore::version() const
+{
+	ReadGuard guard(m_current);
+	return guard.snapshot().version;
+}
+
+void VariableStore::set(const ConstantVars& var)
+{
+	std::lock_guard<std::mutex> lock(m_writer);
+	const VariableSnapshot* current = m_current.load();
+	VariableSnapshot* snapshot = new VariableSnapshot{current->version + 1, current->variables};
+
+	std::vector<ConstantVars>& variables = snapshot->variables;
+	size_t pos = findName(variables, var.varName) - variables.cbegin();
+	if ((pos < variables.size()) && (variables[pos].varName == var.varName))
+	{
+		variables[pos] = var;
+	}
+	else
+	{
+		variables.insert(variables.begin() + pos, var);
+	}
+	publish(snapshot);
+}
+
+bool VariableStore::remove(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(m_writer);
+	const VariableSnapshot* current = m_current.load();
+	size_t pos = findName(current->variables, name) - current->variables.cbegin();
+	if ((pos == current->variables.size()) || (current->variables[pos].varName != name))
+		return false;
+
+	VariableSnapshot* snapshot = new VariableSnapshot{current->version + 1, current->variables};
+	snapshot->variables.erase(snapshot->variables.begin() + pos);
+	publish(snapshot);
+	return true;
+}
+
+void VariableStore::publish(VariableSnapshot* snapshot)
+{
+	m_retired.retire(m_current.exchange(snapshot));
+}
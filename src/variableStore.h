@@ -0,0 +1,84 @@
+/// @file
+///
+/// @brief Header for VariableStore - variables shared by many contexts, lock-free to read.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "epoch.h"
+#include "numDefs.h"
+
+/// @brief Immutable set of variables - sorted by name
+typedef struct _variableSnapshot
+{
+	uint64_t version;
+	std::vector<ConstantVars> variables;
+} VariableSnapshot;
+
+// How VariableStore works:
+// Readers never lock and never wait. The variables are an immutable
+// snapshot behind an atomic pointer: set() copies the snapshot, changes the
+// copy and publishes it with one atomic exchange (next version). A reader
+// holds an EpochGuard while it uses a snapshot; an old snapshot is retired
+// and freed once no reader can still see it (see epoch.h). Writers are
+// serialized by a mutex; they are expected to be rare (ex. calibration
+// constants), readers many.
+
+class VariableStore
+{
+public:
+	VariableStore();
+
+	/// @brief Frees snapshots - no reader may be left
+	~VariableStore();
+
+	/// @brief Finds variable in the current snapshot
+	/// @param[out] version - version of the snapshot it was found in (if not nullptr)
+	bool find(const std::string& name, ConstantVars& var, uint64_t* version = nullptr) const;
+
+	/// @brief Copy of all variables (one snapshot)
+	std::vector<ConstantVars> variables() const;
+
+	/// @brief Version of the current snapshot (starts at 0, +1 per change)
+	uint64_t version() const;
+
+	/// @brief Adds or replaces variable and publishes a new snapshot
+	void set(const ConstantVars& var);
+
+	/// @brief Removes variable - false if it is not in the store
+	bool remove(const std::string& name);
+
+private:
+	VariableStore(const VariableStore&) = delete;
+	VariableStore& operator=(const VariableStore&) = delete;
+
+	/// @brief Publishes snapshot and frees the ones no reader can see (m_writer held)
+	void publish(VariableSnapshot* snapshot);
+
+	std::atomic<const VariableSnapshot*> m_current;
+
+	// Writers only
+	std::mutex m_writer;
+	EpochRetired<VariableSnapshot> m_retired;
+};
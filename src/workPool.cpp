@@ -0,0 +1,159 @@
+/// @file
+///
+/// @brief Implementation of WorkPool - work-stealing thread pool.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "workPool.h"
+
+WorkPool::WorkPool(const size_t threads, const Task& threadInit)
+	: m_queued(0)
+	, m_unfinished(0)
+	, m_next(0)
+	, m_stop(false)
+{
+	size_t count = threadCount(threads);
+	for (size_t i = 0; i < count; i++)
+	{
+		m_workers.emplace_back(new Worker());
+	}
+	// Start after all queues exist - workers steal from each other
+	for (size_t i = 0; i < count; i++)
+	{
+		m_workers[i]->thread = std::thread(&WorkPool::workerLoop, this, i, threadInit);
+	}
+}
+
+WorkPool::~WorkPool()
+{
+	wait();
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto& it : m_workers)
+	{
+		it->thread.join();
+	}
+}
+
+// static
+size_t WorkPool::threadCount(const size_t threads)
+{
+	if (threads > 0)
+		return threads;
+
+	size_t cores = std::thread::hardware_concurrency();
+	return cores > 0 ? cores : 1;
+}
+
+void WorkPool::submit(Task task)
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_unfinished++;
+	}
+
+	Worker& worker = *m_workers[m_next];
+	m_next = (m_next + 1) % m_workers.size();
+	{
+		std::lock_guard<std::mutex> guard(worker.lock);
+		worker.tasks.push_back(std::move(task));
+	}
+
+	{
+		// Counted under the lock so a sleeping worker cannot miss it
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_queued++;
+	}
+	m_wake.notify_one();
+}
+
+void WorkPool::wait()
+{
+	std::unique_lock<std::mutex> guard(m_lock);
+	m_idle.wait(guard, [this] { return m_unfinished == 0; });
+}
+
+bool WorkPool::popTask(const size_t index, Task& task)
+{
+	{
+		// Own queue - newest first (still in cache)
+		Worker& own = *m_workers[index];
+		std::lock_guard<std::mutex> guard(own.lock);
+		if (!own.tasks.empty())
+		{
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+
+	// Steal oldest task of other workers
+	for (size_t i = 1; i < m_workers.size(); i++)
+	{
+		Worker& other = *m_workers[(index + i) % m_workers.size()];
+		std::lock_guard<std::mutex> guard(other.lock);
+		if (!other.tasks.empty())
+		{
+			task = std::move(other.tasks.front());
+			other.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkPool::workerLoop(const size_t index, const Task threadInit)
+{
+	if (threadInit)
+	{
+		threadInit();
+	}
+
+	Task task;
+	while (true)
+	{
+		if (popTask(index, task))
+		{
+			m_queued--;
+			task();
+			task = nullptr;
+
+			std::lock_guard<std::mutex> guard(m_lock);
+			if (--m_unfinished == 0)
+			{
+				m_idle.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(m_lock);
+		if (m_queued > 0)
+		{
+			// Task was counted but is being taken by another worker
+			guard.unlock();
+			std::this_thread::yield();
+			continue;
+		}
+		if (m_stop)
+			break;
+
+		m_wake.wait(guard, [this] { return m_stop || (m_queued > 0); });
+	}
+}
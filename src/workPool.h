@@ -0,0 +1,140 @@
+/// @file
+///
+/// @brief Header for WorkPool - work-stealing thread pool - and ReorderBuffer.
+///
+/// Each worker owns a task queue. Workers take their own tasks from the back
+/// (most recent first) and steal tasks from the front of other queues when
+/// their own queue is empty. ReorderBuffer returns results of tasks in the
+/// order they were submitted.
+///
+/// @copyright 2019-2021 - M.Mashimo and all licensors. All rights reserved.
+///
+///  This program is free software: you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation, either version 3 of the License, or
+///  any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkPool
+{
+public:
+	using Task = std::function<void()>;
+
+	/// @brief Starts worker threads.
+	/// @param threads - number of workers (0 uses all cores)
+	/// @param threadInit - run by each worker before its first task (ex. copy settings)
+	WorkPool(const size_t threads, const Task& threadInit = Task());
+
+	/// @brief Finishes queued tasks and stops workers
+	~WorkPool();
+
+	/// @brief Queues task - tasks are spread over workers
+	void submit(Task task);
+
+	/// @brief Waits until all submitted tasks are done
+	void wait();
+
+	size_t threads() const { return m_workers.size(); }
+
+	/// @brief Number of threads used for 'threads' setting (0 is all cores)
+	static size_t threadCount(const size_t threads);
+
+private:
+	WorkPool(const WorkPool&) = delete;
+	WorkPool& operator=(const WorkPool&) = delete;
+
+	typedef struct _worker
+	{
+		std::mutex lock;
+		std::deque<Task> tasks;
+		std::thread thread;
+	} Worker;
+
+	void workerLoop(const size_t index, const Task threadInit);
+
+	/// @brief Gets task from own queue or steals one from another worker
+	bool popTask(const size_t index, Task& task);
+
+	std::vector<std::unique_ptr<Worker> > m_workers;
+
+	std::mutex m_lock;
+	std::condition_variable m_wake;
+	std::condition_variable m_idle;
+
+	// Tasks in queues (can be briefly negative while a task is taken)
+	std::atomic<long> m_queued;
+	// Tasks submitted and not finished
+	size_t m_unfinished;
+	// Next worker to receive a task
+	size_t m_next;
+	bool m_stop;
+};
+
+/// @brief Collects results by sequence number and returns them in order
+template <typename T>
+class ReorderBuffer
+{
+public:
+	ReorderBuffer() : m_next(0), m_added(0) {}
+
+	/// @brief Next sequence number to be added (see add())
+	size_t reserve() { return m_added++; }
+
+	/// @brief Results reserved but not taken yet
+	size_t outstanding() const { return m_added - m_next; }
+
+	/// @brief Stores result of sequence number (any thread)
+	void put(const size_t sequence, T&& value)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_done.emplace(sequence, std::move(value));
+		if (sequence == m_next)
+		{
+			m_ready.notify_all();
+		}
+	}
+
+	/// @brief Waits for next result in order
+	/// @return false if no results are outstanding
+	bool take(T& value)
+	{
+		if (outstanding() == 0)
+			return false;
+
+		std::unique_lock<std::mutex> guard(m_lock);
+		m_ready.wait(guard, [this] { return !m_done.empty() && (m_done.begin()->first == m_next); });
+		value = std::move(m_done.begin()->second);
+		m_done.erase(m_done.begin());
+		m_next++;
+		return true;
+	}
+
+private:
+	std::mutex m_lock;
+	std::condition_variable m_ready;
+	std::map<size_t, T> m_done;
+
+	// Only the thread reserving and taking results changes these
+	size_t m_next;
+	size_t m_added;
+};
@@ -0,0 +1,40 @@
+#!/bin/sh
+# Block results must equal row results: --table runs expressions by blocks of
+# columns (BlockProgram), --batch with text input runs them row by row. The
+# selects with a constant condition used to pick the wrong scratch column.
+#
+# Usage: blockRows.sh <path of fnc>
+
+FNC="$1"
+DIR=$(mktemp -d) || exit 1
+printf '1\n2\n3\n4\n5\n' > "$DIR/rows"
+
+fail()
+{
+	echo "FAILED: $1"
+	rm -rf "$DIR"
+	exit 1
+}
+
+check()
+{
+	"$FNC" --table x=1:5 "$1" < /dev/null > "$DIR/block" 2>&1 || fail "'$1' in blocks"
+	"$FNC" --batch "$1" < "$DIR/rows" > "$DIR/row" 2>&1 || fail "'$1' in rows"
+	# Second column of the table against the batch line
+	cut -d ' ' -f 2 "$DIR/block" | paste -d ' ' - "$DIR/row" > "$DIR/both"
+	awk '{ d = $1 - $2; if (d < 0) d = -d; if (d > 1e-9 * (1 + ($2 < 0 ? -$2 : $2))) exit 1 }' "$DIR/both" \
+		|| fail "'$1' - blocks and rows differ: $(tr '\n' ';' < "$DIR/both")"
+}
+
+check "x*2 + x*3"
+check "select(1, x*2, 0) + (x*3)"
+check "select(0, 0, x*2) + (x*3)"
+check "select(1, x, 0) + (x*3)"
+check "select(1, 5, x) + x"
+check "select(1, select(0, 1, x+1), 2) * (x-1)"
+check "select(x > 2, x*2, x*3) + x"
+check "max(x, 3) - min(x, 3)"
+
+rm -rf "$DIR"
+echo "Blocks and rows agree"
+exit 0
@@ -0,0 +1,51 @@
+#!/bin/sh
+# Regression check of server mode: requests that used to crash the server
+# (integer division by 0, "%s" format, deep nesting of parentheses) must fail
+# on their own and leave the server answering. Stopping it removes the socket.
+#
+# Usage: serveRequests.sh <path of fnc>
+
+FNC="$1"
+DIR=$(mktemp -d) || exit 1
+SOCKET="$DIR/fnc.sock"
+
+"$FNC" --serve "$SOCKET" 2>/dev/null &
+SERVER=$!
+
+fail()
+{
+	echo "FAILED: $1"
+	kill "$SERVER" 2>/dev/null
+	rm -rf "$DIR"
+	exit 1
+}
+
+# Server is up once the socket exists
+i=0
+while [ ! -S "$SOCKET" ]; do
+	i=$((i + 1))
+	[ $i -le 50 ] || fail "server did not start"
+	sleep 0.1
+done
+
+# One request per line of 'input' - the server must still answer after it
+request()
+{
+	printf '%s\n' "$2" > "$DIR/request"
+	"$FNC" --client "$SOCKET" < "$DIR/request" > /dev/null 2>&1
+	kill -0 "$SERVER" 2>/dev/null || fail "server stopped after $1"
+	[ "$("$FNC" --client "$SOCKET" "2+3")" = "5" ] || fail "server does not answer after $1"
+}
+
+request "integer division by 0" "1/0"
+request "integer modulo by 0" "7%0"
+request "string format" "5:%s"
+request "deep nesting" "$(awk 'BEGIN { for (i = 0; i < 100000; i++) printf "("; printf "1"; for (i = 0; i < 100000; i++) printf ")" }')"
+
+kill "$SERVER"
+wait "$SERVER"
+[ ! -e "$SOCKET" ] || fail "socket left after stop"
+
+rm -rf "$DIR"
+echo "Server survived all requests"
+exit 0